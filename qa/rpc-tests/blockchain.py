@@ -104,13 +104,22 @@ class BlockchainTest(BitcoinTestFramework):
         node = self.nodes[0]
         res = node.gettxoutsetinfo()
 
+        assert_equal(res['total_amount'], Decimal('60000000.00000000'))
+        assert_equal(res['height'], 120)
+        assert_equal(res['txouts'], 120)
+        assert_greater_than(res['bogosize'], 0)
+        assert_equal(len(res['bestblock']), 64)
+        assert_equal(len(res['muhash']), 64)
+
+        res = node.gettxoutsetinfo("hash_serialized_2")
+
         assert_equal(res['total_amount'], Decimal('60000000.00000000'))
         assert_equal(res['transactions'], 120)
         assert_equal(res['height'], 120)
         assert_equal(res['txouts'], 120)
-        assert_equal(res['bytes_serialized'], 8520),
+        assert_equal(res['bytes_serialized'], 8817),
         assert_equal(len(res['bestblock']), 64)
-        assert_equal(len(res['hash_serialized']), 64)
+        assert_equal(len(res['hash_serialized_2']), 64)
 
     def _test_getblockheader(self):
         node = self.nodes[0]
@@ -189,13 +189,21 @@ CAuxPow::CheckMerkleBranch (uint256 hash,
 {
   if (nIndex == -1)
     return uint256 ();
+  unsigned char pair[64];
   for (std::vector<uint256>::const_iterator it(vMerkleBranch.begin ());
        it != vMerkleBranch.end (); ++it)
   {
     if (nIndex & 1)
-      hash = Hash (BEGIN (*it), END (*it), BEGIN (hash), END (hash));
+      {
+        memcpy (pair, it->begin (), 32);
+        memcpy (pair + 32, hash.begin (), 32);
+      }
     else
-      hash = Hash (BEGIN (hash), END (hash), BEGIN (*it), END (*it));
+      {
+        memcpy (pair, hash.begin (), 32);
+        memcpy (pair + 32, it->begin (), 32);
+      }
+    SHA256D64 (hash.begin (), pair, 1);
     nIndex >>= 1;
   }
   return hash;
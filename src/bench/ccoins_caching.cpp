@@ -5,6 +5,7 @@
 #include "bench.h"
 #include "coins.h"
 #include "policy/policy.h"
+#include "random.h"
 #include "wallet/crypter.h"
 
 #include <vector>
@@ -35,14 +36,14 @@ SetupDummyInputs(CBasicKeyStore& keystoreRet, CCoinsViewCache& coinsRet)
     dummyTransactions[0].vout[0].scriptPubKey << ToByteVector(key[0].GetPubKey()) << OP_CHECKSIG;
     dummyTransactions[0].vout[1].nValue = 88 * CENT;
     dummyTransactions[0].vout[1].scriptPubKey << ToByteVector(key[1].GetPubKey()) << OP_CHECKSIG;
-    coinsRet.ModifyCoins(dummyTransactions[0].GetHash())->FromTx(dummyTransactions[0], 0);
+    AddCoins(coinsRet, dummyTransactions[0], 0);
 
     dummyTransactions[1].vout.resize(2);
     dummyTransactions[1].vout[0].nValue = 21 * CENT;
     dummyTransactions[1].vout[0].scriptPubKey = GetScriptForDestination(key[2].GetPubKey().GetID());
     dummyTransactions[1].vout[1].nValue = 22 * CENT;
     dummyTransactions[1].vout[1].scriptPubKey = GetScriptForDestination(key[3].GetPubKey().GetID());
-    coinsRet.ModifyCoins(dummyTransactions[1].GetHash())->FromTx(dummyTransactions[1], 0);
+    AddCoins(coinsRet, dummyTransactions[1], 0);
 
     return dummyTransactions;
 }
@@ -84,4 +85,65 @@ static void CCoinsCaching(benchmark::State& state)
     }
 }
 
+// Fill, query and empty a coins map the way the UTXO cache does during
+// block connection, once with pooled nodes (CCoinsMap) and once with every
+// node allocated on its own, to show what the pool saves.
+template <typename Map>
+static void CoinsMapChurn(benchmark::State& state)
+{
+    std::vector<COutPoint> outpoints;
+    for (int i = 0; i < 10000; i++)
+        outpoints.push_back(COutPoint(GetRandHash(), i % 4));
+    CTxOut txout(50 * CENT, CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 0) << OP_EQUALVERIFY << OP_CHECKSIG);
+
+    while (state.KeepRunning()) {
+        Map map;
+        for (size_t i = 0; i < outpoints.size(); i++) {
+            CCoinsCacheEntry& entry = map[outpoints[i]];
+            entry.coin = Coin(CTxOut(txout), i, false);
+            entry.flags = CCoinsCacheEntry::DIRTY | CCoinsCacheEntry::FRESH;
+        }
+        for (size_t i = 0; i < outpoints.size(); i += 2)
+            map.erase(outpoints[i]);
+        for (size_t i = 0; i < outpoints.size(); i += 2) {
+            CCoinsCacheEntry& entry = map[outpoints[i]];
+            entry.coin = Coin(CTxOut(txout), i, false);
+        }
+        for (size_t i = 0; i < outpoints.size(); i++)
+            assert(map.count(outpoints[i]));
+    }
+}
+
+// The short-lived map of a CCoinsViewCache made for one transaction, as in
+// AcceptToMemoryPool: a few inputs fetched, the outputs added, then gone.
+template <typename Map>
+static void CoinsMapPerTx(benchmark::State& state)
+{
+    std::vector<COutPoint> outpoints;
+    for (int i = 0; i < 5; i++)
+        outpoints.push_back(COutPoint(GetRandHash(), i));
+    CTxOut txout(50 * CENT, CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 0) << OP_EQUALVERIFY << OP_CHECKSIG);
+
+    while (state.KeepRunning()) {
+        Map map;
+        for (size_t i = 0; i < outpoints.size(); i++) {
+            CCoinsCacheEntry& entry = map[outpoints[i]];
+            entry.coin = Coin(CTxOut(txout), i, false);
+        }
+        for (size_t i = 0; i < outpoints.size(); i++)
+            assert(map.count(outpoints[i]));
+    }
+}
+
+typedef boost::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> CCoinsMapUnpooled;
+
+static void CCoinsMapPooled(benchmark::State& state) { CoinsMapChurn<CCoinsMap>(state); }
+static void CCoinsMapMalloc(benchmark::State& state) { CoinsMapChurn<CCoinsMapUnpooled>(state); }
+static void CCoinsMapPooledPerTx(benchmark::State& state) { CoinsMapPerTx<CCoinsMap>(state); }
+static void CCoinsMapMallocPerTx(benchmark::State& state) { CoinsMapPerTx<CCoinsMapUnpooled>(state); }
+
 BENCHMARK(CCoinsCaching);
+BENCHMARK(CCoinsMapPooled);
+BENCHMARK(CCoinsMapMalloc);
+BENCHMARK(CCoinsMapPooledPerTx);
+BENCHMARK(CCoinsMapMallocPerTx);
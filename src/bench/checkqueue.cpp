@@ -6,6 +6,7 @@
 #include "util.h"
 #include "validation.h"
 #include "checkqueue.h"
+#include "hash.h"
 #include "prevector.h"
 #include <vector>
 #include <boost/thread/thread.hpp>
@@ -99,5 +100,58 @@ static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
     tg.interrupt_all();
     tg.join_all();
 }
+
+// This Benchmark measures how verification of a block scales with the number
+// of threads. Every check does a few microseconds of hashing, roughly the
+// shape of a block full of small transactions: many Add calls with a couple
+// of checks each.
+static const size_t SCALING_TXS = 1000;
+static const size_t SCALING_INPUTS_PER_TX = 2;
+static const int SCALING_HASHES_PER_CHECK = 16;
+static void CCheckQueueScaling(benchmark::State& state, int nThreads)
+{
+    struct HashJob {
+        uint256 hash;
+        bool operator()()
+        {
+            for (int i = 0; i < SCALING_HASHES_PER_CHECK; i++)
+                hash = Hash(hash.begin(), hash.end());
+            return true;
+        }
+        void swap(HashJob& x){std::swap(hash, x.hash);};
+    };
+    CCheckQueue<HashJob> queue {QUEUE_BATCH_SIZE};
+    boost::thread_group tg;
+    // The master joins in when it waits, so it counts as one of the threads.
+    for (auto x = 0; x < nThreads - 1; ++x) {
+       tg.create_thread([&]{queue.Thread();});
+    }
+    while (state.KeepRunning()) {
+        CCheckQueueControl<HashJob> control(&queue);
+        std::vector<HashJob> vChecks;
+        for (size_t i = 0; i < SCALING_TXS; ++i) {
+            vChecks.resize(SCALING_INPUTS_PER_TX);
+            control.Add(vChecks);
+        }
+        control.Wait();
+    }
+    tg.interrupt_all();
+    tg.join_all();
+}
+static void CCheckQueueScaling_1(benchmark::State& state) { CCheckQueueScaling(state, 1); }
+static void CCheckQueueScaling_2(benchmark::State& state) { CCheckQueueScaling(state, 2); }
+static void CCheckQueueScaling_4(benchmark::State& state) { CCheckQueueScaling(state, 4); }
+static void CCheckQueueScaling_8(benchmark::State& state) { CCheckQueueScaling(state, 8); }
+static void CCheckQueueScaling_16(benchmark::State& state) { CCheckQueueScaling(state, 16); }
+static void CCheckQueueScaling_32(benchmark::State& state) { CCheckQueueScaling(state, 32); }
+static void CCheckQueueScaling_64(benchmark::State& state) { CCheckQueueScaling(state, 64); }
+
 BENCHMARK(CCheckQueueSpeed);
 BENCHMARK(CCheckQueueSpeedPrevectorJob);
+BENCHMARK(CCheckQueueScaling_1);
+BENCHMARK(CCheckQueueScaling_2);
+BENCHMARK(CCheckQueueScaling_4);
+BENCHMARK(CCheckQueueScaling_8);
+BENCHMARK(CCheckQueueScaling_16);
+BENCHMARK(CCheckQueueScaling_32);
+BENCHMARK(CCheckQueueScaling_64);
@@ -25,4 +25,18 @@ static void Scrypt(benchmark::State& state)
     }
 }
 
+static void ScryptMulti(benchmark::State& state)
+{
+    // One full getheaders reply worth of headers per iteration.
+    static const size_t COUNT = 2000;
+    std::vector<char> in(BUFFER_SIZE * COUNT, 0);
+    std::vector<uint256> output(COUNT);
+
+    while (state.KeepRunning())
+    {
+        scrypt_1024_1_1_256_multi(in.data(), BEGIN(output[0]), COUNT);
+    }
+}
+
 BENCHMARK(Scrypt);
+BENCHMARK(ScryptMulti);
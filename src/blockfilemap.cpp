@@ -0,0 +1,130 @@
+// Copyright (c) 2026 The Junkcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilemap.h"
+
+#include "chain.h"
+#include "crypto/common.h"
+#include "util.h"
+#include "validation.h"
+
+#include <errno.h>
+#include <string.h>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+CMappedFile::~CMappedFile()
+{
+#ifndef WIN32
+    munmap(const_cast<unsigned char*>(pbegin), nSize);
+#endif
+}
+
+std::shared_ptr<const CMappedFile> CMappedFile::Map(const boost::filesystem::path& path)
+{
+#ifdef WIN32
+    // Not implemented; the callers fall back to reading the file.
+    return std::shared_ptr<const CMappedFile>();
+#else
+    int fd = open(path.string().c_str(), O_RDONLY);
+    if (fd < 0)
+        return std::shared_ptr<const CMappedFile>();
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return std::shared_ptr<const CMappedFile>();
+    }
+    // A shared mapping sees what is written to the file after it was made.
+    void* p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        LogPrintf("Unable to map %s: %s\n", path.string(), strerror(errno));
+        return std::shared_ptr<const CMappedFile>();
+    }
+    return std::shared_ptr<const CMappedFile>(new CMappedFile(static_cast<const unsigned char*>(p), st.st_size));
+#endif
+}
+
+CBlockFileMap::CBlockFileMap(size_t nMaxFilesIn) : nMaxFiles(nMaxFilesIn)
+{
+}
+
+std::shared_ptr<const CMappedFile> CBlockFileMap::GetFile(const FileKey& key, size_t nMinSize)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    auto it = mapFiles.find(key);
+    if (it != mapFiles.end()) {
+        listLRU.splice(listLRU.begin(), listLRU, it->second.second);
+        if (it->second.first->size() >= nMinSize)
+            return it->second.first;
+    }
+
+    // Not mapped yet, or the file has grown since: map it (again).
+    std::shared_ptr<const CMappedFile> file = CMappedFile::Map(GetBlockPosFilename(CDiskBlockPos(key.second, 0), key.first.c_str()));
+    if (!file)
+        return file;
+    if (it != mapFiles.end()) {
+        it->second.first = file;
+    } else {
+        listLRU.push_front(key);
+        mapFiles.insert(std::make_pair(key, std::make_pair(file, listLRU.begin())));
+        while (mapFiles.size() > nMaxFiles) {
+            mapFiles.erase(listLRU.back());
+            listLRU.pop_back();
+        }
+    }
+    if (file->size() < nMinSize)
+        return std::shared_ptr<const CMappedFile>();
+    return file;
+}
+
+bool CBlockFileMap::GetRecord(const CDiskBlockPos& pos, const char* prefix, const CMessageHeader::MessageStartChars& messageStart, size_t nExtra, CByteSpan& span)
+{
+    // Records are preceded by the message start and their size.
+    const size_t nHeaderSize = CMessageHeader::MESSAGE_START_SIZE + 4;
+    if (pos.IsNull() || pos.nPos < nHeaderSize)
+        return false;
+    const FileKey key(prefix, pos.nFile);
+    std::shared_ptr<const CMappedFile> file = GetFile(key, pos.nPos);
+    if (!file)
+        return false;
+    const unsigned char* pheader = file->begin() + pos.nPos - nHeaderSize;
+    if (memcmp(pheader, messageStart, CMessageHeader::MESSAGE_START_SIZE) != 0)
+        return false;
+    const uint64_t nEnd = (uint64_t)pos.nPos + ReadLE32(pheader + CMessageHeader::MESSAGE_START_SIZE) + nExtra;
+    if (nEnd > file->size()) {
+        // The record may have been appended after the file was mapped.
+        file = GetFile(key, nEnd);
+        if (!file)
+            return false;
+    }
+    span.owner = file;
+    span.data = file->begin() + pos.nPos;
+    span.size = nEnd - pos.nPos;
+    return true;
+}
+
+void CBlockFileMap::Forget(int nFile)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    const char* prefixes[] = {"blk", "rev"};
+    for (const char* prefix : prefixes) {
+        auto it = mapFiles.find(FileKey(prefix, nFile));
+        if (it != mapFiles.end()) {
+            listLRU.erase(it->second.second);
+            mapFiles.erase(it);
+        }
+    }
+}
+
+size_t CBlockFileMap::GetMappedCount() const
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return mapFiles.size();
+}
@@ -0,0 +1,107 @@
+// Copyright (c) 2026 The Junkcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKFILEMAP_H
+#define BITCOIN_BLOCKFILEMAP_H
+
+#include "protocol.h"
+
+#include <list>
+#include <map>
+#include <memory>
+#include <stddef.h>
+#include <string>
+#include <utility>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/thread/mutex.hpp>
+
+struct CDiskBlockPos;
+
+/** Default number of block and undo files kept memory-mapped for reading (0 = read them with fread) */
+static const int DEFAULT_BLOCK_FILE_MAPS = sizeof(void*) >= 8 ? 64 : 0;
+
+/**
+ * A bounded range of bytes that is owned elsewhere. Holding on to the span
+ * keeps the memory alive, also when the file it came from is unmapped,
+ * replaced or deleted in the meantime.
+ */
+struct CByteSpan
+{
+    std::shared_ptr<const void> owner;
+    const unsigned char* data;
+    size_t size;
+
+    CByteSpan() : data(NULL), size(0) {}
+};
+
+/** A read-only memory mapping of a whole file */
+class CMappedFile
+{
+private:
+    const unsigned char* pbegin;
+    size_t nSize;
+
+    CMappedFile(const unsigned char* pbeginIn, size_t nSizeIn) : pbegin(pbeginIn), nSize(nSizeIn) {}
+
+public:
+    ~CMappedFile();
+
+    CMappedFile(const CMappedFile&) = delete;
+    CMappedFile& operator=(const CMappedFile&) = delete;
+
+    //! Map the file at path, or return NULL if it cannot be mapped
+    static std::shared_ptr<const CMappedFile> Map(const boost::filesystem::path& path);
+
+    const unsigned char* begin() const { return pbegin; }
+    size_t size() const { return nSize; }
+};
+
+/**
+ * Keeps recently used blk?????.dat and rev?????.dat files memory-mapped, so
+ * that blocks and undo data can be deserialized straight from the page
+ * cache instead of through a fopen, fseek and many small freads per read.
+ *
+ * Records are found the way WriteBlockToDisk and UndoWriteToDisk lay them
+ * out: the position points just past the message start and the size of the
+ * record. Mappings are reference counted; forgetting a file (because it was
+ * pruned or truncated) or evicting it only drops the map's reference, and
+ * spans handed out earlier stay valid until they are released.
+ *
+ * Thread safe.
+ */
+class CBlockFileMap
+{
+private:
+    typedef std::pair<std::string, int> FileKey;
+    typedef std::list<FileKey> LRUList;
+
+    mutable boost::mutex mutex;
+    //! Mapped files, and where they are in the LRU list
+    std::map<FileKey, std::pair<std::shared_ptr<const CMappedFile>, LRUList::iterator> > mapFiles;
+    //! Most recently used first
+    LRUList listLRU;
+    size_t nMaxFiles;
+
+    std::shared_ptr<const CMappedFile> GetFile(const FileKey& key, size_t nMinSize);
+
+public:
+    explicit CBlockFileMap(size_t nMaxFilesIn);
+
+    /**
+     * Find the record at pos in a blk (prefix "blk") or rev ("rev") file
+     * and return its bytes, followed by nExtra more, in span. Returns false
+     * if the file cannot be mapped, or if pos is not preceded by
+     * messageStart and a size that fits in the file.
+     */
+    bool GetRecord(const CDiskBlockPos& pos, const char* prefix, const CMessageHeader::MessageStartChars& messageStart, size_t nExtra, CByteSpan& span);
+
+    //! Drop the mappings of file nFile, which was pruned or truncated
+    void Forget(int nFile);
+
+    //! Number of files mapped right now
+    size_t GetMappedCount() const;
+};
+
+#endif // BITCOIN_BLOCKFILEMAP_H
@@ -0,0 +1,144 @@
+// Copyright (c) 2026 The Junkcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockreadahead.h"
+
+#include "chainparams.h"
+#include "core_memusage.h"
+#include "primitives/block.h"
+#include "util.h"
+#include "validation.h"
+
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
+CBlockReadAhead::CBlockReadAhead(size_t nMaxUsageIn) :
+    nReadyUsage(0), nMaxUsage(nMaxUsageIn), nThreads(0), nHits(0), nMisses(0)
+{
+}
+
+void CBlockReadAhead::StartThreads(boost::thread_group& threadGroup, int nThreadsIn)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        nThreads += nThreadsIn;
+    }
+    for (int i = 0; i < nThreadsIn; i++) {
+        boost::function<void()> threadFunc = boost::bind(&CBlockReadAhead::ThreadReadAhead, this);
+        threadGroup.create_thread(boost::bind(&TraceThread<boost::function<void()> >, "readahead", threadFunc));
+    }
+}
+
+void CBlockReadAhead::Request(const std::vector<const CBlockIndex*>& vpindex, const CChainParams& chainparams)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    if (nThreads == 0)
+        return;
+
+    queue.clear();
+    setWanted.clear();
+    BOOST_FOREACH(const CBlockIndex* pindex, vpindex) {
+        if (!(pindex->nStatus & BLOCK_HAVE_DATA))
+            continue;
+        const uint256 hash = pindex->GetBlockHash();
+        setWanted.insert(hash);
+        if (ready.count(hash) || setReading.count(hash))
+            continue;
+        // Same rule as ReadBlockFromDisk(CBlock&, const CBlockIndex*, ...):
+        // headers in the block tree already had their PoW checked.
+        Entry entry;
+        entry.hash = hash;
+        entry.pos = pindex->GetBlockPos();
+        entry.pparams = &chainparams.GetConsensus(pindex->nHeight);
+        entry.fCheckPOW = !pindex->IsValid(BLOCK_VALID_TREE);
+        queue.push_back(entry);
+    }
+
+    // Forget what was read for a path we are no longer on.
+    for (ReadyMap::iterator it = ready.begin(); it != ready.end(); ) {
+        if (setWanted.count(it->first)) {
+            it++;
+        } else {
+            nReadyUsage -= it->second.second;
+            ready.erase(it++);
+        }
+    }
+    condWorker.notify_all();
+}
+
+std::shared_ptr<const CBlock> CBlockReadAhead::Take(const CBlockIndex* pindex)
+{
+    const uint256 hash = pindex->GetBlockHash();
+    boost::unique_lock<boost::mutex> lock(mutex);
+    if (nThreads == 0)
+        return std::shared_ptr<const CBlock>();
+
+    while (setReading.count(hash))
+        condRead.wait(lock);
+    setWanted.erase(hash);
+
+    std::shared_ptr<const CBlock> pblock;
+    ReadyMap::iterator it = ready.find(hash);
+    if (it != ready.end()) {
+        pblock = it->second.first;
+        nReadyUsage -= it->second.second;
+        ready.erase(it);
+        nHits++;
+        condWorker.notify_all();
+    } else {
+        // The caller reads it now; make sure no worker does so as well.
+        for (std::deque<Entry>::iterator itQueue = queue.begin(); itQueue != queue.end(); itQueue++) {
+            if (itQueue->hash == hash) {
+                queue.erase(itQueue);
+                break;
+            }
+        }
+        nMisses++;
+    }
+    LogPrint("bench", "    - Block read ahead: %s (%u hits, %u misses, %u blocks / %.2fMiB ready)\n",
+        pblock ? "hit" : "miss", nHits, nMisses, ready.size(), nReadyUsage * (1.0 / (1 << 20)));
+    return pblock;
+}
+
+size_t CBlockReadAhead::GetReadyCount() const
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return ready.size();
+}
+
+void CBlockReadAhead::ThreadReadAhead()
+{
+    while (true) {
+        Entry entry;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            while (queue.empty() || nReadyUsage >= nMaxUsage)
+                condWorker.wait(lock);
+            entry = queue.front();
+            queue.pop_front();
+            setReading.insert(entry.hash);
+        }
+
+        std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+        bool fRead = ReadBlockFromDisk(*pblock, entry.pos, *entry.pparams, entry.fCheckPOW);
+        if (fRead && pblock->GetHash() != entry.hash)
+            fRead = error("%s: GetHash() doesn't match index for %s at %s", __func__, entry.hash.ToString(), entry.pos.ToString());
+
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            setReading.erase(entry.hash);
+            // On failure the block is left for ConnectTip to read, which
+            // reports the error properly.
+            if (fRead && setWanted.count(entry.hash)) {
+                size_t nUsage = sizeof(CBlock) + RecursiveDynamicUsage(*pblock);
+                ready.insert(std::make_pair(entry.hash, std::make_pair(std::shared_ptr<const CBlock>(pblock), nUsage)));
+                nReadyUsage += nUsage;
+            }
+        }
+        condRead.notify_all();
+        boost::this_thread::interruption_point();
+    }
+}
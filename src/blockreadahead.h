@@ -0,0 +1,103 @@
+// Copyright (c) 2026 The Junkcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKREADAHEAD_H
+#define BITCOIN_BLOCKREADAHEAD_H
+
+#include "chain.h"
+#include "uint256.h"
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <set>
+#include <stdint.h>
+#include <vector>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+class CBlock;
+class CChainParams;
+
+namespace boost {
+    class thread_group;
+} // namespace boost
+
+namespace Consensus {
+    struct Params;
+} // namespace Consensus
+
+/** Default memory used for blocks read ahead of the chain tip, in MiB (0 = disabled) */
+static const int64_t DEFAULT_BLOCK_READAHEAD = 32;
+
+/**
+ * Reads the blocks that are about to be connected from disk on a background
+ * thread, so that loading and deserializing the next blocks overlaps with
+ * connecting the current one.
+ *
+ * Request() is handed the blocks on the path to the best chain in the order
+ * they will be connected; Take() then returns a block that has already been
+ * read, waits for one that is being read, or returns NULL so that the caller
+ * reads it itself. Blocks that have been read are kept until taken or until
+ * they drop off the requested path, and reading pauses while they use more
+ * than the configured amount of memory.
+ */
+class CBlockReadAhead
+{
+private:
+    struct Entry {
+        uint256 hash;
+        CDiskBlockPos pos;
+        const Consensus::Params* pparams;
+        bool fCheckPOW;
+    };
+    typedef std::map<uint256, std::pair<std::shared_ptr<const CBlock>, size_t> > ReadyMap;
+
+    //! Protects everything below
+    mutable boost::mutex mutex;
+    //! Worker threads wait on this for requests and for memory to be freed
+    boost::condition_variable condWorker;
+    //! Take() waits on this for blocks that are being read
+    boost::condition_variable condRead;
+    //! Blocks waiting to be read, in connection order
+    std::deque<Entry> queue;
+    //! Blocks that are being read right now
+    std::set<uint256> setReading;
+    //! Blocks on the most recently requested path that have not been taken yet
+    std::set<uint256> setWanted;
+    //! Blocks that have been read, and their memory usage
+    ReadyMap ready;
+    size_t nReadyUsage;
+    //! Reading pauses when nReadyUsage reaches this
+    size_t nMaxUsage;
+    //! Number of running worker threads; Request() is a no-op without any
+    int nThreads;
+    //! Statistics
+    uint64_t nHits;
+    uint64_t nMisses;
+
+    void ThreadReadAhead();
+
+public:
+    explicit CBlockReadAhead(size_t nMaxUsageIn);
+
+    //! Start nThreadsIn worker threads in threadGroup
+    void StartThreads(boost::thread_group& threadGroup, int nThreadsIn);
+
+    /**
+     * Replace the blocks to read ahead with vpindex, in connection order.
+     * Blocks that were read earlier and are no longer on the path are
+     * dropped. Must be called with cs_main held.
+     */
+    void Request(const std::vector<const CBlockIndex*>& vpindex, const CChainParams& chainparams);
+
+    //! Return the block for pindex if it was read ahead, NULL otherwise
+    std::shared_ptr<const CBlock> Take(const CBlockIndex* pindex);
+
+    //! Number of blocks read and not yet taken
+    size_t GetReadyCount() const;
+};
+
+#endif // BITCOIN_BLOCKREADAHEAD_H
@@ -5,25 +5,59 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "chain.h"
+#include "clientversion.h"
+#include "junkcoin.h"
+#include "streams.h"
+#include "txdb.h"
 #include "validation.h"
 
 using namespace std;
 
+static void CacheAuxPow(const CBlockIndex* pindex, const CAuxPow& auxpow)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << auxpow;
+    auxpowCache.Insert(pindex, std::make_shared<const std::vector<unsigned char> >(ss.begin(), ss.end()));
+}
+
 /* Moved here from the header, because we need auxpow and the logic
    becomes more involved.  */
-CBlockHeader CBlockIndex::GetBlockHeader(const Consensus::Params& consensusParams, bool fCheckPOW) const
+bool CBlockIndex::GetBlockHeader(CBlockHeader& block, const Consensus::Params& consensusParams, bool fCheckPOW) const
 {
-    CBlockHeader block;
+    block.SetNull();
 
     block.nVersion       = nVersion;
 
     /* The CBlockIndex object's block header is missing the auxpow.
-       So if this is an auxpow block, read it from disk instead.  We only
-       have to read the actual *header*, not the full block.  */
+       So if this is an auxpow block, take it from the auxpow cache or the
+       block tree database.  Headers accepted before the database kept the
+       auxpow, or whose auxpow can no longer be read from it, are read from
+       disk instead.  We only have to read the actual *header*, not the full
+       block.  */
     if (block.IsAuxpow())
     {
-        ReadBlockHeaderFromDisk(block, this, consensusParams, fCheckPOW);
-        return block;
+        CLRUCache<const CBlockIndex*>::value_ptr pauxpow = auxpowCache.Get(this);
+        if (pauxpow) {
+            CDataStream ss(*pauxpow, SER_DISK, CLIENT_VERSION);
+            block.auxpow.reset(new CAuxPow());
+            ss >> *block.auxpow;
+        } else if (nStatus & BLOCK_HAVE_AUXPOW) {
+            block.auxpow.reset(new CAuxPow());
+            if (pblocktree->ReadAuxPow(GetBlockHash(), *block.auxpow)) {
+                CacheAuxPow(this, *block.auxpow);
+            } else {
+                error("%s: failed to read auxpow of %s", __func__, ToString());
+                block.auxpow.reset();
+            }
+        }
+        if (!block.auxpow) {
+            if (!ReadBlockHeaderFromDisk(block, this, consensusParams, fCheckPOW))
+                return false;
+            if (!block.auxpow)
+                return error("%s: no auxpow in block file for %s", __func__, ToString());
+            CacheAuxPow(this, *block.auxpow);
+            return true;
+        }
     }
 
     if (pprev)
@@ -32,7 +66,11 @@ CBlockHeader CBlockIndex::GetBlockHeader(const Consensus::Params& consensusParam
     block.nTime          = nTime;
     block.nBits          = nBits;
     block.nNonce         = nNonce;
-    return block;
+
+    if (block.auxpow && fCheckPOW && (fCheckBlockReads || !IsValid(BLOCK_VALID_TREE)) && !CheckAuxPowProofOfWork(block, consensusParams))
+        error("%s: Errors in block header of %s", __func__, ToString());
+
+    return true;
 }
 
 /**
@@ -147,6 +185,23 @@ void CBlockIndex::BuildSkip()
         pskip = pprev->GetAncestor(GetSkipHeight(nHeight));
 }
 
+CBlockIndex* CBlockIndexArena::Allocate()
+{
+    if (nUsedInLast == BLOCK_INDEX_ARENA_CHUNK) {
+        vChunks.push_back(new CBlockIndex[BLOCK_INDEX_ARENA_CHUNK]);
+        nUsedInLast = 0;
+    }
+    return &vChunks.back()[nUsedInLast++];
+}
+
+void CBlockIndexArena::Clear()
+{
+    for (size_t i = 0; i < vChunks.size(); i++)
+        delete[] vChunks[i];
+    vChunks.clear();
+    nUsedInLast = BLOCK_INDEX_ARENA_CHUNK;
+}
+
 arith_uint256 GetBlockProof(const CBlockIndex& block)
 {
     arith_uint256 bnTarget;
@@ -148,6 +148,8 @@ enum BlockStatus: uint32_t {
     BLOCK_FAILED_MASK        =   BLOCK_FAILED_VALID | BLOCK_FAILED_CHILD,
 
     BLOCK_OPT_WITNESS       =   128, //!< block data in blk*.data was received with a witness-enforcing client
+
+    BLOCK_HAVE_AUXPOW        =  256, //!< auxpow of the header stored in the block tree database
 };
 
 /** The block chain is a tree shaped structure starting with the
@@ -158,8 +160,8 @@ enum BlockStatus: uint32_t {
 class CBlockIndex
 {
 public:
-    //! pointer to the hash of the block, if any. Memory is owned by this CBlockIndex
-    const uint256* phashBlock;
+    // The fields used when walking the block tree (GetAncestor, FindMostWorkChain,
+    // CheckBlockIndex) come first, so that they share as few cache lines as possible.
 
     //! pointer to the index of the predecessor of this block
     CBlockIndex* pprev;
@@ -170,29 +172,38 @@ public:
     //! height of the entry in the chain. The genesis block has height 0
     int nHeight;
 
-    //! Which # file this block is stored in (blk?????.dat)
-    int nFile;
-
-    //! Byte offset within blk?????.dat where this block's data is stored
-    unsigned int nDataPos;
-
-    //! Byte offset within rev?????.dat where this block's undo data is stored
-    unsigned int nUndoPos;
+    //! Verification status of this block. See enum BlockStatus
+    unsigned int nStatus;
 
     //! (memory only) Total amount of work (expected number of hashes) in the chain up to and including this block
     arith_uint256 nChainWork;
 
-    //! Number of transactions in this block.
-    //! Note: in a potential headers-first mode, this number cannot be relied upon
-    unsigned int nTx;
+    //! pointer to the hash of the block, if any. Memory is owned by this CBlockIndex
+    const uint256* phashBlock;
 
     //! (memory only) Number of transactions in the chain up to and including this block.
     //! This value will be non-zero only if and only if transactions for this block and all its parents are available.
     //! Change to 64-bit type when necessary; won't happen before 2030
     unsigned int nChainTx;
 
-    //! Verification status of this block. See enum BlockStatus
-    unsigned int nStatus;
+    //! (memory only) Sequential id assigned to distinguish order in which blocks are received.
+    int32_t nSequenceId;
+
+    //! Number of transactions in this block.
+    //! Note: in a potential headers-first mode, this number cannot be relied upon
+    unsigned int nTx;
+
+    //! Which # file this block is stored in (blk?????.dat)
+    int nFile;
+
+    //! Byte offset within blk?????.dat where this block's data is stored
+    unsigned int nDataPos;
+
+    //! Byte offset within rev?????.dat where this block's undo data is stored
+    unsigned int nUndoPos;
+
+    //! (memory only) Maximum nTime in the chain upto and including this block.
+    unsigned int nTimeMax;
 
     //! block header
     int nVersion;
@@ -201,12 +212,6 @@ public:
     unsigned int nBits;
     unsigned int nNonce;
 
-    //! (memory only) Sequential id assigned to distinguish order in which blocks are received.
-    int32_t nSequenceId;
-
-    //! (memory only) Maximum nTime in the chain upto and including this block.
-    unsigned int nTimeMax;
-
     void SetNull()
     {
         phashBlock = NULL;
@@ -264,7 +269,11 @@ public:
         return ret;
     }
 
-    CBlockHeader GetBlockHeader(const Consensus::Params& consensusParams, bool fCheckPOW = true) const;
+    /**
+     * Rebuild the block header, with its auxpow if it has one. Returns false
+     * if the auxpow cannot be found, as such a header cannot be serialized.
+     */
+    bool GetBlockHeader(CBlockHeader& block, const Consensus::Params& consensusParams, bool fCheckPOW = true) const;
 
     uint256 GetBlockHash() const
     {
@@ -429,6 +438,38 @@ public:
     }
 };
 
+/**
+ * Storage for the entries of the block index. Entries are allocated next to
+ * each other, in chunks of BLOCK_INDEX_ARENA_CHUNK, instead of one by one on
+ * the heap. They are never moved or freed individually, so pointers to them
+ * stay valid until Clear().
+ */
+class CBlockIndexArena
+{
+private:
+    static const size_t BLOCK_INDEX_ARENA_CHUNK = 4096;
+
+    std::vector<CBlockIndex*> vChunks;
+    //! Entries handed out from the last chunk
+    size_t nUsedInLast;
+
+public:
+    CBlockIndexArena() : nUsedInLast(BLOCK_INDEX_ARENA_CHUNK) {}
+    ~CBlockIndexArena() { Clear(); }
+
+    CBlockIndexArena(const CBlockIndexArena&) = delete;
+    CBlockIndexArena& operator=(const CBlockIndexArena&) = delete;
+
+    //! Return a new, null entry
+    CBlockIndex* Allocate();
+
+    //! Free all entries
+    void Clear();
+
+    //! Number of entries handed out
+    size_t size() const { return vChunks.empty() ? 0 : (vChunks.size() - 1) * BLOCK_INDEX_ARENA_CHUNK + nUsedInLast; }
+};
+
 /** An in-memory indexed chain of blocks. */
 class CChain {
 private:
@@ -489,4 +530,45 @@ public:
     CBlockIndex* FindEarliestAtLeast(int64_t nTime) const;
 };
 
+/**
+ * An immutable view of a chain, given by its tip. It can be used without
+ * the lock of the chain it was taken from: the entries of a chain, and the
+ * pprev, pskip and nHeight fields used to walk it, do not change once they
+ * are in the block index. Heights are looked up through the skip list, so
+ * operator[] takes O(log n) instead of CChain's O(1).
+ */
+class CChainTip {
+private:
+    const CBlockIndex* pindexTip;
+
+public:
+    explicit CChainTip(const CBlockIndex* pindexTipIn) : pindexTip(pindexTipIn) {}
+
+    /** Returns the index entry for the tip of this chain, or NULL if none. */
+    const CBlockIndex* Tip() const { return pindexTip; }
+
+    /** Return the maximal height in the chain, -1 if it is empty. */
+    int Height() const { return pindexTip ? pindexTip->nHeight : -1; }
+
+    /** Returns the index entry at a particular height in this chain, or NULL if no such height exists. */
+    const CBlockIndex* operator[](int nHeight) const {
+        if (nHeight < 0 || nHeight > Height())
+            return NULL;
+        return pindexTip->GetAncestor(nHeight);
+    }
+
+    /** Check whether a block is present in this chain. */
+    bool Contains(const CBlockIndex* pindex) const {
+        return (*this)[pindex->nHeight] == pindex;
+    }
+
+    /** Find the successor of a block in this chain, or NULL if the given index is not found or is the tip. */
+    const CBlockIndex* Next(const CBlockIndex* pindex) const {
+        if (Contains(pindex))
+            return (*this)[pindex->nHeight + 1];
+        else
+            return NULL;
+    }
+};
+
 #endif // BITCOIN_CHAIN_H
@@ -6,17 +6,25 @@
 #define BITCOIN_CHECKQUEUE_H
 
 #include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <stdint.h>
 #include <vector>
 
 #include <boost/foreach.hpp>
 #include <boost/thread/condition_variable.hpp>
 #include <boost/thread/locks.hpp>
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+/** Maximum number of worker threads a CCheckQueue can use (the master comes on top) */
+static const int MAX_CHECKQUEUE_THREADS = 256;
 
 template <typename T>
 class CCheckQueueControl;
 
-/** 
+/**
  * Queue for verifications that have to be performed.
   * The verifications are represented by a type T, which must provide an
   * operator(), returning a bool.
@@ -25,12 +33,48 @@ class CCheckQueueControl;
   * onto the queue, where they are processed by N-1 worker threads. When
   * the master is done adding work, it temporarily joins the worker pool
   * as an N'th worker, until all jobs are done.
+  *
+  * Every worker, and the master, owns a slot with a deque of verifications.
+  * Add() hands each batch to the next worker's inbox, a lock-free list that
+  * the master pushes onto without taking any lock. Workers move what is in
+  * their inbox into their deque and take verifications from its back; a
+  * worker that runs dry takes over another slot's inbox or steals half of
+  * its deque from the front. Locks are only held per slot, and only taken
+  * by the owner and by thieves, so workers rarely contend with each other.
   */
 template <typename T>
 class CCheckQueue
 {
 private:
-    //! Mutex to protect the inner state
+    //! A batch of verifications passed to Add(), waiting in an inbox
+    struct Batch {
+        std::vector<T> checks;
+        Batch* next;
+    };
+
+    struct Slot {
+        //! Protects checks
+        boost::mutex mutex;
+        //! Verifications taken from an inbox and not yet started
+        std::deque<T> checks;
+        //! Batches added for this slot; pushed to without locking and
+        //! emptied by exchanging the whole list at once
+        std::atomic<Batch*> inbox;
+        //! Whether a worker currently owns this slot
+        std::atomic<bool> fActive;
+        //! State of the random number generator used to pick victims
+        uint32_t nRand;
+
+        Slot() : inbox(nullptr), fActive(false), nRand(0) {}
+    };
+
+    //! Slot 0 belongs to the master, the others to worker threads
+    std::unique_ptr<Slot[]> slots;
+
+    //! The number of slots that have been handed out, including the master's
+    std::atomic<int> nSlots;
+
+    //! Protects the handing out of slots, and the waits below
     boost::mutex mutex;
 
     //! Worker threads block on this when out of work
@@ -39,90 +83,160 @@ private:
     //! Master thread blocks on this when out of work
     boost::condition_variable condMaster;
 
-    //! The queue of elements to be processed.
-    //! As the order of booleans doesn't matter, it is used as a LIFO (stack)
-    std::vector<T> queue;
+    //! The number of workers that are blocked on condWorker.
+    std::atomic<int> nIdle;
 
-    //! The number of workers (including the master) that are idle.
-    int nIdle;
-
-    //! The total number of workers (including the master).
-    int nTotal;
-
-    //! The temporary evaluation result.
-    bool fAllOk;
+    //! Number of verifications that were added and not yet taken for execution.
+    std::atomic<unsigned int> nQueued;
 
     /**
      * Number of verifications that haven't completed yet.
      * This includes elements that are no longer queued, but still in the
      * worker's own batches.
      */
-    unsigned int nTodo;
+    std::atomic<unsigned int> nTodo;
 
-    //! Whether we're shutting down.
-    bool fQuit;
+    //! The temporary evaluation result.
+    std::atomic<bool> fAllOk;
+
+    //! Slot that the next batch is added to
+    unsigned int nNextSlot;
 
     //! The maximum number of elements to be processed in one batch
     unsigned int nBatchSize;
 
+    //! Move the verifications in a list of batches to the back of a deque
+    static void MoveBatches(Batch* pbatch, std::deque<T>& checks)
+    {
+        while (pbatch) {
+            BOOST_FOREACH (T& check, pbatch->checks) {
+                checks.push_back(T());
+                check.swap(checks.back());
+            }
+            Batch* pnext = pbatch->next;
+            delete pbatch;
+            pbatch = pnext;
+        }
+    }
+
+    /**
+     * Take up to nBatchSize verifications from the back of our own deque,
+     * refilling it from our inbox. Returns the number taken.
+     */
+    unsigned int TakeOwn(Slot& self, std::vector<T>& vChecks)
+    {
+        Batch* pbatch = self.inbox.exchange(nullptr);
+        boost::unique_lock<boost::mutex> lock(self.mutex);
+        MoveBatches(pbatch, self.checks);
+        // Leave half of what we have for thieves, so that a single large
+        // batch is spread over all workers, and all of them finish
+        // approximately simultaneously.
+        unsigned int nNow = std::max(1U, std::min(nBatchSize, (unsigned int)(self.checks.size() / 2)));
+        nNow = std::min(nNow, (unsigned int)self.checks.size());
+        vChecks.resize(nNow);
+        for (unsigned int i = 0; i < nNow; i++) {
+            vChecks[i].swap(self.checks.back());
+            self.checks.pop_back();
+        }
+        return nNow;
+    }
+
+    /**
+     * Move work from another slot into our own deque: the contents of its
+     * inbox if there are any, otherwise the front half of its deque.
+     * Returns whether anything was found.
+     */
+    bool Steal(Slot& self)
+    {
+        int nSlotsNow = nSlots.load();
+        self.nRand = self.nRand * 1103515245 + 12345;
+        int nStart = (self.nRand >> 16) % nSlotsNow;
+        for (int i = 0; i < nSlotsNow; i++) {
+            Slot& victim = slots[(nStart + i) % nSlotsNow];
+            if (&victim == &self)
+                continue;
+            Batch* pbatch = victim.inbox.exchange(nullptr);
+            std::deque<T> stolen;
+            if (pbatch) {
+                MoveBatches(pbatch, stolen);
+            } else {
+                boost::unique_lock<boost::mutex> lock(victim.mutex);
+                size_t nSteal = (victim.checks.size() + 1) / 2;
+                for (size_t j = 0; j < nSteal; j++) {
+                    stolen.push_back(T());
+                    stolen.back().swap(victim.checks.front());
+                    victim.checks.pop_front();
+                }
+            }
+            if (stolen.empty())
+                continue;
+            boost::unique_lock<boost::mutex> lock(self.mutex);
+            BOOST_FOREACH (T& check, stolen) {
+                self.checks.push_back(T());
+                check.swap(self.checks.back());
+            }
+            return true;
+        }
+        return false;
+    }
+
     /** Internal function that does bulk of the verification work. */
-    bool Loop(bool fMaster = false)
+    bool Loop(Slot& self, bool fMaster = false)
     {
-        boost::condition_variable& cond = fMaster ? condMaster : condWorker;
         std::vector<T> vChecks;
         vChecks.reserve(nBatchSize);
-        unsigned int nNow = 0;
-        bool fOk = true;
         do {
-            {
-                boost::unique_lock<boost::mutex> lock(mutex);
-                // first do the clean-up of the previous loop run (allowing us to do it in the same critsect)
-                if (nNow) {
-                    fAllOk &= fOk;
-                    nTodo -= nNow;
-                    if (nTodo == 0 && !fMaster)
-                        // We processed the last element; inform the master it can exit and return the result
-                        condMaster.notify_one();
-                } else {
-                    // first iteration
-                    nTotal++;
+            unsigned int nNow = TakeOwn(self, vChecks);
+            if (nNow == 0 && Steal(self))
+                nNow = TakeOwn(self, vChecks);
+            if (nNow) {
+                nQueued -= nNow;
+                // Check whether we need to do work at all
+                bool fOk = fAllOk;
+                // execute work
+                BOOST_FOREACH (T& check, vChecks)
+                    if (fOk)
+                        fOk = check();
+                // The verifications must be gone before the master may return.
+                vChecks.clear();
+                if (!fOk)
+                    fAllOk = false;
+                if ((nTodo -= nNow) == 0 && !fMaster) {
+                    // We processed the last element; inform the master it can exit and return the result
+                    boost::unique_lock<boost::mutex> lock(mutex);
+                    condMaster.notify_one();
                 }
-                // logically, the do loop starts here
-                while (queue.empty()) {
-                    if ((fMaster || fQuit) && nTodo == 0) {
-                        nTotal--;
-                        bool fRet = fAllOk;
-                        // reset the status for new work later
-                        if (fMaster)
-                            fAllOk = true;
-                        // return the current status
-                        return fRet;
-                    }
-                    nIdle++;
-                    cond.wait(lock); // wait
-                    nIdle--;
+                continue;
+            }
+
+            if (nQueued != 0) {
+                // Work is being moved between slots; look again shortly.
+                boost::this_thread::yield();
+                continue;
+            }
+
+            boost::unique_lock<boost::mutex> lock(mutex);
+            if (fMaster) {
+                while (nTodo != 0 && nQueued == 0)
+                    condMaster.wait(lock); // wait
+                if (nTodo == 0) {
+                    bool fRet = fAllOk;
+                    // reset the status for new work later
+                    fAllOk = true;
+                    // return the current status
+                    return fRet;
                 }
-                // Decide how many work units to process now.
-                // * Do not try to do everything at once, but aim for increasingly smaller batches so
-                //   all workers finish approximately simultaneously.
-                // * Try to account for idle jobs which will instantly start helping.
-                // * Don't do batches smaller than 1 (duh), or larger than nBatchSize.
-                nNow = std::max(1U, std::min(nBatchSize, (unsigned int)queue.size() / (nTotal + nIdle + 1)));
-                vChecks.resize(nNow);
-                for (unsigned int i = 0; i < nNow; i++) {
-                    // We want the lock on the mutex to be as short as possible, so swap jobs from the global
-                    // queue to the local batch vector instead of copying.
-                    vChecks[i].swap(queue.back());
-                    queue.pop_back();
+            } else {
+                nIdle++;
+                try {
+                    while (nQueued == 0)
+                        condWorker.wait(lock); // wait
+                } catch (...) {
+                    nIdle--;
+                    throw;
                 }
-                // Check whether we need to do work at all
-                fOk = fAllOk;
+                nIdle--;
             }
-            // execute work
-            BOOST_FOREACH (T& check, vChecks)
-                if (fOk)
-                    fOk = check();
-            vChecks.clear();
         } while (true);
     }
 
@@ -131,42 +245,94 @@ public:
     boost::mutex ControlMutex;
 
     //! Create a new check queue
-    CCheckQueue(unsigned int nBatchSizeIn) : nIdle(0), nTotal(0), fAllOk(true), nTodo(0), fQuit(false), nBatchSize(nBatchSizeIn) {}
+    CCheckQueue(unsigned int nBatchSizeIn) : slots(new Slot[MAX_CHECKQUEUE_THREADS + 1]), nSlots(1), nIdle(0), nQueued(0), nTodo(0), fAllOk(true), nNextSlot(0), nBatchSize(nBatchSizeIn)
+    {
+        for (int i = 0; i <= MAX_CHECKQUEUE_THREADS; i++)
+            slots[i].nRand = i;
+        slots[0].fActive = true;
+    }
 
-    //! Worker thread
+    //! Worker thread. Returns immediately if MAX_CHECKQUEUE_THREADS workers are already running.
     void Thread()
     {
-        Loop();
+        Slot* pslot = NULL;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            for (int i = 1; i < nSlots && !pslot; i++) {
+                if (!slots[i].fActive)
+                    pslot = &slots[i];
+            }
+            if (!pslot && nSlots <= MAX_CHECKQUEUE_THREADS)
+                pslot = &slots[nSlots++];
+            if (!pslot)
+                return;
+            pslot->fActive = true;
+        }
+        try {
+            Loop(*pslot);
+        } catch (...) {
+            // A worker only stops while waiting for work, so it leaves
+            // nothing behind in its slot.
+            pslot->fActive = false;
+            throw;
+        }
+        pslot->fActive = false;
     }
 
     //! Wait until execution finishes, and return whether all evaluations were successful.
     bool Wait()
     {
-        return Loop(true);
+        return Loop(slots[0], true);
     }
 
     //! Add a batch of checks to the queue
     void Add(std::vector<T>& vChecks)
     {
-        boost::unique_lock<boost::mutex> lock(mutex);
-        BOOST_FOREACH (T& check, vChecks) {
-            queue.push_back(T());
-            check.swap(queue.back());
-        }
+        if (vChecks.empty())
+            return;
+        // Count the work before it becomes visible, so that it can never be
+        // finished before it was counted.
         nTodo += vChecks.size();
-        if (vChecks.size() == 1)
-            condWorker.notify_one();
-        else if (vChecks.size() > 1)
-            condWorker.notify_all();
+        nQueued += vChecks.size();
+
+        Batch* pbatch = new Batch();
+        pbatch->checks.resize(vChecks.size());
+        for (size_t i = 0; i < vChecks.size(); i++)
+            vChecks[i].swap(pbatch->checks[i]);
+
+        // Hand the batch to the next running worker, or keep it for the
+        // master if there are none.
+        int nSlotsNow = nSlots;
+        Slot* pslot = &slots[0];
+        for (int i = 0; i < nSlotsNow - 1; i++) {
+            Slot& slot = slots[1 + (nNextSlot++ % (nSlotsNow - 1))];
+            if (slot.fActive) {
+                pslot = &slot;
+                break;
+            }
+        }
+        pbatch->next = pslot->inbox.load();
+        while (!pslot->inbox.compare_exchange_weak(pbatch->next, pbatch)) {}
+
+        if (nIdle != 0) {
+            // Wake no more workers than there are checks to take.
+            boost::unique_lock<boost::mutex> lock(mutex);
+            for (size_t i = 0; i < vChecks.size() && i < (size_t)nIdle; i++)
+                condWorker.notify_one();
+        }
     }
 
     ~CCheckQueue()
     {
+        for (int i = 0; i < nSlots; i++) {
+            std::deque<T> checks;
+            MoveBatches(slots[i].inbox.exchange(nullptr), checks);
+        }
     }
 
 };
 
-/** 
+/**
  * RAII-style controller object for a CCheckQueue that guarantees the passed
  * queue is finished before continuing.
  */
@@ -0,0 +1,154 @@
+// Copyright (c) 2026 The Junkcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "coinsflush.h"
+
+#include "util.h"
+#include "utiltime.h"
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
+CCoinsViewFlusher::CCoinsViewFlusher(CCoinsView* viewIn, const CUTXOCommitment* pcommitmentSourceIn) :
+    CCoinsViewBacked(viewIn), pcommitmentSource(pcommitmentSourceIn), fPending(false), fRunning(false), fFailed(false)
+{
+}
+
+bool CCoinsViewFlusher::GetCoin(const COutPoint &outpoint, Coin &coin) const
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (fPending) {
+            CCoinsMap::const_iterator it = mapWriting.find(outpoint);
+            if (it != mapWriting.end()) {
+                // Spent entries are either being erased or were never there.
+                coin = it->second.coin;
+                return !coin.IsSpent();
+            }
+        }
+    }
+    return base->GetCoin(outpoint, coin);
+}
+
+bool CCoinsViewFlusher::HaveCoin(const COutPoint &outpoint) const
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (fPending) {
+            CCoinsMap::const_iterator it = mapWriting.find(outpoint);
+            if (it != mapWriting.end())
+                return !it->second.coin.IsSpent();
+        }
+    }
+    return base->HaveCoin(outpoint);
+}
+
+uint256 CCoinsViewFlusher::GetBestBlock() const
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (fPending && !hashWriting.IsNull())
+            return hashWriting;
+    }
+    return base->GetBestBlock();
+}
+
+bool CCoinsViewFlusher::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock)
+{
+    if (!Sync())
+        return false;
+
+    boost::unique_lock<boost::mutex> lock(mutex);
+    // mapWriting is empty after the last batch, so this leaves mapCoins empty too.
+    mapWriting.swap(mapCoins);
+    hashWriting = hashBlock;
+    if (pcommitmentSource)
+        commitmentWriting = *pcommitmentSource;
+    fPending = true;
+    if (!fRunning) {
+        lock.unlock();
+        return Sync();
+    }
+    condWriter.notify_one();
+    return true;
+}
+
+bool CCoinsViewFlusher::Sync()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    while (fPending && fRunning)
+        condDone.wait(lock);
+    if (fPending) {
+        // Nobody is going to write it for us.
+        lock.unlock();
+        WriteBatch();
+        lock.lock();
+    }
+    return !fFailed;
+}
+
+bool CCoinsViewFlusher::IsWriting() const
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return fPending;
+}
+
+void CCoinsViewFlusher::WriteBatch()
+{
+    // mapWriting and the rest of the batch are not touched by anyone else
+    // until fPending is reset, so no lock is needed to read them.
+    int64_t nStart = GetTimeMicros();
+    size_t nEntries = mapWriting.size();
+    bool fOk;
+    try {
+        fOk = base->BatchWrite(mapWriting, hashWriting);
+    } catch (const std::exception& e) {
+        PrintExceptionContinue(&e, "CCoinsViewFlusher::WriteBatch()");
+        fOk = false;
+    }
+    LogPrint("coindb", "Wrote %u coins cache entries in %.2fms\n", nEntries, 0.001 * (GetTimeMicros() - nStart));
+
+    CCoinsMap mapWritten;
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        mapWritten.swap(mapWriting);
+        fPending = false;
+        if (!fOk)
+            fFailed = true;
+        condDone.notify_all();
+    }
+    // mapWritten is freed here, without holding the lock.
+}
+
+void CCoinsViewFlusher::StartThread(boost::thread_group& threadGroup)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fRunning = true;
+    }
+    boost::function<void()> threadFunc = boost::bind(&CCoinsViewFlusher::ThreadFlush, this);
+    threadGroup.create_thread(boost::bind(&TraceThread<boost::function<void()> >, "coinsflush", threadFunc));
+}
+
+void CCoinsViewFlusher::ThreadFlush()
+{
+    try {
+        while (true) {
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                while (!fPending)
+                    condWriter.wait(lock);
+            }
+            WriteBatch();
+        }
+    } catch (...) {
+        // Interrupted while waiting for a batch. One may just have been
+        // handed over, which Sync() will then write instead.
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fRunning = false;
+        condDone.notify_all();
+        throw;
+    }
+}
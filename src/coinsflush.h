@@ -0,0 +1,87 @@
+// Copyright (c) 2026 The Junkcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_COINSFLUSH_H
+#define BITCOIN_COINSFLUSH_H
+
+#include "coins.h"
+#include "utxocommitment.h"
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace boost {
+    class thread_group;
+} // namespace boost
+
+/** Default for -backgroundflush, writing the coins cache to disk in a separate thread */
+static const bool DEFAULT_BACKGROUND_FLUSH = true;
+
+/**
+ * CCoinsView that sits right below the coins cache (pcoinsTip) and writes
+ * what the cache flushes to the views below it in a background thread.
+ *
+ * BatchWrite() takes over the flushed entries (leaving the cache above
+ * empty) together with the best block and a copy of the UTXO commitment,
+ * and returns as soon as the writer thread has been handed the batch.
+ * Until that batch is committed, lookups that it covers are answered from
+ * it, so the views below are never seen in a half-written state. The best
+ * block marker and commitment are part of the same database batch as the
+ * coins, so they only change on disk once all of it has been written.
+ *
+ * Only one batch is in flight at a time: a flush while the previous one is
+ * still being written waits for it. Without a writer thread, every batch
+ * is written before BatchWrite() returns. Cursor() iterates over the views
+ * below as they are, so Sync() first for a complete view.
+ *
+ * The views below must not modify the map passed to their BatchWrite(), as
+ * it is read concurrently while being written.
+ */
+class CCoinsViewFlusher : public CCoinsViewBacked
+{
+private:
+    //! Protects everything below
+    mutable boost::mutex mutex;
+    //! The writer thread waits on this for a batch
+    boost::condition_variable condWriter;
+    //! Notified whenever a batch is done or the writer thread exits
+    mutable boost::condition_variable condDone;
+    //! The batch being written, valid while fPending
+    CCoinsMap mapWriting;
+    uint256 hashWriting;
+    CUTXOCommitment commitmentWriting;
+    //! Copied into commitmentWriting with every batch, if not NULL
+    const CUTXOCommitment* pcommitmentSource;
+    //! A batch was handed over and has not been committed yet
+    bool fPending;
+    //! Whether the writer thread is running
+    bool fRunning;
+    //! A batch failed to be written; no more are accepted
+    bool fFailed;
+
+    void WriteBatch();
+    void ThreadFlush();
+
+public:
+    CCoinsViewFlusher(CCoinsView* viewIn, const CUTXOCommitment* pcommitmentSourceIn);
+
+    bool GetCoin(const COutPoint &outpoint, Coin &coin) const;
+    bool HaveCoin(const COutPoint &outpoint) const;
+    uint256 GetBestBlock() const;
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock);
+
+    //! Start the writer thread in threadGroup
+    void StartThread(boost::thread_group& threadGroup);
+
+    //! Wait until the batch in flight, if any, is committed. Returns false if a batch failed.
+    bool Sync();
+
+    //! The copy of the commitment that belongs to the batch being written
+    const CUTXOCommitment* GetWritingCommitment() const { return &commitmentWriting; }
+
+    //! Whether a batch is being written
+    bool IsWriting() const;
+};
+
+#endif // BITCOIN_COINSFLUSH_H
@@ -0,0 +1,194 @@
+// Copyright (c) 2026 The Junkcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "coinsprefetch.h"
+
+#include "memusage.h"
+#include "util.h"
+
+#include <algorithm>
+
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
+/** Number of outpoints handed to a worker at a time */
+static const size_t PREFETCH_BATCH_SIZE = 128;
+/** Queued batches beyond this are dropped; the blocks will simply not be prefetched */
+static const size_t MAX_PREFETCH_QUEUED_BATCHES = 4096;
+
+CCoinsViewPrefetch::CCoinsViewPrefetch(CCoinsView* viewIn, size_t nMaxUsageIn) :
+    CCoinsViewBacked(viewIn), nStagedCoinsUsage(0), nMaxUsage(nMaxUsageIn), nEpoch(0), nThreads(0), nHits(0), nStaged(0)
+{
+}
+
+size_t CCoinsViewPrefetch::StagedUsage() const
+{
+    return memusage::DynamicUsage(staged) + nStagedCoinsUsage;
+}
+
+bool CCoinsViewPrefetch::GetCoin(const COutPoint &outpoint, Coin &coin) const
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        StagedMap::iterator it = staged.find(outpoint);
+        if (it != staged.end()) {
+            // The cache above keeps its own copy from now on.
+            nStagedCoinsUsage -= it->second.coin.DynamicMemoryUsage();
+            coin = std::move(it->second.coin);
+            staged.erase(it);
+            nHits++;
+            return true;
+        }
+    }
+    return base->GetCoin(outpoint, coin);
+}
+
+bool CCoinsViewPrefetch::HaveCoin(const COutPoint &outpoint) const
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (staged.count(outpoint))
+            return true;
+    }
+    return base->HaveCoin(outpoint);
+}
+
+bool CCoinsViewPrefetch::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock)
+{
+    // Only dirty entries change the backing view, and the write may consume
+    // mapCoins, so remember which outpoints are about to change.
+    std::vector<COutPoint> vWritten;
+    for (CCoinsMap::const_iterator it = mapCoins.begin(); it != mapCoins.end(); it++) {
+        if (it->second.flags & CCoinsCacheEntry::DIRTY)
+            vWritten.push_back(it->first);
+    }
+
+    bool ret = base->BatchWrite(mapCoins, hashBlock);
+
+    boost::unique_lock<boost::mutex> lock(mutex);
+    BOOST_FOREACH(const COutPoint& outpoint, vWritten) {
+        StagedMap::iterator it = staged.find(outpoint);
+        if (it != staged.end()) {
+            nStagedCoinsUsage -= it->second.coin.DynamicMemoryUsage();
+            staged.erase(it);
+        }
+    }
+    nEpoch++;
+    LogPrint("coindb", "Coins prefetch: %u hits, %u staged since last write, %u still staged (%.2fMiB)\n",
+        nHits, nStaged, staged.size(), StagedUsage() * (1.0 / (1 << 20)));
+    nHits = 0;
+    nStaged = 0;
+    return ret;
+}
+
+void CCoinsViewPrefetch::StartThreads(boost::thread_group& threadGroup, int nThreadsIn)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        nThreads += nThreadsIn;
+    }
+    for (int i = 0; i < nThreadsIn; i++) {
+        boost::function<void()> threadFunc = boost::bind(&CCoinsViewPrefetch::ThreadPrefetch, this);
+        threadGroup.create_thread(boost::bind(&TraceThread<boost::function<void()> >, "prefetch", threadFunc));
+    }
+}
+
+void CCoinsViewPrefetch::Prefetch(std::vector<COutPoint>&& vOutPoints, int nHeight)
+{
+    if (vOutPoints.empty())
+        return;
+    boost::unique_lock<boost::mutex> lock(mutex);
+    if (nThreads == 0)
+        return;
+    for (size_t nPos = 0; nPos < vOutPoints.size() && queue.size() < MAX_PREFETCH_QUEUED_BATCHES; nPos += PREFETCH_BATCH_SIZE) {
+        size_t nEnd = std::min(nPos + PREFETCH_BATCH_SIZE, vOutPoints.size());
+        queue.push_back(Batch(nHeight, std::vector<COutPoint>(vOutPoints.begin() + nPos, vOutPoints.begin() + nEnd)));
+    }
+    condWorker.notify_all();
+}
+
+void CCoinsViewPrefetch::Expire(int nTipHeight)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    while (!mapStagedByHeight.empty() && mapStagedByHeight.begin()->first <= nTipHeight) {
+        BOOST_FOREACH(const COutPoint& outpoint, mapStagedByHeight.begin()->second) {
+            StagedMap::iterator it = staged.find(outpoint);
+            if (it != staged.end() && it->second.nHeight <= nTipHeight) {
+                nStagedCoinsUsage -= it->second.coin.DynamicMemoryUsage();
+                staged.erase(it);
+            }
+        }
+        mapStagedByHeight.erase(mapStagedByHeight.begin());
+    }
+}
+
+void CCoinsViewPrefetch::Clear()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    queue.clear();
+    staged.clear();
+    mapStagedByHeight.clear();
+    nStagedCoinsUsage = 0;
+    // Lookups in flight are for blocks that are gone too.
+    nEpoch++;
+}
+
+size_t CCoinsViewPrefetch::GetStagedCount() const
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return staged.size();
+}
+
+void CCoinsViewPrefetch::ThreadPrefetch()
+{
+    while (true) {
+        Batch batch;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            while (queue.empty())
+                condWorker.wait(lock);
+            batch.swap(queue.front());
+            queue.pop_front();
+        }
+        const int nHeight = batch.first;
+
+        BOOST_FOREACH(const COutPoint& outpoint, batch.second) {
+            boost::this_thread::interruption_point();
+            uint64_t nReadEpoch;
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                StagedMap::iterator it = staged.find(outpoint);
+                if (it != staged.end()) {
+                    // Keep it until the last block that spends it is reached.
+                    if (nHeight > it->second.nHeight) {
+                        it->second.nHeight = nHeight;
+                        mapStagedByHeight[nHeight].push_back(outpoint);
+                    }
+                    continue;
+                }
+                if (StagedUsage() >= nMaxUsage)
+                    continue;
+                nReadEpoch = nEpoch;
+            }
+
+            Coin coin;
+            if (!base->GetCoin(outpoint, coin) || coin.IsSpent())
+                continue;
+
+            boost::unique_lock<boost::mutex> lock(mutex);
+            // The backing view was written to while we were reading, so
+            // what we read may already be outdated.
+            if (nReadEpoch != nEpoch)
+                continue;
+            size_t nCoinUsage = coin.DynamicMemoryUsage();
+            if (staged.emplace(outpoint, StagedCoin(std::move(coin), nHeight)).second) {
+                mapStagedByHeight[nHeight].push_back(outpoint);
+                nStagedCoinsUsage += nCoinUsage;
+                nStaged++;
+            }
+        }
+    }
+}
@@ -0,0 +1,117 @@
+// Copyright (c) 2026 The Junkcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_COINSPREFETCH_H
+#define BITCOIN_COINSPREFETCH_H
+
+#include "coins.h"
+
+#include <deque>
+#include <map>
+#include <utility>
+#include <stdint.h>
+#include <vector>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+
+namespace boost {
+    class thread_group;
+} // namespace boost
+
+/** Default number of threads that read ahead the coins spent by new blocks (0 = disabled) */
+static const int DEFAULT_COINS_PREFETCH_THREADS = 2;
+/** Maximum number of prefetch threads */
+static const int MAX_COINS_PREFETCH_THREADS = 16;
+/** Maximum memory used for staging prefetched coins, in MiB (taken out of -dbcache) */
+static const int64_t MAX_COINS_PREFETCH_CACHE = 32;
+/** Only blocks at most this far above the active tip have their inputs prefetched */
+static const int COINS_PREFETCH_WINDOW = 64;
+
+/**
+ * CCoinsView that sits between the coins cache (pcoinsTip) and the coins
+ * database and answers cache misses from coins that background threads have
+ * already read.
+ *
+ * Prefetch() queues the outpoints a block is going to spend; worker threads
+ * look them up in the backing view and stage the ones that exist. When the
+ * cache above later misses on such an outpoint, the staged coin is handed
+ * over instead of doing a blocking database read, and forgotten here.
+ *
+ * Staged coins are tagged with the height of the block they were read for.
+ * Once the active chain reaches that height the block was either connected
+ * or lost out to another one (a stale fork, an invalid block, one that was
+ * never activated), and Expire() drops what it left behind, so unused coins
+ * do not keep the staging area full.
+ *
+ * Staged coins mirror the backing view, so they must not survive a write to
+ * it: BatchWrite() drops the staged copies of every outpoint it writes, and
+ * starts a new epoch so that lookups which were in flight during the write
+ * are discarded rather than staged.
+ */
+class CCoinsViewPrefetch : public CCoinsViewBacked
+{
+private:
+    struct StagedCoin
+    {
+        Coin coin;
+        //! Height of the block the coin was read for
+        int nHeight;
+
+        StagedCoin(Coin&& coinIn, int nHeightIn) : coin(std::move(coinIn)), nHeight(nHeightIn) {}
+    };
+    typedef boost::unordered_map<COutPoint, StagedCoin, SaltedOutpointHasher> StagedMap;
+    typedef std::pair<int, std::vector<COutPoint> > Batch;
+
+    //! Protects everything below
+    mutable boost::mutex mutex;
+    //! Worker threads wait on this for queued outpoints
+    boost::condition_variable condWorker;
+    //! Batches of outpoints waiting to be looked up, with the height of their block
+    std::deque<Batch> queue;
+    //! Coins read ahead of time, keyed by outpoint
+    mutable StagedMap staged;
+    //! Outpoints staged for the block at each height, for Expire(). Outpoints
+    //! handed over or staged again for a higher block are skipped there.
+    std::map<int, std::vector<COutPoint> > mapStagedByHeight;
+    //! Dynamic memory used by the coins in staged (not the map itself)
+    mutable size_t nStagedCoinsUsage;
+    //! Staging stops when the memory usage of staged reaches this
+    size_t nMaxUsage;
+    //! Incremented after every write to the backing view
+    uint64_t nEpoch;
+    //! Number of running worker threads; Prefetch() is a no-op without any
+    int nThreads;
+    //! Statistics since the last write to the backing view
+    mutable uint64_t nHits;
+    uint64_t nStaged;
+
+    size_t StagedUsage() const;
+    void ThreadPrefetch();
+
+public:
+    CCoinsViewPrefetch(CCoinsView* viewIn, size_t nMaxUsageIn);
+
+    bool GetCoin(const COutPoint &outpoint, Coin &coin) const;
+    bool HaveCoin(const COutPoint &outpoint) const;
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock);
+
+    //! Start nThreadsIn worker threads in threadGroup
+    void StartThreads(boost::thread_group& threadGroup, int nThreadsIn);
+
+    //! Queue outpoints spent by the block at nHeight to be read ahead. Outpoints that are not found are ignored.
+    void Prefetch(std::vector<COutPoint>&& vOutPoints, int nHeight);
+
+    //! Drop the coins staged for blocks at or below nTipHeight, the height of the new active tip
+    void Expire(int nTipHeight);
+
+    //! Drop all staged and queued coins
+    void Clear();
+
+    //! Number of coins currently staged
+    size_t GetStagedCount() const;
+};
+
+#endif // BITCOIN_COINSPREFETCH_H
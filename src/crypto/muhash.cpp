@@ -0,0 +1,200 @@
+// Copyright (c) 2026 The Junkcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto/muhash.h"
+
+#include "crypto/common.h"
+#include "crypto/sha256.h"
+
+#include <string.h>
+
+namespace {
+
+/** 2^3072 - MAX_PRIME_DIFF is the largest prime below 2^3072 */
+const Num3072::limb_t MAX_PRIME_DIFF = 1103717;
+const Num3072::limb_t MAX_LIMB = ~(Num3072::limb_t)0;
+
+inline Num3072::limb_t ReadLimb(const unsigned char* ptr)
+{
+#ifdef __SIZEOF_INT128__
+    return ReadLE64(ptr);
+#else
+    return ReadLE32(ptr);
+#endif
+}
+
+inline void WriteLimb(unsigned char* ptr, Num3072::limb_t x)
+{
+#ifdef __SIZEOF_INT128__
+    WriteLE64(ptr, x);
+#else
+    WriteLE32(ptr, x);
+#endif
+}
+
+} // namespace
+
+Num3072::Num3072()
+{
+    limbs[0] = 1;
+    for (int i = 1; i < LIMBS; i++)
+        limbs[i] = 0;
+}
+
+Num3072::Num3072(const unsigned char (&data)[BYTE_SIZE])
+{
+    for (int i = 0; i < LIMBS; i++)
+        limbs[i] = ReadLimb(data + i * sizeof(limb_t));
+}
+
+void Num3072::ToBytes(unsigned char (&out)[BYTE_SIZE]) const
+{
+    for (int i = 0; i < LIMBS; i++)
+        WriteLimb(out + i * sizeof(limb_t), limbs[i]);
+}
+
+/** Whether the value is at least the modulus, i.e. all limbs are at their maximum except the low one. */
+bool Num3072::IsOverflow() const
+{
+    if (limbs[0] <= MAX_LIMB - MAX_PRIME_DIFF)
+        return false;
+    for (int i = 1; i < LIMBS; i++) {
+        if (limbs[i] != MAX_LIMB)
+            return false;
+    }
+    return true;
+}
+
+/** Subtract the modulus, which is the same as adding MAX_PRIME_DIFF and dropping the carry out of the top. */
+void Num3072::FullReduce()
+{
+    limb_t carry = MAX_PRIME_DIFF;
+    for (int i = 0; i < LIMBS && carry; i++) {
+        double_limb_t t = (double_limb_t)limbs[i] + carry;
+        limbs[i] = (limb_t)t;
+        carry = (limb_t)(t >> LIMB_SIZE);
+    }
+}
+
+/** Set the value to a 6144-bit product modulo the prime, using 2^3072 = MAX_PRIME_DIFF. */
+void Num3072::Reduce(const limb_t (&product)[2 * LIMBS])
+{
+    // low + high * MAX_PRIME_DIFF
+    limb_t carry = 0;
+    for (int i = 0; i < LIMBS; i++) {
+        double_limb_t t = (double_limb_t)product[LIMBS + i] * MAX_PRIME_DIFF + product[i] + carry;
+        limbs[i] = (limb_t)t;
+        carry = (limb_t)(t >> LIMB_SIZE);
+    }
+    // Fold what spilled over the top back in the same way. The second round
+    // can only spill over if the value was just below 2^3072, in which case
+    // the third one cannot.
+    double_limb_t fold = (double_limb_t)carry * MAX_PRIME_DIFF;
+    while (fold) {
+        for (int i = 0; i < LIMBS && fold; i++) {
+            double_limb_t t = (double_limb_t)limbs[i] + fold;
+            limbs[i] = (limb_t)t;
+            fold = t >> LIMB_SIZE;
+        }
+        fold *= MAX_PRIME_DIFF;
+    }
+    if (IsOverflow())
+        FullReduce();
+}
+
+void Num3072::Multiply(const Num3072& a)
+{
+    limb_t product[2 * LIMBS];
+    memset(product, 0, sizeof(product));
+    for (int i = 0; i < LIMBS; i++) {
+        limb_t carry = 0;
+        for (int j = 0; j < LIMBS; j++) {
+            double_limb_t t = (double_limb_t)limbs[i] * a.limbs[j] + product[i + j] + carry;
+            product[i + j] = (limb_t)t;
+            carry = (limb_t)(t >> LIMB_SIZE);
+        }
+        product[i + LIMBS] = carry;
+    }
+    Reduce(product);
+}
+
+/** Raise to the power p - 2, which by Fermat's little theorem is the inverse. */
+Num3072 Num3072::GetInverse() const
+{
+    limb_t exponent[LIMBS];
+    exponent[0] = MAX_LIMB - MAX_PRIME_DIFF - 1;
+    for (int i = 1; i < LIMBS; i++)
+        exponent[i] = MAX_LIMB;
+
+    Num3072 out;
+    for (int i = LIMBS - 1; i >= 0; i--) {
+        for (int bit = LIMB_SIZE - 1; bit >= 0; bit--) {
+            Num3072 square(out);
+            out.Multiply(square);
+            if ((exponent[i] >> bit) & 1)
+                out.Multiply(*this);
+        }
+    }
+    return out;
+}
+
+void Num3072::Divide(const Num3072& a)
+{
+    Multiply(a.GetInverse());
+}
+
+Num3072 MuHash3072::ToNum3072(const unsigned char* data, size_t len)
+{
+    unsigned char key[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write(data, len).Finalize(key);
+
+    unsigned char expanded[Num3072::BYTE_SIZE];
+    for (uint32_t i = 0; i < Num3072::BYTE_SIZE / CSHA256::OUTPUT_SIZE; i++) {
+        unsigned char counter[4];
+        WriteLE32(counter, i);
+        CSHA256().Write(key, sizeof(key)).Write(counter, sizeof(counter)).Finalize(expanded + i * CSHA256::OUTPUT_SIZE);
+    }
+    return Num3072(expanded);
+}
+
+MuHash3072& MuHash3072::Insert(const unsigned char* data, size_t len)
+{
+    numerator.Multiply(ToNum3072(data, len));
+    return *this;
+}
+
+MuHash3072& MuHash3072::Remove(const unsigned char* data, size_t len)
+{
+    denominator.Multiply(ToNum3072(data, len));
+    return *this;
+}
+
+MuHash3072& MuHash3072::operator*=(const MuHash3072& other)
+{
+    numerator.Multiply(other.numerator);
+    denominator.Multiply(other.denominator);
+    return *this;
+}
+
+void MuHash3072::Finalize(unsigned char out[OUTPUT_SIZE])
+{
+    numerator.Divide(denominator);
+    denominator = Num3072();
+
+    unsigned char data[Num3072::BYTE_SIZE];
+    numerator.ToBytes(data);
+    CSHA256().Write(data, sizeof(data)).Finalize(out);
+}
+
+void MuHash3072::GetState(unsigned char (&num)[Num3072::BYTE_SIZE], unsigned char (&den)[Num3072::BYTE_SIZE]) const
+{
+    numerator.ToBytes(num);
+    denominator.ToBytes(den);
+}
+
+void MuHash3072::SetState(const unsigned char (&num)[Num3072::BYTE_SIZE], const unsigned char (&den)[Num3072::BYTE_SIZE])
+{
+    numerator = Num3072(num);
+    denominator = Num3072(den);
+}
@@ -0,0 +1,86 @@
+// Copyright (c) 2026 The Junkcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_MUHASH_H
+#define BITCOIN_CRYPTO_MUHASH_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/** An integer modulo the prime 2^3072 - 1103717. */
+class Num3072
+{
+public:
+    static const size_t BYTE_SIZE = 384;
+
+#ifdef __SIZEOF_INT128__
+    typedef uint64_t limb_t;
+    typedef unsigned __int128 double_limb_t;
+#else
+    typedef uint32_t limb_t;
+    typedef uint64_t double_limb_t;
+#endif
+    static const int LIMB_SIZE = 8 * sizeof(limb_t);
+    static const int LIMBS = 3072 / LIMB_SIZE;
+
+    limb_t limbs[LIMBS];
+
+    //! Construct the number 1
+    Num3072();
+    //! Construct from BYTE_SIZE little-endian bytes
+    explicit Num3072(const unsigned char (&data)[BYTE_SIZE]);
+
+    void Multiply(const Num3072& a);
+    void Divide(const Num3072& a);
+    void ToBytes(unsigned char (&out)[BYTE_SIZE]) const;
+
+private:
+    bool IsOverflow() const;
+    void FullReduce();
+    void Reduce(const limb_t (&product)[2 * LIMBS]);
+    Num3072 GetInverse() const;
+};
+
+/**
+ * A rolling hash of a set of byte strings.
+ *
+ * Every element is hashed to a number modulo a 3072-bit prime, and the set
+ * hash is the product of the numbers of its elements. Adding and removing
+ * elements is therefore a single multiplication each, in any order, and
+ * the hashes of two sets can be combined. Removals are accumulated in a
+ * separate denominator so that the one expensive division only happens in
+ * Finalize().
+ *
+ * Elements are hashed with SHA256 and expanded to 3072 bits by hashing that
+ * digest with a counter, 32 bytes at a time.
+ */
+class MuHash3072
+{
+private:
+    Num3072 numerator;
+    Num3072 denominator;
+
+    static Num3072 ToNum3072(const unsigned char* data, size_t len);
+
+public:
+    static const size_t OUTPUT_SIZE = 32;
+
+    //! The hash of the empty set
+    MuHash3072() {}
+
+    MuHash3072& Insert(const unsigned char* data, size_t len);
+    MuHash3072& Remove(const unsigned char* data, size_t len);
+
+    //! Add all elements of another set, and remove those it had removed
+    MuHash3072& operator*=(const MuHash3072& other);
+
+    //! Write the hash of the set to out
+    void Finalize(unsigned char out[OUTPUT_SIZE]);
+
+    //! Raw state, for persisting it
+    void GetState(unsigned char (&num)[Num3072::BYTE_SIZE], unsigned char (&den)[Num3072::BYTE_SIZE]) const;
+    void SetState(const unsigned char (&num)[Num3072::BYTE_SIZE], const unsigned char (&den)[Num3072::BYTE_SIZE]);
+};
+
+#endif // BITCOIN_CRYPTO_MUHASH_H
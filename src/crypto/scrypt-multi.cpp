@@ -0,0 +1,257 @@
+// Copyright (c) 2026 The Junkcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * Multi-lane scrypt(1024, 1, 1, 256).
+ *
+ * Several independent headers are hashed at once by storing word k of every
+ * lane in one SIMD vector ("vertical" layout), so each Salsa20/8 instruction
+ * advances all lanes. The kernel is written once against GCC/Clang vector
+ * extensions and instantiated for 4 lanes (SSE2, or VEX encoded when AVX is
+ * present) and 8 lanes (AVX2). The wide variants carry a target attribute so
+ * the rest of the binary does not depend on the instruction set, and the
+ * widest kernel supported by the running CPU is picked on first use.
+ */
+
+#include "crypto/scrypt.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <memory>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+#define SCRYPT_MULTI_X86 1
+#endif
+
+#if defined(__GNUC__)
+
+namespace {
+
+typedef uint32_t scrypt_v4 __attribute__((vector_size(16)));
+#if defined(SCRYPT_MULTI_X86)
+typedef uint32_t scrypt_v8 __attribute__((vector_size(32)));
+#endif
+
+#define ROTL_LANES(a, b) (((a) << (b)) | ((a) >> (32 - (b))))
+
+/** Salsa20/8 core applied to every lane of B, see xor_salsa8() in scrypt.cpp. */
+template <typename V>
+inline __attribute__((always_inline)) void xor_salsa8_lanes(V B[16], const V Bx[16])
+{
+    V x00, x01, x02, x03, x04, x05, x06, x07, x08, x09, x10, x11, x12, x13, x14, x15;
+
+    x00 = (B[ 0] ^= Bx[ 0]);
+    x01 = (B[ 1] ^= Bx[ 1]);
+    x02 = (B[ 2] ^= Bx[ 2]);
+    x03 = (B[ 3] ^= Bx[ 3]);
+    x04 = (B[ 4] ^= Bx[ 4]);
+    x05 = (B[ 5] ^= Bx[ 5]);
+    x06 = (B[ 6] ^= Bx[ 6]);
+    x07 = (B[ 7] ^= Bx[ 7]);
+    x08 = (B[ 8] ^= Bx[ 8]);
+    x09 = (B[ 9] ^= Bx[ 9]);
+    x10 = (B[10] ^= Bx[10]);
+    x11 = (B[11] ^= Bx[11]);
+    x12 = (B[12] ^= Bx[12]);
+    x13 = (B[13] ^= Bx[13]);
+    x14 = (B[14] ^= Bx[14]);
+    x15 = (B[15] ^= Bx[15]);
+    for (int i = 0; i < 8; i += 2) {
+        /* Operate on columns. */
+        x04 ^= ROTL_LANES(x00 + x12,  7);  x09 ^= ROTL_LANES(x05 + x01,  7);
+        x14 ^= ROTL_LANES(x10 + x06,  7);  x03 ^= ROTL_LANES(x15 + x11,  7);
+
+        x08 ^= ROTL_LANES(x04 + x00,  9);  x13 ^= ROTL_LANES(x09 + x05,  9);
+        x02 ^= ROTL_LANES(x14 + x10,  9);  x07 ^= ROTL_LANES(x03 + x15,  9);
+
+        x12 ^= ROTL_LANES(x08 + x04, 13);  x01 ^= ROTL_LANES(x13 + x09, 13);
+        x06 ^= ROTL_LANES(x02 + x14, 13);  x11 ^= ROTL_LANES(x07 + x03, 13);
+
+        x00 ^= ROTL_LANES(x12 + x08, 18);  x05 ^= ROTL_LANES(x01 + x13, 18);
+        x10 ^= ROTL_LANES(x06 + x02, 18);  x15 ^= ROTL_LANES(x11 + x07, 18);
+
+        /* Operate on rows. */
+        x01 ^= ROTL_LANES(x00 + x03,  7);  x06 ^= ROTL_LANES(x05 + x04,  7);
+        x11 ^= ROTL_LANES(x10 + x09,  7);  x12 ^= ROTL_LANES(x15 + x14,  7);
+
+        x02 ^= ROTL_LANES(x01 + x00,  9);  x07 ^= ROTL_LANES(x06 + x05,  9);
+        x08 ^= ROTL_LANES(x11 + x10,  9);  x13 ^= ROTL_LANES(x12 + x15,  9);
+
+        x03 ^= ROTL_LANES(x02 + x01, 13);  x04 ^= ROTL_LANES(x07 + x06, 13);
+        x09 ^= ROTL_LANES(x08 + x11, 13);  x14 ^= ROTL_LANES(x13 + x12, 13);
+
+        x00 ^= ROTL_LANES(x03 + x02, 18);  x05 ^= ROTL_LANES(x04 + x07, 18);
+        x10 ^= ROTL_LANES(x09 + x08, 18);  x15 ^= ROTL_LANES(x14 + x13, 18);
+    }
+    B[ 0] += x00;
+    B[ 1] += x01;
+    B[ 2] += x02;
+    B[ 3] += x03;
+    B[ 4] += x04;
+    B[ 5] += x05;
+    B[ 6] += x06;
+    B[ 7] += x07;
+    B[ 8] += x08;
+    B[ 9] += x09;
+    B[10] += x10;
+    B[11] += x11;
+    B[12] += x12;
+    B[13] += x13;
+    B[14] += x14;
+    B[15] += x15;
+}
+
+#undef ROTL_LANES
+
+/**
+ * scrypt_1024_1_1_256 over N lanes. input holds N consecutive 80-byte headers,
+ * output receives N consecutive 32-byte hashes and scratchpad must provide at
+ * least scrypt_multi_scratchpad_size(N) bytes.
+ */
+template <typename V, int N>
+inline __attribute__((always_inline)) void scrypt_lanes(const char *input, char *output, char *scratchpad)
+{
+    uint8_t B[N][128];
+    V X[32];
+    V *scratch = (V *)(((uintptr_t)(scratchpad) + 63) & ~ (uintptr_t)(63));
+
+    for (int l = 0; l < N; l++) {
+        const uint8_t *in = (const uint8_t *)input + 80 * l;
+        PBKDF2_SHA256(in, 80, in, 80, 1, B[l], 128);
+    }
+    for (int k = 0; k < 32; k++) {
+        for (int l = 0; l < N; l++)
+            X[k][l] = le32dec(&B[l][4 * k]);
+    }
+
+    for (int i = 0; i < 1024; i++) {
+        memcpy(&scratch[i * 32], X, sizeof(X));
+        xor_salsa8_lanes(&X[0], &X[16]);
+        xor_salsa8_lanes(&X[16], &X[0]);
+    }
+    for (int i = 0; i < 1024; i++) {
+        // Every lane reads from its own pseudo-random slot, so gather lane by lane.
+        uint32_t j[N];
+        for (int l = 0; l < N; l++)
+            j[l] = 32 * (X[16][l] & 1023);
+        for (int k = 0; k < 32; k++) {
+            V t;
+            for (int l = 0; l < N; l++)
+                t[l] = scratch[j[l] + k][l];
+            X[k] ^= t;
+        }
+        xor_salsa8_lanes(&X[0], &X[16]);
+        xor_salsa8_lanes(&X[16], &X[0]);
+    }
+
+    for (int k = 0; k < 32; k++) {
+        for (int l = 0; l < N; l++)
+            le32enc(&B[l][4 * k], X[k][l]);
+    }
+    for (int l = 0; l < N; l++) {
+        const uint8_t *in = (const uint8_t *)input + 80 * l;
+        PBKDF2_SHA256(in, 80, B[l], 128, 1, (uint8_t *)output + 32 * l, 32);
+    }
+}
+
+} // namespace
+
+void scrypt_1024_1_1_256_sp_4way(const char *input, char *output, char *scratchpad)
+{
+    scrypt_lanes<scrypt_v4, 4>(input, output, scratchpad);
+}
+
+#if defined(SCRYPT_MULTI_X86)
+__attribute__((target("avx")))
+static void scrypt_1024_1_1_256_sp_4way_avx(const char *input, char *output, char *scratchpad)
+{
+    scrypt_lanes<scrypt_v4, 4>(input, output, scratchpad);
+}
+
+__attribute__((target("avx2")))
+static void scrypt_1024_1_1_256_sp_8way_avx2(const char *input, char *output, char *scratchpad)
+{
+    scrypt_lanes<scrypt_v8, 8>(input, output, scratchpad);
+}
+#endif
+
+#endif // __GNUC__
+
+namespace {
+
+typedef void (*scrypt_multi_fn)(const char *input, char *output, char *scratchpad);
+
+struct ScryptMultiImpl
+{
+    const char *name;
+    int lanes;
+    scrypt_multi_fn fn;
+    //! Kernel of half the width, used for the tail of a batch (may be null)
+    scrypt_multi_fn half_fn;
+};
+
+ScryptMultiImpl DetectMultiImpl()
+{
+#if defined(SCRYPT_MULTI_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return {"8way-avx2", 8, &scrypt_1024_1_1_256_sp_8way_avx2, &scrypt_1024_1_1_256_sp_4way_avx};
+    if (__builtin_cpu_supports("avx"))
+        return {"4way-avx", 4, &scrypt_1024_1_1_256_sp_4way_avx, nullptr};
+    if (__builtin_cpu_supports("sse2"))
+        return {"4way-sse2", 4, &scrypt_1024_1_1_256_sp_4way, nullptr};
+#elif defined(__GNUC__)
+    return {"4way", 4, &scrypt_1024_1_1_256_sp_4way, nullptr};
+#endif
+    return {"generic", 1, nullptr, nullptr};
+}
+
+const ScryptMultiImpl& MultiImpl()
+{
+    static const ScryptMultiImpl impl = DetectMultiImpl();
+    return impl;
+}
+
+} // namespace
+
+const char *scrypt_multi_impl()
+{
+    return MultiImpl().name;
+}
+
+int scrypt_multi_lanes()
+{
+    return MultiImpl().lanes;
+}
+
+void scrypt_1024_1_1_256_multi(const char *input, char *output, size_t n)
+{
+    const ScryptMultiImpl& impl = MultiImpl();
+    if (impl.lanes > 1 && n >= 2) {
+        // One scratchpad per thread, sized for the widest kernel and allocated lazily
+        // so threads that never hash in batches do not pay for it.
+        thread_local std::unique_ptr<char[]> scratchpad;
+        if (!scratchpad)
+            scratchpad.reset(new char[scrypt_multi_scratchpad_size(impl.lanes)]);
+        const size_t lanes = impl.lanes;
+        while (n >= lanes) {
+            impl.fn(input, output, scratchpad.get());
+            input += 80 * lanes;
+            output += 32 * lanes;
+            n -= lanes;
+        }
+        if (impl.half_fn && n >= lanes / 2) {
+            impl.half_fn(input, output, scratchpad.get());
+            input += 80 * (lanes / 2);
+            output += 32 * (lanes / 2);
+            n -= lanes / 2;
+        }
+    }
+    for (; n > 0; n--) {
+        scrypt_1024_1_1_256(input, output);
+        input += 80;
+        output += 32;
+    }
+}
@@ -23,6 +23,28 @@ extern void (*scrypt_1024_1_1_256_sp_detected)(const char *input, char *output,
 #define scrypt_1024_1_1_256_sp(input, output, scratchpad) scrypt_1024_1_1_256_sp_generic((input), (output), (scratchpad))
 #endif
 
+/** Scratchpad bytes needed by a kernel hashing `lanes` inputs at once. */
+static inline size_t scrypt_multi_scratchpad_size(int lanes)
+{
+    return (size_t)131072 * lanes + 63;
+}
+
+/**
+ * Hash n consecutive 80-byte inputs into n consecutive 32-byte outputs.
+ * Inputs are processed in interleaved Salsa20/8 lanes (8-way AVX2, 4-way
+ * AVX/SSE2) chosen by runtime CPU detection; whatever does not fill a full
+ * set of lanes goes through scrypt_1024_1_1_256().
+ */
+void scrypt_1024_1_1_256_multi(const char *input, char *output, size_t n);
+/** Name of the multi-lane kernel selected for this CPU. */
+const char *scrypt_multi_impl();
+/** Number of inputs the selected multi-lane kernel hashes per pass. */
+int scrypt_multi_lanes();
+
+#if defined(__GNUC__)
+void scrypt_1024_1_1_256_sp_4way(const char *input, char *output, char *scratchpad);
+#endif
+
 void
 PBKDF2_SHA256(const uint8_t *passwd, size_t passwdlen, const uint8_t *salt,
     size_t saltlen, uint64_t c, uint8_t *buf, size_t dkLen);
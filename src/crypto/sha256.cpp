@@ -7,6 +7,7 @@
 
 #include "crypto/common.h"
 
+#include <assert.h>
 #include <string.h>
 
 #if (defined(__ia64__) || defined(__x86_64__)) && \
@@ -30,6 +31,12 @@
 # endif
 #endif  /** ARM Headers */
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+#define SHA256_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
 static const uint32_t K[] =
 {
     0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5,
@@ -88,7 +95,10 @@ void inline Initialize(uint32_t* s)
 }
 
 /** Perform one SHA-256 transformation, processing a 64-byte chunk. */
-void Transform(uint32_t* s, const unsigned char* chunk)
+#if defined(__GNUC__)
+__attribute__((always_inline))
+#endif
+void inline TransformBlock(uint32_t* s, const unsigned char* chunk)
 {
 #if defined(USE_ARMV8) || defined(USE_ARMV82)
     uint32x4_t STATE0, STATE1, ABEF_SAVE, CDGH_SAVE;
@@ -332,9 +342,476 @@ void Transform(uint32_t* s, const unsigned char* chunk)
 #endif
 }
 
+/** Perform a number of SHA-256 transformations, processing consecutive 64-byte chunks. */
+void Transform(uint32_t* s, const unsigned char* chunk, size_t blocks)
+{
+    while (blocks--) {
+        TransformBlock(s, chunk);
+        chunk += 64;
+    }
+}
+
+#if defined(SHA256_X86) && !defined(USE_AVX2)
+/** The portable transform, built for AVX2 hosts where BMI2 rorx rotates without a copy. */
+__attribute__((target("avx2,bmi2")))
+void TransformAVX2(uint32_t* s, const unsigned char* chunk, size_t blocks)
+{
+    while (blocks--) {
+        TransformBlock(s, chunk);
+        chunk += 64;
+    }
+}
+#endif
+
+#if defined(SHA256_X86)
+/** SHA-256 transformation using the Intel SHA extensions. */
+__attribute__((target("sha,sse4.1")))
+void TransformSHANI(uint32_t* s, const unsigned char* chunk, size_t blocks)
+{
+    const __m128i MASK = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i STATE0, STATE1, ABEF_SAVE, CDGH_SAVE;
+    __m128i MSG, MSG0, MSG1, MSG2, MSG3, TMP;
+
+    /** Load state and reorder it into ABEF/CDGH */
+    TMP = _mm_loadu_si128((const __m128i*)&s[0]);
+    STATE1 = _mm_loadu_si128((const __m128i*)&s[4]);
+    TMP = _mm_shuffle_epi32(TMP, 0xB1);
+    STATE1 = _mm_shuffle_epi32(STATE1, 0x1B);
+    STATE0 = _mm_alignr_epi8(TMP, STATE1, 8);
+    STATE1 = _mm_blend_epi16(STATE1, TMP, 0xF0);
+
+    while (blocks--) {
+        /** Save state */
+        ABEF_SAVE = STATE0;
+        CDGH_SAVE = STATE1;
+
+        /** Rounds 0-3 */
+        MSG0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(chunk + 0)), MASK);
+        MSG = _mm_add_epi32(MSG0, _mm_loadu_si128((const __m128i*)&K[0]));
+        STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+        MSG = _mm_shuffle_epi32(MSG, 0x0E);
+        STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);
+
+        /** Rounds 4-7 */
+        MSG1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(chunk + 16)), MASK);
+        MSG = _mm_add_epi32(MSG1, _mm_loadu_si128((const __m128i*)&K[4]));
+        STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+        MSG = _mm_shuffle_epi32(MSG, 0x0E);
+        STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);
+        MSG0 = _mm_sha256msg1_epu32(MSG0, MSG1);
+
+        /** Rounds 8-11 */
+        MSG2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(chunk + 32)), MASK);
+        MSG = _mm_add_epi32(MSG2, _mm_loadu_si128((const __m128i*)&K[8]));
+        STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+        MSG = _mm_shuffle_epi32(MSG, 0x0E);
+        STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);
+        MSG1 = _mm_sha256msg1_epu32(MSG1, MSG2);
+
+        /** Rounds 12-15 */
+        MSG3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(chunk + 48)), MASK);
+        MSG = _mm_add_epi32(MSG3, _mm_loadu_si128((const __m128i*)&K[12]));
+        STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+        TMP = _mm_alignr_epi8(MSG3, MSG2, 4);
+        MSG0 = _mm_add_epi32(MSG0, TMP);
+        MSG0 = _mm_sha256msg2_epu32(MSG0, MSG3);
+        MSG = _mm_shuffle_epi32(MSG, 0x0E);
+        STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);
+        MSG2 = _mm_sha256msg1_epu32(MSG2, MSG3);
+
+        /** Rounds 16-19 */
+        MSG = _mm_add_epi32(MSG0, _mm_loadu_si128((const __m128i*)&K[16]));
+        STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+        TMP = _mm_alignr_epi8(MSG0, MSG3, 4);
+        MSG1 = _mm_add_epi32(MSG1, TMP);
+        MSG1 = _mm_sha256msg2_epu32(MSG1, MSG0);
+        MSG = _mm_shuffle_epi32(MSG, 0x0E);
+        STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);
+        MSG3 = _mm_sha256msg1_epu32(MSG3, MSG0);
+
+        /** Rounds 20-23 */
+        MSG = _mm_add_epi32(MSG1, _mm_loadu_si128((const __m128i*)&K[20]));
+        STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+        TMP = _mm_alignr_epi8(MSG1, MSG0, 4);
+        MSG2 = _mm_add_epi32(MSG2, TMP);
+        MSG2 = _mm_sha256msg2_epu32(MSG2, MSG1);
+        MSG = _mm_shuffle_epi32(MSG, 0x0E);
+        STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);
+        MSG0 = _mm_sha256msg1_epu32(MSG0, MSG1);
+
+        /** Rounds 24-27 */
+        MSG = _mm_add_epi32(MSG2, _mm_loadu_si128((const __m128i*)&K[24]));
+        STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+        TMP = _mm_alignr_epi8(MSG2, MSG1, 4);
+        MSG3 = _mm_add_epi32(MSG3, TMP);
+        MSG3 = _mm_sha256msg2_epu32(MSG3, MSG2);
+        MSG = _mm_shuffle_epi32(MSG, 0x0E);
+        STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);
+        MSG1 = _mm_sha256msg1_epu32(MSG1, MSG2);
+
+        /** Rounds 28-31 */
+        MSG = _mm_add_epi32(MSG3, _mm_loadu_si128((const __m128i*)&K[28]));
+        STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+        TMP = _mm_alignr_epi8(MSG3, MSG2, 4);
+        MSG0 = _mm_add_epi32(MSG0, TMP);
+        MSG0 = _mm_sha256msg2_epu32(MSG0, MSG3);
+        MSG = _mm_shuffle_epi32(MSG, 0x0E);
+        STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);
+        MSG2 = _mm_sha256msg1_epu32(MSG2, MSG3);
+
+        /** Rounds 32-35 */
+        MSG = _mm_add_epi32(MSG0, _mm_loadu_si128((const __m128i*)&K[32]));
+        STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+        TMP = _mm_alignr_epi8(MSG0, MSG3, 4);
+        MSG1 = _mm_add_epi32(MSG1, TMP);
+        MSG1 = _mm_sha256msg2_epu32(MSG1, MSG0);
+        MSG = _mm_shuffle_epi32(MSG, 0x0E);
+        STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);
+        MSG3 = _mm_sha256msg1_epu32(MSG3, MSG0);
+
+        /** Rounds 36-39 */
+        MSG = _mm_add_epi32(MSG1, _mm_loadu_si128((const __m128i*)&K[36]));
+        STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+        TMP = _mm_alignr_epi8(MSG1, MSG0, 4);
+        MSG2 = _mm_add_epi32(MSG2, TMP);
+        MSG2 = _mm_sha256msg2_epu32(MSG2, MSG1);
+        MSG = _mm_shuffle_epi32(MSG, 0x0E);
+        STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);
+        MSG0 = _mm_sha256msg1_epu32(MSG0, MSG1);
+
+        /** Rounds 40-43 */
+        MSG = _mm_add_epi32(MSG2, _mm_loadu_si128((const __m128i*)&K[40]));
+        STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+        TMP = _mm_alignr_epi8(MSG2, MSG1, 4);
+        MSG3 = _mm_add_epi32(MSG3, TMP);
+        MSG3 = _mm_sha256msg2_epu32(MSG3, MSG2);
+        MSG = _mm_shuffle_epi32(MSG, 0x0E);
+        STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);
+        MSG1 = _mm_sha256msg1_epu32(MSG1, MSG2);
+
+        /** Rounds 44-47 */
+        MSG = _mm_add_epi32(MSG3, _mm_loadu_si128((const __m128i*)&K[44]));
+        STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+        TMP = _mm_alignr_epi8(MSG3, MSG2, 4);
+        MSG0 = _mm_add_epi32(MSG0, TMP);
+        MSG0 = _mm_sha256msg2_epu32(MSG0, MSG3);
+        MSG = _mm_shuffle_epi32(MSG, 0x0E);
+        STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);
+        MSG2 = _mm_sha256msg1_epu32(MSG2, MSG3);
+
+        /** Rounds 48-51 */
+        MSG = _mm_add_epi32(MSG0, _mm_loadu_si128((const __m128i*)&K[48]));
+        STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+        TMP = _mm_alignr_epi8(MSG0, MSG3, 4);
+        MSG1 = _mm_add_epi32(MSG1, TMP);
+        MSG1 = _mm_sha256msg2_epu32(MSG1, MSG0);
+        MSG = _mm_shuffle_epi32(MSG, 0x0E);
+        STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);
+        MSG3 = _mm_sha256msg1_epu32(MSG3, MSG0);
+
+        /** Rounds 52-55 */
+        MSG = _mm_add_epi32(MSG1, _mm_loadu_si128((const __m128i*)&K[52]));
+        STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+        TMP = _mm_alignr_epi8(MSG1, MSG0, 4);
+        MSG2 = _mm_add_epi32(MSG2, TMP);
+        MSG2 = _mm_sha256msg2_epu32(MSG2, MSG1);
+        MSG = _mm_shuffle_epi32(MSG, 0x0E);
+        STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);
+
+        /** Rounds 56-59 */
+        MSG = _mm_add_epi32(MSG2, _mm_loadu_si128((const __m128i*)&K[56]));
+        STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+        TMP = _mm_alignr_epi8(MSG2, MSG1, 4);
+        MSG3 = _mm_add_epi32(MSG3, TMP);
+        MSG3 = _mm_sha256msg2_epu32(MSG3, MSG2);
+        MSG = _mm_shuffle_epi32(MSG, 0x0E);
+        STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);
+
+        /** Rounds 60-63 */
+        MSG = _mm_add_epi32(MSG3, _mm_loadu_si128((const __m128i*)&K[60]));
+        STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+        MSG = _mm_shuffle_epi32(MSG, 0x0E);
+        STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);
+
+        /** Combine state */
+        STATE0 = _mm_add_epi32(STATE0, ABEF_SAVE);
+        STATE1 = _mm_add_epi32(STATE1, CDGH_SAVE);
+        chunk += 64;
+    }
+
+    /** Reorder the state back and save it */
+    TMP = _mm_shuffle_epi32(STATE0, 0x1B);
+    STATE1 = _mm_shuffle_epi32(STATE1, 0xB1);
+    STATE0 = _mm_blend_epi16(TMP, STATE1, 0xF0);
+    STATE1 = _mm_alignr_epi8(STATE1, TMP, 8);
+    _mm_storeu_si128((__m128i*)&s[0], STATE0);
+    _mm_storeu_si128((__m128i*)&s[4], STATE1);
+}
+#endif
+
 } // namespace sha256
+
+#if defined(__GNUC__)
+/**
+ * Double SHA-256 of N independent 64-byte inputs at once, with word k of
+ * every lane kept in one SIMD vector. V is a GCC vector of N uint32_t.
+ */
+namespace sha256d64_lanes
+{
+#define ROTR_LANES(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+/** One SHA-256 compression of every lane, w holding the 16 message words. */
+template <typename V>
+inline __attribute__((always_inline)) void Compress(V* s, V* w)
+{
+    V a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+    for (int i = 0; i < 64; i++) {
+        if (i >= 16) {
+            const V w2 = w[(i - 2) & 15], w15 = w[(i - 15) & 15];
+            w[i & 15] += (ROTR_LANES(w2, 17) ^ ROTR_LANES(w2, 19) ^ (w2 >> 10)) + w[(i - 7) & 15] +
+                         (ROTR_LANES(w15, 7) ^ ROTR_LANES(w15, 18) ^ (w15 >> 3));
+        }
+        const V t1 = h + (ROTR_LANES(e, 6) ^ ROTR_LANES(e, 11) ^ ROTR_LANES(e, 25)) + (g ^ (e & (f ^ g))) + K[i] + w[i & 15];
+        const V t2 = (ROTR_LANES(a, 2) ^ ROTR_LANES(a, 13) ^ ROTR_LANES(a, 22)) + ((a & b) | (c & (a | b)));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    s[0] += a;
+    s[1] += b;
+    s[2] += c;
+    s[3] += d;
+    s[4] += e;
+    s[5] += f;
+    s[6] += g;
+    s[7] += h;
+}
+
+#undef ROTR_LANES
+
+template <typename V>
+inline __attribute__((always_inline)) void Initialize(V* s)
+{
+    uint32_t init[8];
+    sha256::Initialize(init);
+    for (int k = 0; k < 8; k++)
+        s[k] = init[k] - (V){};
+}
+
+template <typename V, int N>
+inline __attribute__((always_inline)) void TransformD64(unsigned char* out, const unsigned char* in)
+{
+    V s[8], t[8], w[16];
+
+    // First hash: the 64-byte inputs, followed by a padding block for 512 bits
+    Initialize(s);
+    for (int k = 0; k < 16; k++) {
+        for (int l = 0; l < N; l++)
+            w[k][l] = ReadBE32(in + 64 * l + 4 * k);
+    }
+    Compress(s, w);
+    for (int k = 0; k < 16; k++)
+        w[k] = (k == 0 ? 0x80000000 : k == 15 ? 0x200 : 0) - (V){};
+    Compress(s, w);
+
+    // Second hash: the 32-byte digests, padded in the same block
+    for (int k = 0; k < 8; k++)
+        w[k] = s[k];
+    for (int k = 8; k < 16; k++)
+        w[k] = (k == 8 ? 0x80000000 : k == 15 ? 0x100 : 0) - (V){};
+    Initialize(t);
+    Compress(t, w);
+
+    for (int k = 0; k < 8; k++) {
+        for (int l = 0; l < N; l++)
+            WriteBE32(out + 32 * l + 4 * k, t[k][l]);
+    }
+}
+
+#if defined(SHA256_X86)
+typedef uint32_t v4 __attribute__((vector_size(16)));
+typedef uint32_t v8 __attribute__((vector_size(32)));
+
+__attribute__((target("sse4.1")))
+void Transform_4way(unsigned char* out, const unsigned char* in)
+{
+    TransformD64<v4, 4>(out, in);
+}
+
+__attribute__((target("avx2")))
+void Transform_8way(unsigned char* out, const unsigned char* in)
+{
+    TransformD64<v8, 8>(out, in);
+}
+#endif
+} // namespace sha256d64_lanes
+#endif
+
+typedef void (*TransformType)(uint32_t*, const unsigned char*, size_t);
+typedef void (*TransformD64Type)(unsigned char*, const unsigned char*);
+
+/** The transform used by CSHA256, selected by SHA256AutoDetect(). */
+TransformType Transform = sha256::Transform;
+/** Multi-lane double SHA-256 of 64-byte inputs, if the CPU has the lanes for it. */
+TransformD64Type TransformD64_4way = nullptr;
+TransformD64Type TransformD64_8way = nullptr;
+
+/** Double SHA-256 of one 64-byte input, using the selected transform. */
+void TransformD64(unsigned char* out, const unsigned char* in)
+{
+    static const unsigned char pad64[64] = {0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x02, 0x00};
+    uint32_t s[8];
+    unsigned char buf[64] = {0};
+
+    sha256::Initialize(s);
+    Transform(s, in, 1);
+    Transform(s, pad64, 1);
+    for (int k = 0; k < 8; k++)
+        WriteBE32(buf + 4 * k, s[k]);
+    buf[32] = 0x80;
+    buf[62] = 0x01;
+    sha256::Initialize(s);
+    Transform(s, buf, 1);
+    for (int k = 0; k < 8; k++)
+        WriteBE32(out + 4 * k, s[k]);
+}
+
+/**
+ * Check a transform against the digest of "abc" and against the portable
+ * transform on a few multi-block inputs.
+ */
+bool SelfTest(TransformType tr)
+{
+    static const uint32_t abc_state[8] = {
+        0xba7816bf, 0x8f01cfea, 0x414140de, 0x5dae2223,
+        0xb00361a3, 0x96177a9c, 0xb410ff61, 0xf20015ad,
+    };
+    unsigned char data[256] = {'a', 'b', 'c', 0x80};
+    data[63] = 24;
+    uint32_t s[8], ref[8];
+
+    sha256::Initialize(s);
+    tr(s, data, 1);
+    if (memcmp(s, abc_state, sizeof(s)))
+        return false;
+
+    for (size_t i = 0; i < sizeof(data); i++)
+        data[i] = (unsigned char)(i * 131 + 7);
+    for (size_t blocks = 1; blocks <= sizeof(data) / 64; blocks++) {
+        sha256::Initialize(s);
+        sha256::Initialize(ref);
+        tr(s, data, blocks);
+        sha256::Transform(ref, data, blocks);
+        if (memcmp(s, ref, sizeof(s)))
+            return false;
+    }
+    return true;
+}
+
+#if defined(SHA256_X86)
+/** Check a multi-lane double SHA-256 against the single-lane one. */
+bool SelfTestD64(TransformD64Type tr, size_t lanes)
+{
+    unsigned char data[64 * 8], out[32 * 8], ref[32];
+    for (size_t i = 0; i < sizeof(data); i++)
+        data[i] = (unsigned char)(i * 151 + 3);
+    tr(out, data);
+    for (size_t l = 0; l < lanes; l++) {
+        TransformD64(ref, data + 64 * l);
+        if (memcmp(out + 32 * l, ref, sizeof(ref)))
+            return false;
+    }
+    return true;
+}
+
+/** Whether the OS saves the AVX registers on context switches. */
+bool AVXEnabled()
+{
+    uint32_t a, d;
+    __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    return (a & 6) == 6;
+}
+#endif
+
 } // namespace
 
+std::string SHA256AutoDetect()
+{
+    std::string ret = "standard";
+#if defined(SHA256_X86)
+    bool have_sse4 = false, have_avx = false, have_avx2 = false, have_bmi2 = false, have_shani = false;
+    uint32_t eax, ebx, ecx, edx;
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        have_sse4 = (ecx >> 19) & 1;
+        // AVX needs both CPU support and OS support (XSAVE enabled for the YMM state)
+        have_avx = ((ecx >> 27) & 1) && ((ecx >> 28) & 1) && AVXEnabled();
+    }
+    if (__get_cpuid_max(0, NULL) >= 7) {
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        have_avx2 = have_avx && ((ebx >> 5) & 1);
+        have_bmi2 = (ebx >> 8) & 1;
+        have_shani = (ebx >> 29) & 1;
+    }
+
+    if (have_shani && have_sse4 && SelfTest(sha256::TransformSHANI)) {
+        Transform = sha256::TransformSHANI;
+        ret = "shani";
+    }
+#if !defined(USE_AVX2)
+    else if (have_avx2 && have_bmi2 && SelfTest(sha256::TransformAVX2)) {
+        Transform = sha256::TransformAVX2;
+        ret = "avx2";
+    }
+#endif
+
+    if (have_sse4 && SelfTestD64(sha256d64_lanes::Transform_4way, 4)) {
+        TransformD64_4way = sha256d64_lanes::Transform_4way;
+        ret += ",sse41(4way)";
+    }
+    if (have_avx2 && SelfTestD64(sha256d64_lanes::Transform_8way, 8)) {
+        TransformD64_8way = sha256d64_lanes::Transform_8way;
+        ret += ",avx2(8way)";
+    }
+#endif
+
+    assert(SelfTest(Transform));
+    return ret;
+}
+
+void SHA256D64(unsigned char* out, const unsigned char* in, size_t blocks)
+{
+    if (TransformD64_8way) {
+        while (blocks >= 8) {
+            TransformD64_8way(out, in);
+            out += 256;
+            in += 512;
+            blocks -= 8;
+        }
+    }
+    if (TransformD64_4way) {
+        while (blocks >= 4) {
+            TransformD64_4way(out, in);
+            out += 128;
+            in += 256;
+            blocks -= 4;
+        }
+    }
+    while (blocks) {
+        TransformD64(out, in);
+        out += 32;
+        in += 64;
+        --blocks;
+    }
+}
+
 
 ////// SHA-256
 
@@ -352,14 +829,15 @@ CSHA256& CSHA256::Write(const unsigned char* data, size_t len)
         memcpy(buf + bufsize, data, 64 - bufsize);
         bytes += 64 - bufsize;
         data += 64 - bufsize;
-        sha256::Transform(s, buf);
+        Transform(s, buf, 1);
         bufsize = 0;
     }
-    while (end >= data + 64) {
+    if (end - data >= 64) {
         // Process full chunks directly from the source.
-        sha256::Transform(s, data);
-        bytes += 64;
-        data += 64;
+        size_t blocks = (end - data) / 64;
+        Transform(s, data, blocks);
+        data += 64 * blocks;
+        bytes += 64 * blocks;
     }
     if (end > data) {
         // Fill the buffer with what remains.
@@ -207,4 +207,15 @@ public:
  */
 uint64_t SipHashUint256(uint64_t k0, uint64_t k1, const uint256& val);
 
+/** Optimized SipHash-2-4 implementation for a uint256 followed by a 32-bit
+ *  integer, such as an outpoint.
+ *
+ *  It is identical to:
+ *    SipHasher(k0, k1)
+ *      .Write(val.begin(), 32)
+ *      .Write(little-endian bytes of extra, 4)
+ *      .Finalize()
+ */
+uint64_t SipHashUint256Extra(uint64_t k0, uint64_t k1, const uint256& val, uint32_t extra);
+
 #endif // BITCOIN_HASH_H
@@ -12,11 +12,17 @@
 
 #include "addrman.h"
 #include "amount.h"
+#include "blockfilemap.h"
+#include "blockreadahead.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "checkpoints.h"
+#include "coinsflush.h"
+#include "coinsprefetch.h"
 #include "compat/sanity.h"
 #include "consensus/validation.h"
+#include "crypto/scrypt.h"
+#include "crypto/sha256.h"
 #include "httpserver.h"
 #include "httprpc.h"
 #include "key.h"
@@ -26,6 +32,7 @@
 #include "net.h"
 #include "net_processing.h"
 #include "policy/policy.h"
+#include "reindex.h"
 #include "rpc/server.h"
 #include "rpc/register.h"
 #include "script/standard.h"
@@ -150,9 +157,9 @@ class CCoinsViewErrorCatcher : public CCoinsViewBacked
 {
 public:
     CCoinsViewErrorCatcher(CCoinsView* view) : CCoinsViewBacked(view) {}
-    bool GetCoins(const uint256 &txid, CCoins &coins) const {
+    bool GetCoin(const COutPoint &outpoint, Coin &coin) const {
         try {
-            return CCoinsViewBacked::GetCoins(txid, coins);
+            return CCoinsViewBacked::GetCoin(outpoint, coin);
         } catch(const std::runtime_error& e) {
             uiInterface.ThreadSafeMessageBox(_("Error reading from database, shutting down."), "", CClientUIInterface::MSG_ERROR);
             LogPrintf("Error reading from database: %s\n", e.what());
@@ -234,6 +241,14 @@ void Shutdown()
         }
         delete pcoinsTip;
         pcoinsTip = NULL;
+        delete pcoinsFlusher;
+        pcoinsFlusher = NULL;
+        delete pcoinsPrefetch;
+        pcoinsPrefetch = NULL;
+        delete pblockReadAhead;
+        pblockReadAhead = NULL;
+        delete pblockFileMap;
+        pblockFileMap = NULL;
         delete pcoinscatcher;
         pcoinscatcher = NULL;
         delete pcoinsdbview;
@@ -328,9 +343,14 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-version", _("Print version and exit"));
     strUsage += HelpMessageOpt("-alertnotify=<cmd>", _("Execute command when we see a really long fork (%s in cmd is replaced by message)"));
     strUsage += HelpMessageOpt("-blocknotify=<cmd>", _("Execute command when the best block changes (%s in cmd is replaced by block hash, %i is replaced by block number)"));
+    strUsage += HelpMessageOpt("-blockcache=<n>", strprintf(_("Keep at most <n> MiB of recently served blocks in memory for peers, RPC, REST and ZMQ (default: %u)"), DEFAULT_BLOCK_CACHE_SIZE));
+    strUsage += HelpMessageOpt("-blockfilemaps=<n>", strprintf(_("Keep up to <n> block and undo files memory-mapped for reading (0 to read them with fread, default: %u)"), DEFAULT_BLOCK_FILE_MAPS));
+    strUsage += HelpMessageOpt("-blockreadahead=<n>", strprintf(_("Keep up to <n> MiB of blocks read from disk ahead of connecting them (0 to disable, default: %u)"), DEFAULT_BLOCK_READAHEAD));
     if (showDebug)
         strUsage += HelpMessageOpt("-blocksonly", strprintf(_("Whether to operate in a blocks only mode (default: %u)"), DEFAULT_BLOCKSONLY));
     strUsage +=HelpMessageOpt("-assumevalid=<hex>", strprintf(_("If this block is in the chain assume that it and its ancestors are valid and potentially skip their script verification (0 to verify all, default: %s, testnet: %s)"), Params(CBaseChainParams::MAIN).GetConsensus(0).defaultAssumeValid.GetHex(), Params(CBaseChainParams::TESTNET).GetConsensus(0).defaultAssumeValid.GetHex()));
+    strUsage += HelpMessageOpt("-auxpowcache=<n>", strprintf(_("Keep at most <n> MiB of auxpow data in memory for serving block headers (default: %u)"), DEFAULT_AUXPOW_CACHE_SIZE));
+    strUsage += HelpMessageOpt("-backgroundflush", strprintf(_("Write the coins cache to disk in the background while blocks keep being processed; the cache may then use up to twice -dbcache (default: %u)"), DEFAULT_BACKGROUND_FLUSH));
     strUsage += HelpMessageOpt("-backupdir=<dir>", _("Specify directory where to write backups and data dumps (default datadir/backups)"));
     strUsage += HelpMessageOpt("-conf=<file>", strprintf(_("Specify configuration file (default: %s)"), BITCOIN_CONF_FILENAME));
     if (mode == HMM_BITCOIND)
@@ -341,6 +361,7 @@ std::string HelpMessage(HelpMessageMode mode)
     }
     strUsage += HelpMessageOpt("-datadir=<dir>", _("Specify data directory"));
     strUsage += HelpMessageOpt("-dbcache=<n>", strprintf(_("Set database cache size in megabytes (%d to %d, default: %d)"), nMinDbCache, nMaxDbCache, nDefaultDbCache));
+    strUsage += HelpMessageOpt("-dbcachekeep=<n>", strprintf(_("Percentage of the in-memory UTXO set to keep when it is written to disk, favouring the most recently created coins (0 to 100, default: %u)"), DEFAULT_COINS_CACHE_KEEP));
     if (showDebug)
         strUsage += HelpMessageOpt("-feefilter", strprintf("Tell other nodes to filter invs to us by our mempool min fee (default: %u)", DEFAULT_FEEFILTER));
     strUsage += HelpMessageOpt("-loadblock=<file>", _("Imports blocks from external blk000??.dat file on startup"));
@@ -353,11 +374,15 @@ std::string HelpMessage(HelpMessageMode mode)
 #ifndef WIN32
     strUsage += HelpMessageOpt("-pid=<file>", strprintf(_("Specify pid file (default: %s)"), BITCOIN_PID_FILENAME));
 #endif
+    strUsage += HelpMessageOpt("-prefetchthreads=<n>", strprintf(_("Set the number of threads that read ahead the coins spent by new blocks (0 to %d, 0 = disable, default: %d)"),
+        MAX_COINS_PREFETCH_THREADS, DEFAULT_COINS_PREFETCH_THREADS));
     strUsage += HelpMessageOpt("-prune=<n>", strprintf(_("Reduce storage requirements by enabling pruning (deleting) of old blocks. This allows the pruneblockchain RPC to be called to delete specific blocks, and enables automatic pruning of old blocks if a target size in MiB is provided. This mode is incompatible with -txindex and -rescan. "
             "Warning: Reverting this setting requires re-downloading the entire blockchain. "
             "(default: 0 = disable pruning blocks, 1 = allow manual pruning via RPC, >%u = automatically prune block files to stay under the specified target size in MiB)"), MIN_DISK_SPACE_FOR_BLOCK_FILES / 1024 / 1024));
     strUsage += HelpMessageOpt("-reindex-chainstate", _("Rebuild chain state from the currently indexed blocks"));
     strUsage += HelpMessageOpt("-reindex", _("Rebuild chain state and block index from the blk*.dat files on disk"));
+    strUsage += HelpMessageOpt("-reindexthreads=<n>", strprintf(_("Number of threads reading and checking blk*.dat files during -reindex (0 = one per core, up to %d, default: %d)"), MAX_REINDEX_THREADS, DEFAULT_REINDEX_THREADS));
+    strUsage += HelpMessageOpt("-reindexreadahead=<n>", strprintf(_("Stop reading blk*.dat files ahead during -reindex once they add up to <n> MiB on disk, plus at most one file; blocks take more memory once read (default: %u)"), DEFAULT_REINDEX_READAHEAD));
 #ifndef WIN32
     strUsage += HelpMessageOpt("-sysperms", _("Create new files with system default permissions, instead of umask 077 (only effective with disabled wallet functionality)"));
 #endif
@@ -424,6 +449,8 @@ std::string HelpMessage(HelpMessageMode mode)
     {
         strUsage += HelpMessageOpt("-checkblocks=<n>", strprintf(_("How many blocks to check at startup (default: %u, 0 = all)"), DEFAULT_CHECKBLOCKS));
         strUsage += HelpMessageOpt("-checklevel=<n>", strprintf(_("How thorough the block verification of -checkblocks is (0-4, default: %u)"), DEFAULT_CHECKLEVEL));
+        strUsage += HelpMessageOpt("-checkheaderpow", strprintf("Check the proof of work of all block headers at startup and store auxpow data missing from the block index database (default: %u)", DEFAULT_CHECKHEADERPOW));
+        strUsage += HelpMessageOpt("-checkblockreads", strprintf("Check the proof of work and merkle root of every block read from disk, also for blocks whose header was already accepted (default: %u)", DEFAULT_CHECKBLOCKREADS));
         strUsage += HelpMessageOpt("-checkblockindex", strprintf("Do a full consistency check for mapBlockIndex, setBlockIndexCandidates, chainActive and mapBlocksUnlinked occasionally. Also sets -checkmempool (default: %u)", Params(CBaseChainParams::MAIN).DefaultConsistencyChecks()));
         strUsage += HelpMessageOpt("-checkmempool=<n>", strprintf("Run checks every <n> transactions (default: %u)", Params(CBaseChainParams::MAIN).DefaultConsistencyChecks()));
         strUsage += HelpMessageOpt("-checkpoints", strprintf("Disable expensive verification for known chain history (default: %u)", DEFAULT_CHECKPOINTS_ENABLED));
@@ -446,6 +473,7 @@ std::string HelpMessage(HelpMessageMode mode)
     if (showDebug)
         strUsage += HelpMessageOpt("-nodebug", "Turn off debugging messages, same as -debug=0");
     strUsage += HelpMessageOpt("-help-debug", _("Show all debugging options (usage: --help -help-debug)"));
+    strUsage += HelpMessageOpt("-lockstats", strprintf(_("Record how long threads wait for and hold locks, see getlockstats (default: %u)"), DEFAULT_LOCK_STATS));
     strUsage += HelpMessageOpt("-logips", strprintf(_("Include IP addresses in debug output (default: %u)"), DEFAULT_LOGIPS));
     strUsage += HelpMessageOpt("-logtimestamps", strprintf(_("Prepend debug output with timestamp (default: %u)"), DEFAULT_LOGTIMESTAMPS));
     if (showDebug)
@@ -596,8 +624,11 @@ void CleanupBlockRevFiles()
         {
             if (it->path().filename().string().substr(0,3) == "blk")
                 mapBlockFiles[it->path().filename().string().substr(3,5)] = it->path();
-            else if (it->path().filename().string().substr(0,3) == "rev")
+            else if (it->path().filename().string().substr(0,3) == "rev") {
+                if (pblockFileMap)
+                    pblockFileMap->Forget(atoi(it->path().filename().string().substr(3,5)));
                 remove(it->path());
+            }
         }
     }
 
@@ -611,6 +642,8 @@ void CleanupBlockRevFiles()
             nContigCounter++;
             continue;
         }
+        if (pblockFileMap)
+            pblockFileMap->Forget(atoi(item.first));
         remove(item.second);
     }
 }
@@ -625,18 +658,13 @@ void ThreadImport(std::vector<boost::filesystem::path> vImportFiles)
 
     // -reindex
     if (fReindex) {
-        int nFile = 0;
-        while (true) {
-            CDiskBlockPos pos(nFile, 0);
-            if (!boost::filesystem::exists(GetBlockPosFilename(pos, "blk")))
-                break; // No block files left to reindex
-            FILE *file = OpenBlockFile(pos, true);
-            if (!file)
-                break; // This error is logged in OpenBlockFile
-            LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int)nFile);
-            LoadExternalBlockFile(chainparams, file, &pos);
-            nFile++;
-        }
+        int nThreads = GetArg("-reindexthreads", DEFAULT_REINDEX_THREADS);
+        if (nThreads <= 0)
+            nThreads = GetNumCores();
+        nThreads = std::max(1, std::min(nThreads, MAX_REINDEX_THREADS));
+        int64_t nReadAhead = std::max<int64_t>(0, GetArg("-reindexreadahead", DEFAULT_REINDEX_READAHEAD));
+        LogPrintf("Reindexing with %d threads reading block files, up to %d MiB ahead\n", nThreads, nReadAhead);
+        ReindexBlockFiles(chainparams, nThreads, (uint64_t)nReadAhead << 20);
         pblocktree->WriteReindexing(false);
         fReindex = false;
         LogPrintf("Reindexing finished\n");
@@ -794,6 +822,7 @@ void InitLogging()
     fLogTimestamps = GetBoolArg("-logtimestamps", DEFAULT_LOGTIMESTAMPS);
     fLogTimeMicros = GetBoolArg("-logtimemicros", DEFAULT_LOGTIMEMICROS);
     fLogIPs = GetBoolArg("-logips", DEFAULT_LOGIPS);
+    fLockStats = GetBoolArg("-lockstats", DEFAULT_LOCK_STATS);
 
     LogPrintf("\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n");
     LogPrintf("JunkCoin version %s\n", FormatFullVersion());
@@ -948,6 +977,7 @@ bool AppInitParameterInteraction()
     }
     fCheckBlockIndex = GetBoolArg("-checkblockindex", chainparams.DefaultConsistencyChecks());
     fCheckpointsEnabled = GetBoolArg("-checkpoints", DEFAULT_CHECKPOINTS_ENABLED);
+    fCheckBlockReads = GetBoolArg("-checkblockreads", DEFAULT_CHECKBLOCKREADS);
 
     hashAssumeValid = uint256S(GetArg("-assumevalid", chainparams.GetConsensus(0).defaultAssumeValid.GetHex()));
     if (!hashAssumeValid.IsNull())
@@ -1161,6 +1191,9 @@ bool AppInitSanityChecks()
 {
     // ********************************************************* Step 4: sanity checks
 
+    std::string sha256_algo = SHA256AutoDetect();
+    LogPrintf("Using the '%s' SHA256 implementation\n", sha256_algo);
+
     // Initialize elliptic curve code
     ECC_Start();
     globalVerifyHandle.reset(new ECCVerifyHandle());
@@ -1207,10 +1240,20 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
 
     InitSignatureCache();
 
+    int64_t nAuxpowCacheSize = std::max((int64_t)0, GetArg("-auxpowcache", DEFAULT_AUXPOW_CACHE_SIZE));
+    auxpowCache.SetMaxUsage(nAuxpowCacheSize << 20);
+    LogPrintf("Using %d MiB for the auxpow header cache\n", nAuxpowCacheSize);
+
+    int64_t nBlockCacheSize = std::max((int64_t)0, GetArg("-blockcache", DEFAULT_BLOCK_CACHE_SIZE));
+    blockCache.SetMaxUsage(nBlockCacheSize << 20);
+    LogPrintf("Using %d MiB for the served block cache\n", nBlockCacheSize);
+
     LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
     if (nScriptCheckThreads) {
         for (int i=0; i<nScriptCheckThreads-1; i++)
             threadGroup.create_thread(&ThreadScriptCheck);
+        for (int i=0; i<nScriptCheckThreads-1; i++)
+            threadGroup.create_thread(&ThreadHeaderCheck);
     }
 
     // Start the lightweight task scheduler thread
@@ -1234,6 +1277,7 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
 #if defined(USE_SSE2)
     scrypt_detect_sse2();
 #endif
+    LogPrintf("Using %s scrypt kernel for header batches\n", scrypt_multi_impl());
 
     // ********************************************************* Step 5: verify wallet database integrity
 #ifdef ENABLE_WALLET
@@ -1427,6 +1471,12 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
         }
     }
 
+    int nBlockFileMaps = std::max(0, (int)GetArg("-blockfilemaps", DEFAULT_BLOCK_FILE_MAPS));
+    if (nBlockFileMaps > 0) {
+        LogPrintf("Keeping up to %d block files memory-mapped\n", nBlockFileMaps);
+        pblockFileMap = new CBlockFileMap(nBlockFileMaps);
+    }
+
     // cache size calculations
     int64_t nTotalCache = (GetArg("-dbcache", nDefaultDbCache) << 20);
     nTotalCache = std::max(nTotalCache, nMinDbCache << 20); // total cache cannot be less than nMinDbCache
@@ -1437,12 +1487,17 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
     int64_t nCoinDBCache = std::min(nTotalCache / 2, (nTotalCache / 4) + (1 << 23)); // use 25%-50% of the remainder for disk cache
     nCoinDBCache = std::min(nCoinDBCache, nMaxCoinsDBCache << 20); // cap total coins db cache
     nTotalCache -= nCoinDBCache;
+    int nPrefetchThreads = std::max(0, std::min((int)GetArg("-prefetchthreads", DEFAULT_COINS_PREFETCH_THREADS), MAX_COINS_PREFETCH_THREADS));
+    int64_t nCoinPrefetchCache = nPrefetchThreads > 0 ? std::min(nTotalCache / 8, MAX_COINS_PREFETCH_CACHE << 20) : 0;
+    nTotalCache -= nCoinPrefetchCache;
     nCoinCacheUsage = nTotalCache; // the rest goes to in-memory cache
     int64_t nMempoolSizeMax = GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
     LogPrintf("Cache configuration:\n");
     LogPrintf("* Using %.1fMiB for block index database\n", nBlockTreeDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for in-memory UTXO set (plus up to %.1fMiB of unused mempool space)\n", nCoinCacheUsage * (1.0 / 1024 / 1024), nMempoolSizeMax * (1.0 / 1024 / 1024));
+    if (nPrefetchThreads > 0)
+        LogPrintf("* Using %.1fMiB for prefetched UTXOs\n", nCoinPrefetchCache * (1.0 / 1024 / 1024));
 
     bool fLoaded = false;
     while (!fLoaded) {
@@ -1456,6 +1511,8 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
             try {
                 UnloadBlockIndex();
                 delete pcoinsTip;
+                delete pcoinsFlusher;
+                delete pcoinsPrefetch;
                 delete pcoinsdbview;
                 delete pcoinscatcher;
                 delete pblocktree;
@@ -1463,7 +1520,23 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
                 pblocktree = new CBlockTreeDB(nBlockTreeDBCache, false, fReindex);
                 pcoinsdbview = new CCoinsViewDB(nCoinDBCache, false, fReindex || fReindexChainState);
                 pcoinscatcher = new CCoinsViewErrorCatcher(pcoinsdbview);
-                pcoinsTip = new CCoinsViewCache(pcoinscatcher);
+
+                // If necessary, upgrade from older database format.
+                if (!pcoinsdbview->Upgrade()) {
+                    strLoadError = _("Error upgrading chainstate database");
+                    break;
+                }
+
+                if (!LoadUTXOCommitment(pcoinsdbview)) {
+                    strLoadError = _("Error loading UTXO set commitment");
+                    break;
+                }
+
+                pcoinsPrefetch = new CCoinsViewPrefetch(pcoinscatcher, nCoinPrefetchCache);
+                pcoinsFlusher = new CCoinsViewFlusher(pcoinsPrefetch, &utxoCommitment);
+                // Writes now come from pcoinsFlusher, along with the commitment they belong to.
+                pcoinsdbview->SetCommitment(pcoinsFlusher->GetWritingCommitment());
+                pcoinsTip = new CCoinsViewCache(pcoinsFlusher);
 
                 if (fReindex) {
                     pblocktree->WriteReindexing(true);
@@ -1477,6 +1550,17 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
                     break;
                 }
 
+                // A UTXO snapshot that was being loaded left a partial set behind.
+                bool fSnapshotLoading = false;
+                pblocktree->ReadFlag("utxosnapshotloading", fSnapshotLoading);
+                if (fSnapshotLoading) {
+                    if (!fReindexChainState) {
+                        strLoadError = _("Loading a UTXO snapshot was interrupted. You need to rebuild the database using -reindex-chainstate");
+                        break;
+                    }
+                    pblocktree->WriteFlag("utxosnapshotloading", false);
+                }
+
                 // If the loaded chain has a wrong genesis, bail out immediately
                 // (we're likely using a testnet datadir, or the other way around).
                 if (!mapBlockIndex.empty() && mapBlockIndex.count(chainparams.GetConsensus(0).hashGenesisBlock) == 0)
@@ -1571,6 +1655,19 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
     }
     LogPrintf(" block index %15dms\n", GetTimeMillis() - nStart);
 
+    LogPrintf("Using %d threads for UTXO prefetching\n", nPrefetchThreads);
+    pcoinsPrefetch->StartThreads(threadGroup, nPrefetchThreads);
+
+    if (GetBoolArg("-backgroundflush", DEFAULT_BACKGROUND_FLUSH))
+        pcoinsFlusher->StartThread(threadGroup);
+
+    int64_t nBlockReadAhead = std::max((int64_t)0, GetArg("-blockreadahead", DEFAULT_BLOCK_READAHEAD));
+    if (nBlockReadAhead > 0) {
+        LogPrintf("Using %dMiB for reading blocks ahead\n", nBlockReadAhead);
+        pblockReadAhead = new CBlockReadAhead(nBlockReadAhead << 20);
+        pblockReadAhead->StartThreads(threadGroup, 1);
+    }
+
     boost::filesystem::path est_path = GetDataDir() / FEE_ESTIMATES_FILENAME;
     CAutoFile est_filein(fopen(est_path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
     // Allowed to fail as this file IS missing on first startup.
@@ -1599,6 +1696,13 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
         }
     }
 
+    // Likewise if the chainstate was loaded from a UTXO snapshot, as the
+    // blocks before it were never downloaded.
+    if (pindexSnapshotBase) {
+        LogPrintf("Unsetting NODE_NETWORK, blocks before the loaded UTXO snapshot are missing\n");
+        nLocalServices = ServiceFlags(nLocalServices & ~NODE_NETWORK);
+    }
+
     if (chainparams.GetConsensus(0).vDeployments[Consensus::DEPLOYMENT_SEGWIT].nTimeout != 0) {
         // Only advertise witness capabilities if they have a reasonable start time.
         // This allows us to have the code merged without a defined softfork, by setting its
@@ -3,9 +3,11 @@
 
 #include "policy/policy.h"
 #include "arith_uint256.h"
+#include "crypto/scrypt.h"
 #include "junkcoin.h"
 #include "txmempool.h"
 #include "util.h"
+#include "utilstrencodings.h"
 #include "validation.h"
 #include "junkcoin-fees.h"
 
@@ -69,7 +71,12 @@ unsigned int CalculateJunkcoinNextWorkRequired(bool fNewDifficultyProtocol, cons
     return bnNew.GetCompact();
 }
 
-bool CheckAuxPowProofOfWork(const CBlockHeader& block, const Consensus::Params& params) {
+/**
+ * Shared implementation of the PoW checks. If phashPoW is set, it holds the
+ * already computed scrypt hash of the header that carries the work (the block
+ * itself, or the auxpow parent block).
+ */
+static bool CheckAuxPowProofOfWork(const CBlockHeader& block, const Consensus::Params& params, const uint256* phashPoW) {
     // Verify chain ID for non-legacy blocks
     if (!block.IsLegacy() && params.fStrictChainId && block.GetChainId() != params.nAuxpowChainId) {
         return error("%s: block does not have our chain ID (got %d, expected %d, full nVersion %d)",
@@ -87,7 +94,7 @@ bool CheckAuxPowProofOfWork(const CBlockHeader& block, const Consensus::Params&
             return true;
         }
 
-        return CheckProofOfWork(block.GetPoWHash(), block.nBits, params);
+        return CheckProofOfWork(phashPoW ? *phashPoW : block.GetPoWHash(), block.nBits, params);
     }
 
     // Verify auxpow blocks
@@ -99,7 +106,27 @@ bool CheckAuxPowProofOfWork(const CBlockHeader& block, const Consensus::Params&
         return error("%s: AUX POW is not valid", __func__);
     }
 
-    return CheckProofOfWork(block.auxpow->getParentBlockPoWHash(), block.nBits, params);
+    return CheckProofOfWork(phashPoW ? *phashPoW : block.auxpow->getParentBlockPoWHash(), block.nBits, params);
+}
+
+bool CheckAuxPowProofOfWork(const CBlockHeader& block, const Consensus::Params& params) {
+    return CheckAuxPowProofOfWork(block, params, NULL);
+}
+
+void CheckAuxPowProofOfWorkBatch(const CBlockHeader* headers, size_t count, const Consensus::Params& params, unsigned char* results) {
+    // Gather the 80 byte headers that carry the work, see CPureBlockHeader::GetPoWHash
+    std::vector<char> vInput(80 * count);
+    for (size_t i = 0; i < count; i++) {
+        const CPureBlockHeader& powHeader = headers[i].auxpow ? headers[i].auxpow->getParentBlock() : headers[i];
+        memcpy(&vInput[80 * i], BEGIN(powHeader.nVersion), 80);
+    }
+
+    std::vector<uint256> vHashPoW(count);
+    if (count > 0)
+        scrypt_1024_1_1_256_multi(&vInput[0], BEGIN(vHashPoW[0]), count);
+
+    for (size_t i = 0; i < count; i++)
+        results[i] = CheckAuxPowProofOfWork(headers[i], params, &vHashPoW[i]) ? 1 : 0;
 }
 
 CAmount GetJunkcoinBlockSubsidy(int nHeight, CAmount nFees, const Consensus::Params& consensusParams, uint256 prevHash) {
@@ -23,3 +23,14 @@ unsigned int CalculateJunkcoinNextWorkRequired(bool fNewDifficultyProtocol, cons
  * @return True iff the PoW is correct.
  */
 bool CheckAuxPowProofOfWork(const CBlockHeader& block, const Consensus::Params& params);
+
+/**
+ * Check proof-of-work of a batch of block headers, taking auxpow into account.
+ * The scrypt hashes of all headers (or of their auxpow parent blocks) are
+ * computed together with scrypt_1024_1_1_256_multi.
+ * @param headers Pointer to the first of count block headers.
+ * @param count Number of headers to check.
+ * @param params Consensus parameters.
+ * @param results Set to 1 for every header whose PoW is correct, 0 otherwise.
+ */
+void CheckAuxPowProofOfWorkBatch(const CBlockHeader* headers, size_t count, const Consensus::Params& params, unsigned char* results);
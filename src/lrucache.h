@@ -0,0 +1,147 @@
+// Copyright (c) 2026 The Junkcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_LRUCACHE_H
+#define BITCOIN_LRUCACHE_H
+
+#include "memusage.h"
+#include "sync.h"
+
+#include <functional>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * Memory-bounded cache of serialized objects with least-recently-used
+ * eviction. Values are immutable byte vectors handed out through shared
+ * pointers, so a hit never copies the data and an entry may be evicted
+ * while a caller still uses it. All methods are thread safe.
+ */
+template <typename K, typename Hash = std::hash<K> >
+class CLRUCache
+{
+public:
+    typedef std::shared_ptr<const std::vector<unsigned char> > value_ptr;
+
+    struct Stats
+    {
+        size_t nEntries;
+        size_t nUsage;
+        size_t nMaxUsage;
+        uint64_t nHits;
+        uint64_t nMisses;
+    };
+
+private:
+    typedef std::pair<K, value_ptr> Entry;
+    typedef std::list<Entry> EntryList;
+    typedef std::unordered_map<K, typename EntryList::iterator, Hash> EntryMap;
+
+    mutable CCriticalSection cs;
+    //! Entries ordered from most to least recently used
+    EntryList entries;
+    EntryMap index;
+    //! Accounted memory of all entries, excluding the hash table buckets
+    size_t nUsage;
+    size_t nMaxUsage;
+    uint64_t nHits;
+    uint64_t nMisses;
+
+    static size_t EntryUsage(const value_ptr& value)
+    {
+        // list node, hash table node and the shared vector with its buffer
+        return memusage::MallocUsage(sizeof(Entry) + 2 * sizeof(void*)) +
+               memusage::MallocUsage(sizeof(std::pair<const K, typename EntryList::iterator>) + 2 * sizeof(void*)) +
+               memusage::MallocUsage(sizeof(std::vector<unsigned char>)) + memusage::MallocUsage(sizeof(memusage::stl_shared_counter)) +
+               memusage::DynamicUsage(*value);
+    }
+
+    void EraseEntry(typename EntryList::iterator it)
+    {
+        nUsage -= EntryUsage(it->second);
+        index.erase(it->first);
+        entries.erase(it);
+    }
+
+    void Trim()
+    {
+        while (!entries.empty() && nUsage > nMaxUsage)
+            EraseEntry(std::prev(entries.end()));
+    }
+
+public:
+    explicit CLRUCache(size_t nMaxUsageIn) : nUsage(0), nMaxUsage(nMaxUsageIn), nHits(0), nMisses(0) {}
+
+    //! Change the memory limit, evicting entries if it shrank
+    void SetMaxUsage(size_t nMaxUsageIn)
+    {
+        LOCK(cs);
+        nMaxUsage = nMaxUsageIn;
+        Trim();
+    }
+
+    //! Look up a key, marking it as most recently used. Returns null on a miss.
+    value_ptr Get(const K& key)
+    {
+        LOCK(cs);
+        typename EntryMap::iterator it = index.find(key);
+        if (it == index.end()) {
+            nMisses++;
+            return value_ptr();
+        }
+        nHits++;
+        entries.splice(entries.begin(), entries, it->second);
+        return it->second->second;
+    }
+
+    //! Add or replace an entry. Values larger than the whole cache are not kept.
+    void Insert(const K& key, const value_ptr& value)
+    {
+        LOCK(cs);
+        typename EntryMap::iterator it = index.find(key);
+        if (it != index.end())
+            EraseEntry(it->second);
+        const size_t nEntryUsage = EntryUsage(value);
+        if (nEntryUsage > nMaxUsage)
+            return;
+        entries.push_front(Entry(key, value));
+        index.emplace(key, entries.begin());
+        nUsage += nEntryUsage;
+        Trim();
+    }
+
+    void Erase(const K& key)
+    {
+        LOCK(cs);
+        typename EntryMap::iterator it = index.find(key);
+        if (it != index.end())
+            EraseEntry(it->second);
+    }
+
+    //! Drop all entries. Hit and miss counters are kept.
+    void Clear()
+    {
+        LOCK(cs);
+        entries.clear();
+        index.clear();
+        nUsage = 0;
+    }
+
+    Stats GetStats() const
+    {
+        LOCK(cs);
+        Stats stats;
+        stats.nEntries = entries.size();
+        stats.nUsage = nUsage + memusage::MallocUsage(sizeof(void*) * index.bucket_count());
+        stats.nMaxUsage = nMaxUsage;
+        stats.nHits = nHits;
+        stats.nMisses = nMisses;
+        return stats;
+    }
+};
+
+#endif // BITCOIN_LRUCACHE_H
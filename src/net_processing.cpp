@@ -10,6 +10,7 @@
 #include <array>
 #include "arith_uint256.h"
 #include "blockencodings.h"
+#include "blockfilemap.h"
 #include "chainparams.h"
 #include "consensus/validation.h"
 #include "hash.h"
@@ -1084,12 +1085,13 @@ bool static AlreadyHave(const CInv& inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
                 recentRejects->reset();
             }
 
-            // Use pcoinsTip->HaveCoinsInCache as a quick approximation to exclude
+            // Use pcoinsTip->HaveCoinInCache as a quick approximation to exclude
             // requesting or processing some txs which have already been included in a block
             return recentRejects->contains(inv.hash) ||
                    mempool.exists(inv.hash) ||
                    mapOrphanTransactions.count(inv.hash) ||
-                   pcoinsTip->HaveCoinsInCache(inv.hash);
+                   pcoinsTip->HaveCoinInCache(COutPoint(inv.hash, 0)) || // Best effort: only try output 0 and 1
+                   pcoinsTip->HaveCoinInCache(COutPoint(inv.hash, 1));
         }
     case MSG_BLOCK:
     case MSG_WITNESS_BLOCK:
@@ -1215,11 +1217,23 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                 // it's available before trying to send.
                 if (send && (mi->second->nStatus & BLOCK_HAVE_DATA))
                 {
-                    // Send block from disk
+                    // Send block from blockCache or disk. Block files hold
+                    // blocks in the serialization with witnesses, which is
+                    // what the peer gets for a full block unless it asked for
+                    // one without witnesses, and blocks from before segwit
+                    // activated have none to strip. Those are sent as they
+                    // are stored.
                     CBlock block;
-                    if (!ReadBlockFromDisk(block, (*mi).second, consensusParams, false))
+                    CByteSpan rawBlock;
+                    if (!ReadRawBlockCached(rawBlock, mi->second, Params().MessageStart()))
                         assert(!"cannot load block from disk");
-                    if (inv.type == MSG_BLOCK)
+                    bool fRaw = inv.type == MSG_WITNESS_BLOCK ||
+                        (inv.type == MSG_BLOCK && !IsWitnessEnabled(mi->second->pprev, Params().GetConsensus(mi->second->nHeight)));
+                    if (!fRaw && !DecodeRawBlock(block, rawBlock))
+                        assert(!"cannot load block from disk");
+                    if (fRaw)
+                        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, CFlatData((void*)rawBlock.data, (void*)(rawBlock.data + rawBlock.size))));
+                    else if (inv.type == MSG_BLOCK)
                         connman.PushMessage(pfrom, msgMaker.Make(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::BLOCK, block));
                     else if (inv.type == MSG_WITNESS_BLOCK)
                         connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, block));
@@ -1979,7 +1993,13 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         LogPrint("net", "getheaders %d to %s from peer=%d\n", (pindex ? pindex->nHeight : -1), hashStop.IsNull() ? "end" : hashStop.ToString(), pfrom->id);
         for (; pindex; pindex = chainActive.Next(pindex))
         {
-            vHeaders.push_back(pindex->GetBlockHeader(chainparams.GetConsensus(pindex->nHeight), false));
+            vHeaders.push_back(CBlock());
+            if (!pindex->GetBlockHeader(vHeaders.back(), chainparams.GetConsensus(pindex->nHeight), false)) {
+                // Send what we have, the peer asks again from there.
+                vHeaders.pop_back();
+                pindex = pindex->pprev;
+                break;
+            }
             if (--nLimit <= 0 || pindex->GetBlockHash() == hashStop)
                 break;
         }
@@ -3214,14 +3234,22 @@ bool SendMessages(CNode* pto, CConnman& connman, const std::atomic<bool>& interr
                     pBestIndex = pindex;
                     if (fFoundStartingHeader) {
                         // add this to the headers message
-                        vHeaders.push_back(pindex->GetBlockHeader(consensusParams, false));
+                        vHeaders.push_back(CBlock());
+                        if (!pindex->GetBlockHeader(vHeaders.back(), consensusParams, false)) {
+                            fRevertToInv = true;
+                            break;
+                        }
                     } else if (PeerHasHeader(&state, pindex)) {
                         continue; // keep looking for the first new block
                     } else if (pindex->pprev == NULL || PeerHasHeader(&state, pindex->pprev)) {
                         // Peer doesn't have this header but they do have the prior one.
                         // Start sending headers.
                         fFoundStartingHeader = true;
-                        vHeaders.push_back(pindex->GetBlockHeader(consensusParams, false));
+                        vHeaders.push_back(CBlock());
+                        if (!pindex->GetBlockHeader(vHeaders.back(), consensusParams, false)) {
+                            fRevertToInv = true;
+                            break;
+                        }
                     } else {
                         // Peer doesn't have this header or the prior one -- nothing will
                         // connect, so bail out.
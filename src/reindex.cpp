@@ -0,0 +1,124 @@
+// Copyright (c) 2026 The Junkcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "reindex.h"
+
+#include "chainparams.h"
+#include "consensus/validation.h"
+#include "primitives/block.h"
+#include "util.h"
+#include "validation.h"
+
+#include <assert.h>
+
+#include <algorithm>
+
+#include <boost/bind.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/function.hpp>
+
+CReindexReader::CReindexReader(const CChainParams& chainparamsIn, int nThreadsIn, uint64_t nMaxBytesAheadIn) :
+    chainparams(chainparamsIn), nNextFile(0), nNextTake(0), nEndFile(-1), nThreads(std::max(1, nThreadsIn)), fStop(false),
+    nMaxBytesAhead(nMaxBytesAheadIn), nBytesAhead(0)
+{
+    for (int i = 0; i < nThreads; i++) {
+        boost::function<void()> threadFunc = boost::bind(&CReindexReader::ThreadReindex, this);
+        threadGroup.create_thread(boost::bind(&TraceThread<boost::function<void()> >, "reindex", threadFunc));
+    }
+}
+
+CReindexReader::~CReindexReader()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fStop = true;
+    }
+    condWorker.notify_all();
+    threadGroup.interrupt_all();
+    // The workers use this object, so they have to be gone before it is.
+    boost::this_thread::disable_interruption di;
+    threadGroup.join_all();
+}
+
+void CReindexReader::ThreadReindex()
+{
+    while (true) {
+        int nFile;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            while (!fStop && (nEndFile < 0 || nNextFile < nEndFile) &&
+                   (nNextFile >= nNextTake + nThreads || (nNextFile > nNextTake && nBytesAhead >= nMaxBytesAhead)))
+                condWorker.wait(lock);
+            if (fStop || (nEndFile >= 0 && nNextFile >= nEndFile))
+                return;
+            nFile = nNextFile++;
+            boost::system::error_code ec;
+            uint64_t nBytes = boost::filesystem::file_size(GetBlockPosFilename(CDiskBlockPos(nFile, 0), "blk"), ec);
+            if (ec)
+                nBytes = 0;
+            mapFileBytes[nFile] = nBytes;
+            nBytesAhead += nBytes;
+        }
+
+        std::vector<Block> vBlocks;
+        bool fExists = ReadFile(nFile, vBlocks);
+
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            if (!fExists) {
+                if (nEndFile < 0 || nFile < nEndFile)
+                    nEndFile = nFile;
+                nBytesAhead -= mapFileBytes[nFile];
+                mapFileBytes.erase(nFile);
+            } else {
+                ready[nFile].swap(vBlocks);
+            }
+        }
+        condRead.notify_all();
+    }
+}
+
+bool CReindexReader::ReadFile(int nFile, std::vector<Block>& vBlocks)
+{
+    CDiskBlockPos pos(nFile, 0);
+    if (!boost::filesystem::exists(GetBlockPosFilename(pos, "blk")))
+        return false; // No block files left to reindex
+    FILE* file = OpenBlockFile(pos, true);
+    if (!file)
+        return false; // This error is logged in OpenBlockFile
+
+    ScanExternalBlockFile(chainparams, file, &pos, [&](const std::shared_ptr<CBlock>& pblock) {
+        // A block that passes is marked fChecked, so AcceptBlock does not
+        // check it again. One that fails is checked again, and rejected,
+        // by AcceptBlock.
+        CValidationState state;
+        CheckBlock(*pblock, state);
+        Block block;
+        block.pblock = pblock;
+        block.pos = pos;
+        vBlocks.push_back(block);
+        return true;
+    });
+    return true;
+}
+
+bool CReindexReader::Take(int nFile, std::vector<Block>& vBlocks)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    assert(nFile == nNextTake);
+
+    std::map<int, std::vector<Block> >::iterator it;
+    while ((it = ready.find(nFile)) == ready.end()) {
+        if (nEndFile >= 0 && nFile >= nEndFile)
+            return false;
+        condRead.wait(lock);
+    }
+    vBlocks.swap(it->second);
+    ready.erase(it);
+    nBytesAhead -= mapFileBytes[nFile];
+    mapFileBytes.erase(nFile);
+    nNextTake++;
+    condWorker.notify_all();
+    return true;
+}
@@ -0,0 +1,93 @@
+// Copyright (c) 2026 The Junkcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_REINDEX_H
+#define BITCOIN_REINDEX_H
+
+#include "chain.h"
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+class CBlock;
+class CChainParams;
+
+/** Number of threads reading block files during -reindex (0 = one per core) */
+static const int DEFAULT_REINDEX_THREADS = 0;
+/** Maximum number of threads reading block files during -reindex */
+static const int MAX_REINDEX_THREADS = 8;
+/** Default for -reindexreadahead, the MiB of block files read ahead during -reindex */
+static const int64_t DEFAULT_REINDEX_READAHEAD = 512;
+
+/**
+ * Reads the blk?????.dat files for -reindex on worker threads.
+ *
+ * Each worker takes the next file, deserializes its blocks and runs the
+ * context-free CheckBlock on them, PoW included, so that only the checks
+ * that need the block index are left for the thread holding cs_main.
+ * Take() hands out the files in order. Workers stay at most as many files
+ * ahead of it as there are workers, and stop taking new files while the
+ * ones being read or waiting to be taken add up to nMaxBytesAhead (as
+ * stored on disk). The next file to be taken is always read, so that is
+ * exceeded by at most one file. This bounds the memory used for blocks
+ * that have been read but not taken.
+ */
+class CReindexReader
+{
+public:
+    struct Block {
+        std::shared_ptr<CBlock> pblock;
+        CDiskBlockPos pos;
+    };
+
+private:
+    const CChainParams& chainparams;
+    boost::thread_group threadGroup;
+
+    //! Protects everything below
+    boost::mutex mutex;
+    //! Workers wait on this for Take() to fall less far behind
+    boost::condition_variable condWorker;
+    //! Take() waits on this for files to be read
+    boost::condition_variable condRead;
+    //! Files that have been read and not taken yet
+    std::map<int, std::vector<Block> > ready;
+    //! Next file for a worker to read
+    int nNextFile;
+    //! File that Take() returns next
+    int nNextTake;
+    //! First file that does not exist, or -1 while none was found
+    int nEndFile;
+    int nThreads;
+    bool fStop;
+    const uint64_t nMaxBytesAhead;
+    //! Size on disk of the files being read or waiting to be taken
+    uint64_t nBytesAhead;
+    std::map<int, uint64_t> mapFileBytes;
+
+    void ThreadReindex();
+    //! Read and check the blocks of file nFile; false if there is no such file
+    bool ReadFile(int nFile, std::vector<Block>& vBlocks);
+
+public:
+    CReindexReader(const CChainParams& chainparamsIn, int nThreadsIn, uint64_t nMaxBytesAheadIn);
+    ~CReindexReader();
+
+    CReindexReader(const CReindexReader&) = delete;
+    CReindexReader& operator=(const CReindexReader&) = delete;
+
+    /**
+     * Wait for the blocks of file nFile, in the order they are stored in.
+     * Files must be taken in order, starting at 0. Returns false when
+     * there is no such file.
+     */
+    bool Take(int nFile, std::vector<Block>& vBlocks);
+};
+
+#endif // BITCOIN_REINDEX_H
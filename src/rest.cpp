@@ -4,6 +4,7 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "blockfilemap.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "primitives/block.h"
@@ -41,16 +42,19 @@ static const struct {
 };
 
 struct CCoin {
-    uint32_t nTxVer; // Don't call this nVersion, that name has a special meaning inside IMPLEMENT_SERIALIZE
     uint32_t nHeight;
     CTxOut out;
 
     ADD_SERIALIZE_METHODS;
 
+    CCoin() : nHeight(0) {}
+    CCoin(Coin&& in) : nHeight(in.nHeight), out(std::move(in.out)) {}
+
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action)
     {
-        READWRITE(nTxVer);
+        uint32_t nTxVerDummy = 0;
+        READWRITE(nTxVerDummy);
         READWRITE(nHeight);
         READWRITE(out);
     }
@@ -61,7 +65,7 @@ extern UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex,
 extern UniValue mempoolInfoToJSON();
 extern UniValue mempoolToJSON(bool fVerbose = false);
 extern void ScriptPubKeyToJSON(const CScript& scriptPubKey, UniValue& out, bool fIncludeHex);
-extern UniValue blockheaderToJSON(const CBlockIndex* blockindex);
+extern UniValue blockheaderToJSON(const CBlockIndex* blockindex, const CChainTip& chain);
 
 static bool RESTERR(HTTPRequest* req, enum HTTPStatusCode status, std::string message)
 {
@@ -148,22 +152,26 @@ static bool rest_headers(HTTPRequest* req,
 
     std::vector<const CBlockIndex *> headers;
     headers.reserve(count);
-    {
-        LOCK(cs_main);
-        BlockMap::const_iterator it = mapBlockIndex.find(hash);
-        const CBlockIndex *pindex = (it != mapBlockIndex.end()) ? it->second : NULL;
-        while (pindex != NULL && chainActive.Contains(pindex)) {
-            headers.push_back(pindex);
-            if (headers.size() == (unsigned long)count)
-                break;
-            pindex = chainActive.Next(pindex);
-        }
+    std::shared_ptr<const CChainTip> chain = GetChainTipSnapshot();
+    const CBlockIndex *pindex = LookupBlockIndex(hash);
+    while (pindex != NULL && chain->Contains(pindex)) {
+        headers.push_back(pindex);
+        if (headers.size() == (unsigned long)count)
+            break;
+        pindex = chain->Next(pindex);
     }
 
     CDataStream ssHeader(SER_NETWORK, PROTOCOL_VERSION);
     const CChainParams& chainparams = Params();
-    BOOST_FOREACH(const CBlockIndex *pindex, headers) {
-        ssHeader << pindex->GetBlockHeader(chainparams.GetConsensus(pindex->nHeight));
+    {
+        // GetBlockHeader reads fields of auxpow headers that change under cs_main.
+        LOCK(cs_main);
+        BOOST_FOREACH(const CBlockIndex *pindex, headers) {
+            CBlockHeader header;
+            if (!pindex->GetBlockHeader(header, chainparams.GetConsensus(pindex->nHeight)))
+                return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, pindex->GetBlockHash().GetHex() + " header not available");
+            ssHeader << header;
+        }
     }
 
     switch (rf) {
@@ -183,7 +191,7 @@ static bool rest_headers(HTTPRequest* req,
     case RF_JSON: {
         UniValue jsonHeaders(UniValue::VARR);
         BOOST_FOREACH(const CBlockIndex *pindex, headers) {
-            jsonHeaders.push_back(blockheaderToJSON(pindex));
+            jsonHeaders.push_back(blockheaderToJSON(pindex, *chain));
         }
         std::string strJSON = jsonHeaders.write() + "\n";
         req->WriteHeader("Content-Type", "application/json");
@@ -212,7 +220,7 @@ static bool rest_block(HTTPRequest* req,
     if (!ParseHashStr(hashStr, hash))
         return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
 
-    CBlock block;
+    CByteSpan rawBlock;
     CBlockIndex* pblockindex = NULL;
     {
         LOCK(cs_main);
@@ -223,12 +231,22 @@ static bool rest_block(HTTPRequest* req,
         if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not available (pruned data)");
 
-        if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus(pblockindex->nHeight)))
+        if (!ReadRawBlockCached(rawBlock, pblockindex, Params().MessageStart()))
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
     }
 
+    // The stored serialization includes witnesses; it is returned as it is
+    // unless -rpcserialversion asks for blocks without them.
+    const bool fRaw = rf != RF_JSON && RPCSerializationFlags() == 0;
+    CBlock block;
+    if (!fRaw && !DecodeRawBlock(block, rawBlock))
+        return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+
     CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
-    ssBlock << block;
+    if (fRaw)
+        ssBlock.write((const char*)rawBlock.data, rawBlock.size);
+    else if (rf != RF_JSON)
+        ssBlock << block;
 
     switch (rf) {
     case RF_BINARY: {
@@ -520,25 +538,11 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
         }
 
         for (size_t i = 0; i < vOutPoints.size(); i++) {
-            CCoins coins;
-            uint256 hash = vOutPoints[i].hash;
             bool hit = false;
-            if (view.GetCoins(hash, coins)) {
-                if (fCheckMemPool) {
-                    mempool.pruneSpent(hash, coins);
-                }
-
-                if (coins.IsAvailable(vOutPoints[i].n)) {
-                    hit = true;
-                    // Safe to index into vout here because IsAvailable checked if it's off the end of the array, or if
-                    // n is valid but points to an already spent output (IsNull).
-                    CCoin coin;
-                    coin.nTxVer = coins.nVersion;
-                    coin.nHeight = coins.nHeight;
-                    coin.out = coins.vout.at(vOutPoints[i].n);
-                    assert(!coin.out.IsNull());
-                    outs.push_back(coin);
-                }
+            Coin coin;
+            if (view.GetCoin(vOutPoints[i], coin) && !(fCheckMemPool && mempool.isSpent(vOutPoints[i]))) {
+                hit = true;
+                outs.emplace_back(std::move(coin));
             }
 
             hits.push_back(hit);
@@ -582,7 +586,6 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
         UniValue utxos(UniValue::VARR);
         BOOST_FOREACH (const CCoin& coin, outs) {
             UniValue utxo(UniValue::VOBJ);
-            utxo.pushKV("txvers", (int32_t)coin.nTxVer);
             utxo.pushKV("height", (int32_t)coin.nHeight);
             utxo.pushKV("value", ValueFromAmount(coin.out.nValue));
 
@@ -5,6 +5,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "blockchain.h"
+#include "blockfilemap.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "checkpoints.h"
@@ -23,12 +24,15 @@
 #include "hash.h"
 #include "junkcoin.h"
 #include "undo.h"
+#include "utxocommitment.h"
+#include "utxosnapshot.h"
 #include "clientversion.h"
 
 #include <stdint.h>
 
 #include <univalue.h>
 
+#include <boost/filesystem.hpp>
 #include <boost/thread/thread.hpp> // boost::thread::interrupt
 
 #include <mutex>
@@ -115,14 +119,14 @@ UniValue AuxpowToJSON(const CAuxPow& auxpow)
     return result;
 }
 
-UniValue blockheaderToJSON(const CBlockIndex* blockindex)
+UniValue blockheaderToJSON(const CBlockIndex* blockindex, const CChainTip& chain)
 {
     UniValue result(UniValue::VOBJ);
     result.pushKV("hash", blockindex->GetBlockHash().GetHex());
     int confirmations = -1;
     // Only report confirmations if the block is on the main chain
-    if (chainActive.Contains(blockindex))
-        confirmations = chainActive.Height() - blockindex->nHeight + 1;
+    if (chain.Contains(blockindex))
+        confirmations = chain.Height() - blockindex->nHeight + 1;
     result.pushKV("confirmations", confirmations);
     result.pushKV("height", blockindex->nHeight);
     result.pushKV("version", blockindex->nVersion);
@@ -137,7 +141,7 @@ UniValue blockheaderToJSON(const CBlockIndex* blockindex)
 
     if (blockindex->pprev)
         result.pushKV("previousblockhash", blockindex->pprev->GetBlockHash().GetHex());
-    CBlockIndex *pnext = chainActive.Next(blockindex);
+    const CBlockIndex *pnext = chain.Next(blockindex);
     if (pnext)
         result.pushKV("nextblockhash", pnext->GetBlockHash().GetHex());
     return result;
@@ -203,8 +207,7 @@ UniValue getblockcount(const JSONRPCRequest& request)
             + HelpExampleRpc("getblockcount", "")
         );
 
-    LOCK(cs_main);
-    return chainActive.Height();
+    return GetChainTipSnapshot()->Height();
 }
 
 UniValue getbestblockhash(const JSONRPCRequest& request)
@@ -220,8 +223,7 @@ UniValue getbestblockhash(const JSONRPCRequest& request)
             + HelpExampleRpc("getbestblockhash", "")
         );
 
-    LOCK(cs_main);
-    return chainActive.Tip()->GetBlockHash().GetHex();
+    return GetChainTipSnapshot()->Tip()->GetBlockHash().GetHex();
 }
 
 void RPCNotifyBlockChange(bool ibd, const CBlockIndex * pindex)
@@ -663,13 +665,13 @@ UniValue getblockhash(const JSONRPCRequest& request)
             + HelpExampleRpc("getblockhash", "1000")
         );
 
-    LOCK(cs_main);
+    std::shared_ptr<const CChainTip> chain = GetChainTipSnapshot();
 
     int nHeight = request.params[0].get_int();
-    if (nHeight < 0 || nHeight > chainActive.Height())
+    if (nHeight < 0 || nHeight > chain->Height())
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
 
-    CBlockIndex* pblockindex = chainActive[nHeight];
+    const CBlockIndex* pblockindex = (*chain)[nHeight];
     return pblockindex->GetBlockHash().GetHex();
 }
 
@@ -707,8 +709,6 @@ UniValue getblockheader(const JSONRPCRequest& request)
             + HelpExampleRpc("getblockheader", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\"")
         );
 
-    LOCK(cs_main);
-
     std::string strHash = request.params[0].get_str();
     uint256 hash(uint256S(strHash));
 
@@ -716,20 +716,26 @@ UniValue getblockheader(const JSONRPCRequest& request)
     if (request.params.size() > 1)
         fVerbose = request.params[1].get_bool();
 
-    if (mapBlockIndex.count(hash) == 0)
+    std::shared_ptr<const CChainTip> chain = GetChainTipSnapshot();
+    const CBlockIndex* pblockindex = LookupBlockIndex(hash);
+    if (pblockindex == NULL)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
 
-    CBlockIndex* pblockindex = mapBlockIndex[hash];
-
     if (!fVerbose)
     {
+        // Unlike the fields shown below, nStatus and the block position that
+        // GetBlockHeader reads for an auxpow header change under cs_main.
+        LOCK(cs_main);
+        CBlockHeader header;
+        if (!pblockindex->GetBlockHeader(header, Params().GetConsensus(pblockindex->nHeight)))
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block header");
         CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
-        ssBlock << pblockindex->GetBlockHeader(Params().GetConsensus(pblockindex->nHeight));
+        ssBlock << header;
         std::string strHex = HexStr(ssBlock.begin(), ssBlock.end());
         return strHex;
     }
 
-    return blockheaderToJSON(pblockindex);
+    return blockheaderToJSON(pblockindex, *chain);
 }
 
 static CBlock GetBlockChecked(const CBlockIndex* pblockindex)
@@ -852,12 +858,12 @@ UniValue getblockstats(const JSONRPCRequest& request) {
                 "getblockstats \"hash_or_height\" ( stats )\n"
         );
 
-    LOCK(cs_main);
+    std::shared_ptr<const CChainTip> chain = GetChainTipSnapshot();
 
-    CBlockIndex* pindex;
+    const CBlockIndex* pindex;
     if (request.params[0].isNum()) {
       const int height = request.params[0].get_int();
-      const int current_tip = chainActive.Height();
+      const int current_tip = chain->Height();
       if (height < 0) {
           throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Target block height %d is negative", height));
       }
@@ -866,13 +872,10 @@ UniValue getblockstats(const JSONRPCRequest& request) {
           throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Target block height %d after current tip %d", height, current_tip));
       }
 
-      pindex = chainActive[height];
+      pindex = (*chain)[height];
     } else {
       const uint256 hash(ParseHashV(request.params[0], "hash_or_height"));
-      pindex = mapBlockIndex[hash];
-      if (mapBlockIndex.count(hash) == 0) {
-          throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
-      }
+      pindex = LookupBlockIndex(hash);
     }
 
     if(pindex == nullptr) {
@@ -888,8 +891,15 @@ UniValue getblockstats(const JSONRPCRequest& request) {
       }
     }
 
-    const CBlock block = GetBlockChecked(pindex);
-    const CBlockUndo blockUndo = GetUndoChecked(pindex);
+    // Only reading the block and its undo data needs cs_main, which also
+    // keeps them from being pruned in the meantime.
+    CBlock block;
+    CBlockUndo blockUndo;
+    {
+        LOCK(cs_main);
+        block = GetBlockChecked(pindex);
+        blockUndo = GetUndoChecked(pindex);
+    }
 
     const bool do_all = stats.size() == 0; // Calculate everything if nothing selected (default)
     const bool do_mediantxsize = do_all || stats.count("mediantxsize") != 0;
@@ -969,9 +979,10 @@ UniValue getblockstats(const JSONRPCRequest& request) {
       if (loop_inputs) {
           CAmount tx_total_in = 0;
           const auto& txundo = blockUndo.vtxundo.at(i - 1);
-          for (const CTxInUndo& prevoutput: txundo.vprevout) {
+          for (const Coin& coin: txundo.vprevout) {
+              const CTxOut& prevoutput = coin.out;
 
-              tx_total_in += prevoutput.txout.nValue;
+              tx_total_in += prevoutput.nValue;
               utxo_size_inc -= GetSerializeSize(prevoutput, PROTOCOL_VERSION) + PER_UTXO_OVERHEAD;
           }
 
@@ -1116,12 +1127,13 @@ UniValue getblock(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
 
     CBlock block;
+    CByteSpan rawBlock;
     CBlockIndex* pblockindex = mapBlockIndex[hash];
 
     if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
         throw JSONRPCError(RPC_MISC_ERROR, "Block not available (pruned data)");
 
-    if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus(pblockindex->nHeight)))
+    if (!ReadRawBlockCached(rawBlock, pblockindex, Params().MessageStart()))
         // Block not found on disk. This could be because we have the block
         // header in our index but don't have the block (for example if a
         // non-whitelisted node sends us an unrequested long chain of valid
@@ -1129,6 +1141,13 @@ UniValue getblock(const JSONRPCRequest& request)
         // block).
         throw JSONRPCError(RPC_MISC_ERROR, "Block not found on disk");
 
+    // The stored serialization includes witnesses
+    if (verbosity <= 0 && RPCSerializationFlags() == 0)
+        return HexStr(rawBlock.data, rawBlock.data + rawBlock.size);
+
+    if (!DecodeRawBlock(block, rawBlock))
+        throw JSONRPCError(RPC_MISC_ERROR, "Block not found on disk");
+
     if (verbosity <= 0)
     {
         CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
@@ -1153,6 +1172,21 @@ struct CCoinsStats
     CCoinsStats() : nHeight(0), nTransactions(0), nTransactionOutputs(0), nSerializedSize(0), nTotalAmount(0) {}
 };
 
+static void ApplyStats(CCoinsStats &stats, CHashWriter& ss, const uint256& hash, const std::map<uint32_t, Coin>& outputs)
+{
+    assert(!outputs.empty());
+    ss << hash;
+    ss << VARINT(outputs.begin()->second.nHeight * 2 + outputs.begin()->second.fCoinBase);
+    stats.nTransactions++;
+    for (const auto& output : outputs) {
+        ss << VARINT(output.first + 1);
+        ss << output.second.out;
+        stats.nTransactionOutputs++;
+        stats.nTotalAmount += output.second.out.nValue;
+    }
+    ss << VARINT(0);
+}
+
 //! Calculate statistics about the unspent transaction output set
 static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
 {
@@ -1165,32 +1199,29 @@ static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
         stats.nHeight = mapBlockIndex.find(stats.hashBlock)->second->nHeight;
     }
     ss << stats.hashBlock;
-    arith_uint256 nTotalAmount = 0;
+    uint256 prevkey;
+    std::map<uint32_t, Coin> outputs;
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
-        uint256 key;
-        CCoins coins;
-        if (pcursor->GetKey(key) && pcursor->GetValue(coins)) {
-            stats.nTransactions++;
-            ss << key;
-            for (unsigned int i=0; i<coins.vout.size(); i++) {
-                const CTxOut &out = coins.vout[i];
-                if (!out.IsNull()) {
-                    stats.nTransactionOutputs++;
-                    ss << VARINT(i+1);
-                    ss << out;
-                    nTotalAmount += out.nValue;
-                }
+        COutPoint key;
+        Coin coin;
+        if (pcursor->GetKey(key) && pcursor->GetValue(coin)) {
+            if (!outputs.empty() && key.hash != prevkey) {
+                ApplyStats(stats, ss, prevkey, outputs);
+                outputs.clear();
             }
-            stats.nSerializedSize += 32 + pcursor->GetValueSize();
-            ss << VARINT(0);
+            prevkey = key.hash;
+            outputs[key.n] = std::move(coin);
+            stats.nSerializedSize += 32 + 4 + pcursor->GetValueSize();
         } else {
             return error("%s: unable to read value", __func__);
         }
         pcursor->Next();
     }
+    if (!outputs.empty()) {
+        ApplyStats(stats, ss, prevkey, outputs);
+    }
     stats.hashSerialized = ss.GetHash();
-    stats.nTotalAmount = nTotalAmount;
     return true;
 }
 
@@ -1245,28 +1276,75 @@ UniValue pruneblockchain(const JSONRPCRequest& request)
 
 UniValue gettxoutsetinfo(const JSONRPCRequest& request)
 {
-    if (request.fHelp || request.params.size() != 0)
+    if (request.fHelp || request.params.size() > 1)
         throw runtime_error(
-            "gettxoutsetinfo\n"
+            "gettxoutsetinfo ( \"hash_type\" )\n"
             "\nReturns statistics about the unspent transaction output set.\n"
-            "Note this call may take some time.\n"
+            "\nArguments:\n"
+            "1. \"hash_type\"    (string, optional, default=\"muhash\") Which UTXO set hash to return: \"muhash\", which\n"
+            "                  is kept up to date as blocks are connected, or \"hash_serialized_2\", which is computed\n"
+            "                  by walking the whole set. Note that the latter may take some time.\n"
             "\nResult:\n"
             "{\n"
             "  \"height\":n,     (numeric) The current block height (index)\n"
             "  \"bestblock\": \"hex\",   (string) the best block hash hex\n"
-            "  \"transactions\": n,      (numeric) The number of transactions\n"
+            "  \"transactions\": n,      (numeric) The number of transactions (hash_serialized_2 only)\n"
             "  \"txouts\": n,            (numeric) The number of output transactions\n"
-            "  \"bytes_serialized\": n,  (numeric) The serialized size\n"
-            "  \"hash_serialized\": \"hash\",   (string) The serialized hash\n"
+            "  \"bogosize\": n,          (numeric) A database-independent metric for UTXO set size (muhash only)\n"
+            "  \"bytes_serialized\": n,  (numeric) The serialized size (hash_serialized_2 only)\n"
+            "  \"muhash\": \"hash\",      (string) The rolling MuHash of the set (muhash only)\n"
+            "  \"hash_serialized_2\": \"hash\", (string) The serialized hash (hash_serialized_2 only)\n"
             "  \"total_amount\": x.xxx          (numeric) The total amount\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("gettxoutsetinfo", "")
+            + HelpExampleCli("gettxoutsetinfo", "\"hash_serialized_2\"")
             + HelpExampleRpc("gettxoutsetinfo", "")
         );
 
+    std::string strHashType = "muhash";
+    if (request.params.size() > 0)
+        strHashType = request.params[0].get_str();
+
     UniValue ret(UniValue::VOBJ);
 
+    if (strHashType == "muhash") {
+        CUTXOCommitment commitment;
+        int nHeight;
+        {
+            LOCK(cs_main);
+            commitment = utxoCommitment;
+            // Null or unknown while -reindex has not connected the genesis block yet
+            BlockMap::const_iterator it = mapBlockIndex.find(commitment.hashBlock);
+            if (it == mapBlockIndex.end())
+                throw JSONRPCError(RPC_IN_WARMUP, "The UTXO set has no best block yet");
+            nHeight = it->second->nHeight;
+        }
+        // Finalizing takes a modular inversion; remember the result for the
+        // block, which is what callers polling once per block ask for again.
+        static CCriticalSection cs_muhash;
+        static uint256 hashBlockCached, hashCached;
+        uint256 hash;
+        {
+            LOCK(cs_muhash);
+            if (hashBlockCached != commitment.hashBlock || hashCached.IsNull()) {
+                hashCached = commitment.GetHash();
+                hashBlockCached = commitment.hashBlock;
+            }
+            hash = hashCached;
+        }
+        ret.pushKV("height", (int64_t)nHeight);
+        ret.pushKV("bestblock", commitment.hashBlock.GetHex());
+        ret.pushKV("txouts", (int64_t)commitment.nTransactionOutputs);
+        ret.pushKV("bogosize", (int64_t)commitment.nBogoSize);
+        ret.pushKV("muhash", hash.GetHex());
+        ret.pushKV("total_amount", ValueFromAmount(commitment.nTotalAmount));
+        return ret;
+    }
+
+    if (strHashType != "hash_serialized_2")
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown hash_type " + strHashType);
+
     CCoinsStats stats;
     FlushStateToDisk();
     if (GetUTXOStats(pcoinsTip, stats)) {
@@ -1275,7 +1353,7 @@ UniValue gettxoutsetinfo(const JSONRPCRequest& request)
         ret.pushKV("transactions", (int64_t)stats.nTransactions);
         ret.pushKV("txouts", (int64_t)stats.nTransactionOutputs);
         ret.pushKV("bytes_serialized", (int64_t)stats.nSerializedSize);
-        ret.pushKV("hash_serialized", stats.hashSerialized.GetHex());
+        ret.pushKV("hash_serialized_2", stats.hashSerialized.GetHex());
         ret.pushKV("total_amount", ValueFromAmount(stats.nTotalAmount));
     } else {
         throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
@@ -1283,6 +1361,87 @@ UniValue gettxoutsetinfo(const JSONRPCRequest& request)
     return ret;
 }
 
+UniValue dumptxoutset(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw runtime_error(
+            "dumptxoutset \"path\"\n"
+            "\nWrite the unspent transaction output set at the current tip to a file, which\n"
+            "loadtxoutset can bootstrap another node from.\n"
+            "\nArguments:\n"
+            "1. \"path\"         (string, required) The file to write; relative paths are taken relative\n"
+            "                  to the data directory. It must not exist yet.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"coins_written\": n,   (numeric) The number of coins written\n"
+            "  \"base_hash\": \"hash\",  (string) The block the set is at\n"
+            "  \"base_height\": n,     (numeric) The height of that block\n"
+            "  \"muhash\": \"hash\",     (string) The MuHash of the set, as reported by gettxoutsetinfo\n"
+            "  \"path\": \"path\"        (string) The absolute path of the file\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("dumptxoutset", "\"utxo.dat\"")
+            + HelpExampleRpc("dumptxoutset", "\"utxo.dat\"")
+        );
+
+    boost::filesystem::path path = boost::filesystem::absolute(request.params[0].get_str(), GetDataDir());
+    if (boost::filesystem::exists(path))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, path.string() + " already exists");
+
+    CUTXOSnapshotHeader header;
+    std::string strError;
+    if (!DumpUTXOSnapshot(path, header, strError))
+        throw JSONRPCError(RPC_MISC_ERROR, strError);
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("coins_written", (int64_t)header.nTransactionOutputs);
+    ret.pushKV("base_hash", header.hashBlock.GetHex());
+    ret.pushKV("base_height", header.nHeight);
+    ret.pushKV("muhash", header.hashUTXOSet.GetHex());
+    ret.pushKV("path", path.string());
+    return ret;
+}
+
+UniValue loadtxoutset(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw runtime_error(
+            "loadtxoutset \"path\"\n"
+            "\nLoad an unspent transaction output set written by dumptxoutset, and continue\n"
+            "the chain from the block it is at. Only possible before any block beyond the\n"
+            "genesis block is connected, and once the headers up to that block are synced.\n"
+            "The blocks before it are not downloaded or validated; compare the muhash with\n"
+            "that of a node you trust.\n"
+            "\nArguments:\n"
+            "1. \"path\"         (string, required) The file to load; relative paths are taken relative\n"
+            "                  to the data directory\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"coins_loaded\": n,    (numeric) The number of coins loaded\n"
+            "  \"base_hash\": \"hash\",  (string) The block the set is at, now the tip\n"
+            "  \"base_height\": n,     (numeric) The height of that block\n"
+            "  \"muhash\": \"hash\"      (string) The MuHash of the set\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("loadtxoutset", "\"utxo.dat\"")
+            + HelpExampleRpc("loadtxoutset", "\"utxo.dat\"")
+        );
+
+    boost::filesystem::path path = boost::filesystem::absolute(request.params[0].get_str(), GetDataDir());
+
+    CUTXOSnapshotHeader header;
+    std::string strError;
+    if (!LoadUTXOSnapshot(path, header, strError))
+        throw JSONRPCError(RPC_MISC_ERROR, strError);
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("coins_loaded", (int64_t)header.nTransactionOutputs);
+    ret.pushKV("base_hash", header.hashBlock.GetHex());
+    ret.pushKV("base_height", header.nHeight);
+    ret.pushKV("muhash", header.hashUTXOSet.GetHex());
+    return ret;
+}
+
 UniValue gettxout(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() < 2 || request.params.size() > 3)
@@ -1308,7 +1467,6 @@ UniValue gettxout(const JSONRPCRequest& request)
             "        ,...\n"
             "     ]\n"
             "  },\n"
-            "  \"version\" : n,            (numeric) The version\n"
             "  \"coinbase\" : true|false   (boolean) Coinbase or not\n"
             "}\n"
 
@@ -1332,33 +1490,31 @@ UniValue gettxout(const JSONRPCRequest& request)
     if (request.params.size() > 2)
         fMempool = request.params[2].get_bool();
 
-    CCoins coins;
+    COutPoint out(hash, n);
+
+    Coin coin;
     if (fMempool) {
         LOCK(mempool.cs);
         CCoinsViewMemPool view(pcoinsTip, mempool);
-        if (!view.GetCoins(hash, coins))
+        if (!view.GetCoin(out, coin) || mempool.isSpent(out)) // TODO: filtering spent coins should be done by the CCoinsViewMemPool
             return NullUniValue;
-        mempool.pruneSpent(hash, coins); // TODO: this should be done by the CCoinsViewMemPool
     } else {
-        if (!pcoinsTip->GetCoins(hash, coins))
+        if (!pcoinsTip->GetCoin(out, coin))
             return NullUniValue;
     }
-    if (n<0 || (unsigned int)n>=coins.vout.size() || coins.vout[n].IsNull())
-        return NullUniValue;
 
     BlockMap::iterator it = mapBlockIndex.find(pcoinsTip->GetBestBlock());
     CBlockIndex *pindex = it->second;
     ret.pushKV("bestblock", pindex->GetBlockHash().GetHex());
-    if ((unsigned int)coins.nHeight == MEMPOOL_HEIGHT)
+    if (coin.nHeight == MEMPOOL_HEIGHT)
         ret.pushKV("confirmations", 0);
     else
-        ret.pushKV("confirmations", pindex->nHeight - coins.nHeight + 1);
-    ret.pushKV("value", ValueFromAmount(coins.vout[n].nValue));
+        ret.pushKV("confirmations", (int64_t)(pindex->nHeight - coin.nHeight + 1));
+    ret.pushKV("value", ValueFromAmount(coin.out.nValue));
     UniValue o(UniValue::VOBJ);
-    ScriptPubKeyToJSON(coins.vout[n].scriptPubKey, o, true);
+    ScriptPubKeyToJSON(coin.out.scriptPubKey, o, true);
     ret.pushKV("scriptPubKey", o);
-    ret.pushKV("version", coins.nVersion);
-    ret.pushKV("coinbase", coins.fCoinBase);
+    ret.pushKV("coinbase", (bool)coin.fCoinBase);
 
     return ret;
 }
@@ -1835,7 +1991,9 @@ static const CRPCCommand commands[] =
     { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         true,  {} },
     { "blockchain",         "getrawmempool",          &getrawmempool,          true,  {"verbose"} },
     { "blockchain",         "gettxout",               &gettxout,               true,  {"txid","n","include_mempool"} },
-    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true,  {} },
+    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true,  {"hash_type"} },
+    { "blockchain",         "dumptxoutset",           &dumptxoutset,           true,  {"path"} },
+    { "blockchain",         "loadtxoutset",           &loadtxoutset,           false, {"path"} },
     { "blockchain",         "pruneblockchain",        &pruneblockchain,        true,  {"height"} },
     { "blockchain",         "verifychain",            &verifychain,            true,  {"checklevel","nblocks"} },
 
@@ -11,6 +11,7 @@
 #include "net.h"
 #include "netbase.h"
 #include "rpc/server.h"
+#include "sync.h"
 #include "timedata.h"
 #include "util.h"
 #include "utilstrencodings.h"
@@ -468,6 +469,42 @@ static UniValue RPCLockedMemoryInfo()
     return obj;
 }
 
+static UniValue RPCAuxpowCacheInfo()
+{
+    CLRUCache<const CBlockIndex*>::Stats stats = auxpowCache.GetStats();
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("entries", uint64_t(stats.nEntries));
+    obj.pushKV("usage", uint64_t(stats.nUsage));
+    obj.pushKV("limit", uint64_t(stats.nMaxUsage));
+    obj.pushKV("hits", stats.nHits);
+    obj.pushKV("misses", stats.nMisses);
+    return obj;
+}
+
+static UniValue RPCBlockCacheInfo()
+{
+    CLRUCache<uint256, BlockHasher>::Stats stats = blockCache.GetStats();
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("entries", uint64_t(stats.nEntries));
+    obj.pushKV("usage", uint64_t(stats.nUsage));
+    obj.pushKV("limit", uint64_t(stats.nMaxUsage));
+    obj.pushKV("hits", stats.nHits);
+    obj.pushKV("misses", stats.nMisses);
+    return obj;
+}
+
+static UniValue RPCCoinsCacheInfo()
+{
+    LOCK(cs_main);
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("entries", uint64_t(pcoinsTip->GetCacheSize()));
+    obj.pushKV("usage", uint64_t(pcoinsTip->DynamicMemoryUsage()));
+    obj.pushKV("limit", uint64_t(nCoinCacheUsage));
+    obj.pushKV("hits", pcoinsTip->GetHits());
+    obj.pushKV("misses", pcoinsTip->GetMisses());
+    return obj;
+}
+
 UniValue getmemoryinfo(const JSONRPCRequest& request)
 {
     /* Please, avoid using the word "pool" here in the RPC interface or help,
@@ -486,6 +523,27 @@ UniValue getmemoryinfo(const JSONRPCRequest& request)
             "    \"locked\": xxxxxx,       (numeric) Amount of bytes that succeeded locking. If this number is smaller than total, locking pages failed at some point and key data could be swapped to disk.\n"
             "    \"chunks_used\": xxxxx,   (numeric) Number allocated chunks\n"
             "    \"chunks_free\": xxxxx,   (numeric) Number unused chunks\n"
+            "  },\n"
+            "  \"auxpowcache\": {          (json object) Auxpow data cached for serving block headers\n"
+            "    \"entries\": xxxxx,       (numeric) Number of cached headers\n"
+            "    \"usage\": xxxxx,         (numeric) Memory used in bytes\n"
+            "    \"limit\": xxxxx,         (numeric) Maximum memory in bytes (-auxpowcache)\n"
+            "    \"hits\": xxxxx,          (numeric) Number of headers served from the cache\n"
+            "    \"misses\": xxxxx,        (numeric) Number of headers read from disk\n"
+            "  },\n"
+            "  \"blockcache\": {           (json object) Recently served blocks\n"
+            "    \"entries\": xxxxx,       (numeric) Number of cached blocks\n"
+            "    \"usage\": xxxxx,         (numeric) Memory used in bytes\n"
+            "    \"limit\": xxxxx,         (numeric) Maximum memory in bytes (-blockcache)\n"
+            "    \"hits\": xxxxx,          (numeric) Number of blocks served from the cache\n"
+            "    \"misses\": xxxxx,        (numeric) Number of blocks read from disk\n"
+            "  },\n"
+            "  \"coinscache\": {           (json object) In-memory UTXO set cache\n"
+            "    \"entries\": xxxxx,       (numeric) Number of cached coins\n"
+            "    \"usage\": xxxxx,         (numeric) Memory used in bytes\n"
+            "    \"limit\": xxxxx,         (numeric) Memory available to the cache in bytes, not counting unused mempool space\n"
+            "    \"hits\": xxxxx,          (numeric) Number of lookups answered from the cache\n"
+            "    \"misses\": xxxxx,        (numeric) Number of lookups that went to the database\n"
             "  }\n"
             "}\n"
             "\nExamples:\n"
@@ -494,6 +552,142 @@ UniValue getmemoryinfo(const JSONRPCRequest& request)
         );
     UniValue obj(UniValue::VOBJ);
     obj.pushKV("locked", RPCLockedMemoryInfo());
+    obj.pushKV("auxpowcache", RPCAuxpowCacheInfo());
+    obj.pushKV("blockcache", RPCBlockCacheInfo());
+    obj.pushKV("coinscache", RPCCoinsCacheInfo());
+    return obj;
+}
+
+/** Totals of the lock statistics of several sites */
+struct CLockTotals
+{
+    uint64_t nAcquired;
+    uint64_t nContended;
+    uint64_t nWaitMicros;
+    uint64_t nHoldMicros;
+    uint64_t vWaitHistogram[LOCK_STATS_BUCKETS];
+    uint64_t vHoldHistogram[LOCK_STATS_BUCKETS];
+
+    CLockTotals() : nAcquired(0), nContended(0), nWaitMicros(0), nHoldMicros(0)
+    {
+        std::fill(vWaitHistogram, vWaitHistogram + LOCK_STATS_BUCKETS, 0);
+        std::fill(vHoldHistogram, vHoldHistogram + LOCK_STATS_BUCKETS, 0);
+    }
+
+    void Add(const CLockSite& site)
+    {
+        nAcquired += site.nAcquired.load(std::memory_order_relaxed);
+        nContended += site.nContended.load(std::memory_order_relaxed);
+        nWaitMicros += site.nWaitMicros.load(std::memory_order_relaxed);
+        nHoldMicros += site.nHoldMicros.load(std::memory_order_relaxed);
+        for (int i = 0; i < LOCK_STATS_BUCKETS; i++) {
+            vWaitHistogram[i] += site.vWaitHistogram[i].load(std::memory_order_relaxed);
+            vHoldHistogram[i] += site.vHoldHistogram[i].load(std::memory_order_relaxed);
+        }
+    }
+};
+
+static UniValue LockHistogramToJSON(const uint64_t* vHistogram)
+{
+    // Leave out the empty buckets at the end
+    int nBuckets = LOCK_STATS_BUCKETS;
+    while (nBuckets > 0 && vHistogram[nBuckets - 1] == 0)
+        nBuckets--;
+    UniValue arr(UniValue::VARR);
+    for (int i = 0; i < nBuckets; i++)
+        arr.push_back(vHistogram[i]);
+    return arr;
+}
+
+static void LockTotalsToJSON(const CLockTotals& totals, UniValue& obj)
+{
+    obj.pushKV("acquired", totals.nAcquired);
+    obj.pushKV("contended", totals.nContended);
+    obj.pushKV("wait_us", totals.nWaitMicros);
+    obj.pushKV("hold_us", totals.nHoldMicros);
+    obj.pushKV("wait_histogram", LockHistogramToJSON(totals.vWaitHistogram));
+    obj.pushKV("hold_histogram", LockHistogramToJSON(totals.vHoldHistogram));
+}
+
+template <typename T>
+static bool CompareLockTotalsByWait(const std::pair<T, CLockTotals>& a, const std::pair<T, CLockTotals>& b)
+{
+    return a.second.nWaitMicros > b.second.nWaitMicros;
+}
+
+UniValue getlockstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw runtime_error(
+            "getlockstats\n"
+            "Returns how long threads waited for and held each lock, by lock and by the place it\n"
+            "is taken, since startup. Only recorded with -lockstats. Locks and places are sorted\n"
+            "by the total time waited for them.\n"
+            "Bucket 0 of a histogram counts times below 1 microsecond, bucket i > 0 times from 2^(i-1)\n"
+            "up to 2^i microseconds. Empty buckets at the end are left out.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"enabled\": true|false,    (boolean) Whether lock statistics are being recorded (-lockstats)\n"
+            "  \"locks\": [\n"
+            "    {\n"
+            "      \"name\": \"xxxx\",         (string) The lock, as written where it is taken\n"
+            "      \"acquired\": xxxxx,      (numeric) Number of times it was taken\n"
+            "      \"contended\": xxxxx,     (numeric) Number of times it was held by another thread\n"
+            "      \"wait_us\": xxxxx,       (numeric) Total time spent waiting for it in microseconds\n"
+            "      \"hold_us\": xxxxx,       (numeric) Total time it was held in microseconds\n"
+            "      \"wait_histogram\": [ n, ... ], (json array) Number of waits by duration\n"
+            "      \"hold_histogram\": [ n, ... ], (json array) Number of holds by duration\n"
+            "      \"sites\": [             (json array) The same, for each place the lock is taken\n"
+            "        {\n"
+            "          \"file\": \"xxxx\",     (string) Source file\n"
+            "          \"line\": n,          (numeric) Source line\n"
+            "          ...\n"
+            "        }, ...\n"
+            "      ]\n"
+            "    }, ...\n"
+            "  ]\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getlockstats", "")
+            + HelpExampleRpc("getlockstats", "")
+        );
+
+    std::map<std::string, CLockTotals> mapLocks;
+    std::map<std::string, std::vector<const CLockSite*> > mapSites;
+    for (const CLockSite* psite : GetLockSites()) {
+        mapLocks[psite->pszName].Add(*psite);
+        mapSites[psite->pszName].push_back(psite);
+    }
+
+    std::vector<std::pair<std::string, CLockTotals> > vLocks(mapLocks.begin(), mapLocks.end());
+    std::sort(vLocks.begin(), vLocks.end(), CompareLockTotalsByWait<std::string>);
+    UniValue locks(UniValue::VARR);
+    for (const std::pair<std::string, CLockTotals>& lock : vLocks) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("name", lock.first);
+        LockTotalsToJSON(lock.second, obj);
+
+        std::vector<std::pair<const CLockSite*, CLockTotals> > vSites;
+        for (const CLockSite* psite : mapSites[lock.first]) {
+            vSites.push_back(std::make_pair(psite, CLockTotals()));
+            vSites.back().second.Add(*psite);
+        }
+        std::sort(vSites.begin(), vSites.end(), CompareLockTotalsByWait<const CLockSite*>);
+        UniValue sites(UniValue::VARR);
+        for (const std::pair<const CLockSite*, CLockTotals>& site : vSites) {
+            UniValue objSite(UniValue::VOBJ);
+            objSite.pushKV("file", site.first->pszFile);
+            objSite.pushKV("line", site.first->nLine);
+            LockTotalsToJSON(site.second, objSite);
+            sites.push_back(objSite);
+        }
+        obj.pushKV("sites", sites);
+        locks.push_back(obj);
+    }
+
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("enabled", fLockStats.load());
+    obj.pushKV("locks", locks);
     return obj;
 }
 
@@ -515,6 +709,7 @@ static const CRPCCommand commands[] =
   //  --------------------- ------------------------  -----------------------  ----------
     { "control",            "getinfo",                &getinfo,                true,  {} }, /* uses wallet if enabled */
     { "control",            "getmemoryinfo",          &getmemoryinfo,          true,  {} },
+    { "control",            "getlockstats",           &getlockstats,           true,  {} },
     { "util",               "validateaddress",        &validateaddress,        true,  {"address"} }, /* uses wallet if enabled */
     { "util",               "createmultisig",         &createmultisig,         true,  {"nrequired","keys"} },
     { "util",               "verifymessage",          &verifymessage,          true,  {"address","signature","message"} },
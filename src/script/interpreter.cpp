@@ -11,6 +11,7 @@
 #include "crypto/sha256.h"
 #include "pubkey.h"
 #include "script/script.h"
+#include "streams.h"
 #include "uint256.h"
 
 using namespace std;
@@ -1144,6 +1145,26 @@ public:
     }
 };
 
+/** Minimal stream that feeds serialized data into a CSHA256. */
+class CSHA256Writer
+{
+private:
+    CSHA256& ctx;
+
+public:
+    CSHA256Writer(CSHA256& ctxIn) : ctx(ctxIn) {}
+
+    void write(const char *pch, size_t size) {
+        ctx.Write((const unsigned char*)pch, size);
+    }
+
+    int GetType() const { return SER_GETHASH; }
+    int GetVersion() const { return 0; }
+};
+
+/** Size of an input with a blanked scriptSig: prevout, empty script, nSequence. */
+static const size_t LEGACY_INPUT_SIZE = 36 + 1 + 4;
+
 uint256 GetPrevoutHash(const CTransaction& txTo) {
     CHashWriter ss(SER_GETHASH, 0);
     for (unsigned int n = 0; n < txTo.vin.size(); n++) {
@@ -1175,6 +1196,27 @@ PrecomputedTransactionData::PrecomputedTransactionData(const CTransaction& txTo)
     hashPrevouts = GetPrevoutHash(txTo);
     hashSequence = GetSequenceHash(txTo);
     hashOutputs = GetOutputsHash(txTo);
+
+    // Everything a legacy SIGHASH_ALL signature hash covers except the
+    // scriptCode of the input being signed, so that each input only hashes
+    // its own part instead of reserializing the whole transaction.
+    CVectorWriter inputs(SER_GETHASH, 0, vLegacyInputs, 0);
+    for (unsigned int n = 0; n < txTo.vin.size(); n++) {
+        inputs << txTo.vin[n].prevout << CScriptBase() << txTo.vin[n].nSequence;
+    }
+    assert(vLegacyInputs.size() == LEGACY_INPUT_SIZE * txTo.vin.size());
+    CVectorWriter tail(SER_GETHASH, 0, vLegacyTail, 0);
+    tail << txTo.vout << txTo.nLockTime;
+
+    CSHA256 ctx;
+    CSHA256Writer prefix(ctx);
+    ::Serialize(prefix, txTo.nVersion);
+    ::WriteCompactSize(prefix, txTo.vin.size());
+    vLegacyMidstates.reserve(txTo.vin.size());
+    for (unsigned int n = 0; n < txTo.vin.size(); n++) {
+        vLegacyMidstates.push_back(ctx);
+        ctx.Write(&vLegacyInputs[LEGACY_INPUT_SIZE * n], LEGACY_INPUT_SIZE);
+    }
 }
 
 uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType, const CAmount& amount, SigVersion sigversion, const PrecomputedTransactionData* cache)
@@ -1241,6 +1283,25 @@ uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsig
     // Wrapper to serialize only the necessary parts of the transaction being signed
     CTransactionSignatureSerializer txTmp(txTo, scriptCode, nIn, nHashType);
 
+    if (cache && cache->vLegacyMidstates.size() == txTo.vin.size() &&
+        !(nHashType & SIGHASH_ANYONECANPAY) && (nHashType & 0x1f) != SIGHASH_SINGLE && (nHashType & 0x1f) != SIGHASH_NONE) {
+        // Resume from the midstate before this input and substitute the
+        // scriptCode for its blanked scriptSig.
+        const unsigned char* input = &cache->vLegacyInputs[LEGACY_INPUT_SIZE * nIn];
+        CSHA256 ctx = cache->vLegacyMidstates[nIn];
+        CSHA256Writer s(ctx);
+        ctx.Write(input, 36);
+        txTmp.SerializeScriptCode(s);
+        ctx.Write(input + 37, cache->vLegacyInputs.size() - LEGACY_INPUT_SIZE * nIn - 37);
+        ctx.Write(cache->vLegacyTail.data(), cache->vLegacyTail.size());
+        ::Serialize(s, nHashType);
+
+        uint256 hash;
+        ctx.Finalize(hash.begin());
+        CSHA256().Write(hash.begin(), CSHA256::OUTPUT_SIZE).Finalize(hash.begin());
+        return hash;
+    }
+
     // Serialize and hash
     CHashWriter ss(SER_GETHASH, 0);
     ss << txTmp << nHashType;
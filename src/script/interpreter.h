@@ -7,6 +7,7 @@
 #define BITCOIN_SCRIPT_INTERPRETER_H
 
 #include "script_error.h"
+#include "crypto/sha256.h"
 #include "primitives/transaction.h"
 
 #include <vector>
@@ -114,6 +115,14 @@ struct PrecomputedTransactionData
 {
     uint256 hashPrevouts, hashSequence, hashOutputs;
 
+    /**
+     * Legacy (SIGVERSION_BASE) SIGHASH_ALL serialization, shared by all inputs:
+     * every input with a blanked scriptSig, the outputs with nLockTime, and
+     * the SHA256 midstate after nVersion and the inputs before input i.
+     */
+    std::vector<unsigned char> vLegacyInputs, vLegacyTail;
+    std::vector<CSHA256> vLegacyMidstates;
+
     PrecomputedTransactionData(const CTransaction& tx);
 };
 
@@ -138,6 +138,47 @@ private:
     size_t nPos;
 };
 
+/* Minimal stream for deserializing from a range of bytes that is owned
+ * elsewhere, such as a memory-mapped file, without copying it first.
+ */
+class CSpanReader
+{
+public:
+    CSpanReader(int nTypeIn, int nVersionIn, const unsigned char* pbeginIn, size_t nSizeIn) :
+        nType(nTypeIn), nVersion(nVersionIn), pcur(pbeginIn), pend(pbeginIn + nSizeIn) {}
+
+    void read(char* pch, size_t nSize)
+    {
+        if (nSize > size())
+            throw std::ios_base::failure("CSpanReader::read(): end of data");
+        memcpy(pch, pcur, nSize);
+        pcur += nSize;
+    }
+    void ignore(size_t nSize)
+    {
+        if (nSize > size())
+            throw std::ios_base::failure("CSpanReader::ignore(): end of data");
+        pcur += nSize;
+    }
+    template<typename T>
+    CSpanReader& operator>>(T& obj)
+    {
+        // Unserialize from this stream
+        ::Unserialize(*this, obj);
+        return (*this);
+    }
+    int GetVersion() const { return nVersion; }
+    int GetType() const { return nType; }
+    size_t size() const { return pend - pcur; }
+    bool empty() const { return pcur == pend; }
+
+private:
+    const int nType;
+    const int nVersion;
+    const unsigned char* pcur;
+    const unsigned char* pend;
+};
+
 /** Double ended buffer combining vector and stream-like interfaces.
  *
  * >> and << read and write unformatted data using the above serialization templates.
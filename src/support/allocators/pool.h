@@ -0,0 +1,225 @@
+// Copyright (c) 2026 The Junkcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+#define BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+
+#include <assert.h>
+#include <stddef.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Memory resource that hands out small blocks from large chunks.
+ *
+ * Node based containers allocate one node per element, and every one of
+ * these allocations costs malloc bookkeeping on top of the node itself.
+ * Here blocks of up to MAX_BLOCK_SIZE_BYTES are carved out of chunks and
+ * kept in a free list per block size when they are given back, so they are
+ * reused by the next allocation of that size. Larger (or more strictly
+ * aligned) allocations go to operator new.
+ *
+ * The first chunk is small and every next one twice as large, up to
+ * MaxChunkSizeBytes(), so that a container with a few elements does not
+ * hold a large chunk. Chunks are only freed when the resource is
+ * destroyed. Not thread safe.
+ */
+template <size_t MAX_BLOCK_SIZE_BYTES, size_t ALIGN_BYTES>
+class PoolResource
+{
+private:
+    struct ListNode
+    {
+        ListNode* pnext;
+    };
+
+    //! Block sizes are multiples of this, so every block can hold a ListNode
+    static const size_t ELEM_ALIGN_BYTES = ALIGN_BYTES > sizeof(ListNode) ? ALIGN_BYTES : sizeof(ListNode);
+    static_assert((ELEM_ALIGN_BYTES & (ELEM_ALIGN_BYTES - 1)) == 0, "ELEM_ALIGN_BYTES must be a power of two");
+    static_assert(ELEM_ALIGN_BYTES <= alignof(std::max_align_t), "Chunks are only aligned to max_align_t");
+    static const size_t NUM_SIZES = (MAX_BLOCK_SIZE_BYTES + ELEM_ALIGN_BYTES - 1) / ELEM_ALIGN_BYTES + 1;
+
+    const size_t nMaxChunkSizeBytes;
+    //! Size of the chunk that is allocated next
+    size_t nNextChunkSizeBytes;
+    size_t nNewestChunkSizeBytes;
+    size_t nAllocatedBytes;
+    std::vector<char*> vChunks;
+    //! Free blocks, indexed by their size in units of ELEM_ALIGN_BYTES
+    ListNode* vFreeLists[NUM_SIZES];
+    //! The part of the newest chunk that has not been handed out yet
+    char* pAvailableBegin;
+    char* pAvailableEnd;
+
+    static size_t NumElemAlign(size_t bytes)
+    {
+        return (bytes + ELEM_ALIGN_BYTES - 1) / ELEM_ALIGN_BYTES + (bytes == 0);
+    }
+
+    static bool IsPooled(size_t bytes, size_t alignment)
+    {
+        return bytes <= MAX_BLOCK_SIZE_BYTES && alignment <= ELEM_ALIGN_BYTES;
+    }
+
+    void PushFree(void* p, size_t nElems)
+    {
+        ListNode* node = new (p) ListNode;
+        node->pnext = vFreeLists[nElems];
+        vFreeLists[nElems] = node;
+    }
+
+    void AllocateChunk()
+    {
+        // Whatever is left of the current chunk is smaller than the block
+        // that did not fit, so it goes to the free list of its own size.
+        size_t nRemaining = pAvailableEnd - pAvailableBegin;
+        if (nRemaining > 0)
+            PushFree(pAvailableBegin, nRemaining / ELEM_ALIGN_BYTES);
+        pAvailableBegin = static_cast<char*>(::operator new(nNextChunkSizeBytes));
+        pAvailableEnd = pAvailableBegin + nNextChunkSizeBytes;
+        vChunks.push_back(pAvailableBegin);
+        nAllocatedBytes += nNextChunkSizeBytes;
+        nNewestChunkSizeBytes = nNextChunkSizeBytes;
+        nNextChunkSizeBytes = std::min(2 * nNextChunkSizeBytes, nMaxChunkSizeBytes);
+    }
+
+    static size_t RoundChunkSize(size_t bytes)
+    {
+        // A chunk has to hold at least one block of every size.
+        return std::max(bytes / ELEM_ALIGN_BYTES * ELEM_ALIGN_BYTES, NUM_SIZES * ELEM_ALIGN_BYTES);
+    }
+
+public:
+    explicit PoolResource(size_t nMaxChunkSizeBytesIn = 64 * 1024, size_t nFirstChunkSizeBytesIn = 1024) :
+        nMaxChunkSizeBytes(RoundChunkSize(nMaxChunkSizeBytesIn)),
+        nNextChunkSizeBytes(std::min(RoundChunkSize(nFirstChunkSizeBytesIn), nMaxChunkSizeBytes)),
+        nNewestChunkSizeBytes(0), nAllocatedBytes(0), pAvailableBegin(NULL), pAvailableEnd(NULL)
+    {
+        for (size_t i = 0; i < NUM_SIZES; i++)
+            vFreeLists[i] = NULL;
+    }
+
+    ~PoolResource()
+    {
+        for (size_t i = 0; i < vChunks.size(); i++)
+            ::operator delete(vChunks[i]);
+    }
+
+    PoolResource(const PoolResource&) = delete;
+    PoolResource& operator=(const PoolResource&) = delete;
+
+    void* Allocate(size_t bytes, size_t alignment)
+    {
+        if (!IsPooled(bytes, alignment))
+            return ::operator new(bytes);
+        size_t nElems = NumElemAlign(bytes);
+        if (vFreeLists[nElems] != NULL) {
+            ListNode* node = vFreeLists[nElems];
+            vFreeLists[nElems] = node->pnext;
+            return node;
+        }
+        if ((size_t)(pAvailableEnd - pAvailableBegin) < nElems * ELEM_ALIGN_BYTES)
+            AllocateChunk();
+        void* p = pAvailableBegin;
+        pAvailableBegin += nElems * ELEM_ALIGN_BYTES;
+        return p;
+    }
+
+    void Deallocate(void* p, size_t bytes, size_t alignment)
+    {
+        if (!IsPooled(bytes, alignment)) {
+            ::operator delete(p);
+            return;
+        }
+        PushFree(p, NumElemAlign(bytes));
+    }
+
+    size_t MaxChunkSizeBytes() const { return nMaxChunkSizeBytes; }
+    //! Size of the chunk blocks are currently carved from, 0 before the first
+    size_t NewestChunkSizeBytes() const { return nNewestChunkSizeBytes; }
+    //! Total size of the chunks
+    size_t AllocatedBytes() const { return nAllocatedBytes; }
+    size_t NumAllocatedChunks() const { return vChunks.size(); }
+};
+
+/**
+ * Allocator that takes its memory from a PoolResource.
+ *
+ * A default constructed allocator creates a new resource, and copies (and
+ * rebinds) share it, so every container gets a pool of its own. Swapping or
+ * assigning containers takes the pool along with the elements, and copying
+ * a container gives the copy a new pool. A pool therefore only ever serves
+ * one container, and is freed together with it.
+ */
+template <class T, size_t MAX_BLOCK_SIZE_BYTES, size_t ALIGN_BYTES = alignof(T)>
+class PoolAllocator
+{
+public:
+    typedef PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> Resource;
+
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    template <typename U>
+    struct rebind {
+        typedef PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> other;
+    };
+
+    PoolAllocator() : resource(std::make_shared<Resource>()) {}
+
+    // Not movable: a moved-from allocator would have no resource left.
+    PoolAllocator(const PoolAllocator& other) : resource(other.resource) {}
+    PoolAllocator& operator=(const PoolAllocator& other) = default;
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& other) : resource(other.GetResourcePtr()) {}
+
+    T* allocate(size_t n)
+    {
+        return static_cast<T*>(resource->Allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, size_t n)
+    {
+        resource->Deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    PoolAllocator select_on_container_copy_construction() const
+    {
+        return PoolAllocator();
+    }
+
+    const std::shared_ptr<Resource>& GetResourcePtr() const { return resource; }
+    const Resource& GetResource() const { return *resource; }
+
+private:
+    std::shared_ptr<Resource> resource;
+};
+
+template <class T, class U, size_t MAX_BLOCK_SIZE_BYTES, size_t ALIGN_BYTES>
+bool operator==(const PoolAllocator<T, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& a, const PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& b)
+{
+    return a.GetResourcePtr() == b.GetResourcePtr();
+}
+
+template <class T, class U, size_t MAX_BLOCK_SIZE_BYTES, size_t ALIGN_BYTES>
+bool operator!=(const PoolAllocator<T, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& a, const PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& b)
+{
+    return !(a == b);
+}
+
+#endif // BITCOIN_SUPPORT_ALLOCATORS_POOL_H
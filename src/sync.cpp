@@ -8,10 +8,100 @@
 #include "utilstrencodings.h"
 
 #include <stdio.h>
+#include <string.h>
+
+#include <chrono>
 
 #include <boost/foreach.hpp>
 #include <boost/thread.hpp>
 
+std::atomic<bool> fLockStats(DEFAULT_LOCK_STATS);
+
+CLockSite::CLockSite(const char* pszNameIn, const char* pszFileIn, int nLineIn) :
+    pszName(pszNameIn), pszFile(pszFileIn), nLine(nLineIn), nAcquired(0), nContended(0), nWaitMicros(0), nHoldMicros(0)
+{
+    for (int i = 0; i < LOCK_STATS_BUCKETS; i++) {
+        vWaitHistogram[i] = 0;
+        vHoldHistogram[i] = 0;
+    }
+}
+
+/**
+ * Open addressing table of the sites seen so far, keyed by their file names
+ * and lines. The names are compared by contents, as the same __FILE__ can be
+ * a different string literal in each translation unit. Sites are never
+ * removed, so lookups need no lock; adding one takes cs_lockSites.
+ */
+static const size_t LOCK_SITES_SIZE = 4096;
+static std::atomic<CLockSite*> vLockSites[LOCK_SITES_SIZE];
+static boost::mutex cs_lockSites;
+
+CLockSite* GetLockSite(const char* pszName, const char* pszFile, int nLine)
+{
+    size_t nHash = nLine;
+    for (const char* p = pszFile; *p; p++)
+        nHash = nHash * 31 + (unsigned char)*p;
+    for (size_t i = 0; i < LOCK_SITES_SIZE; i++) {
+        std::atomic<CLockSite*>& slot = vLockSites[(nHash + i) % LOCK_SITES_SIZE];
+        CLockSite* psite = slot.load(std::memory_order_acquire);
+        if (psite == NULL) {
+            boost::unique_lock<boost::mutex> lock(cs_lockSites);
+            psite = slot.load(std::memory_order_relaxed);
+            if (psite == NULL) {
+                psite = new CLockSite(pszName, pszFile, nLine);
+                slot.store(psite, std::memory_order_release);
+                return psite;
+            }
+        }
+        if (psite->nLine == nLine && (psite->pszFile == pszFile || strcmp(psite->pszFile, pszFile) == 0))
+            return psite;
+    }
+    return NULL;
+}
+
+int64_t GetLockStatsMicros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int LockStatsBucket(int64_t nMicros)
+{
+    int nBucket = 0;
+    while (nMicros > 0 && nBucket < LOCK_STATS_BUCKETS - 1) {
+        nMicros >>= 1;
+        nBucket++;
+    }
+    return nBucket;
+}
+
+void RecordLockWait(CLockSite* psite, bool fContended, int64_t nMicros)
+{
+    if (!psite)
+        return;
+    psite->nAcquired.fetch_add(1, std::memory_order_relaxed);
+    if (fContended)
+        psite->nContended.fetch_add(1, std::memory_order_relaxed);
+    psite->nWaitMicros.fetch_add(nMicros, std::memory_order_relaxed);
+    psite->vWaitHistogram[LockStatsBucket(nMicros)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void RecordLockHold(CLockSite* psite, int64_t nMicros)
+{
+    psite->nHoldMicros.fetch_add(nMicros, std::memory_order_relaxed);
+    psite->vHoldHistogram[LockStatsBucket(nMicros)].fetch_add(1, std::memory_order_relaxed);
+}
+
+std::vector<const CLockSite*> GetLockSites()
+{
+    std::vector<const CLockSite*> vSites;
+    for (size_t i = 0; i < LOCK_SITES_SIZE; i++) {
+        const CLockSite* psite = vLockSites[i].load(std::memory_order_acquire);
+        if (psite)
+            vSites.push_back(psite);
+    }
+    return vSites;
+}
+
 #ifdef DEBUG_LOCKCONTENTION
 void PrintLockContention(const char* pszName, const char* pszFile, int nLine)
 {
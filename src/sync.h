@@ -8,6 +8,10 @@
 
 #include "threadsafety.h"
 
+#include <atomic>
+#include <stdint.h>
+#include <vector>
+
 #include <boost/thread/condition_variable.hpp>
 #include <boost/thread/locks.hpp>
 #include <boost/thread/mutex.hpp>
@@ -108,16 +112,108 @@ typedef boost::condition_variable CConditionVariable;
 void PrintLockContention(const char* pszName, const char* pszFile, int nLine);
 #endif
 
+/** Default for -lockstats */
+static const bool DEFAULT_LOCK_STATS = false;
+
+/** Number of buckets of the lock wait and hold time histograms */
+static const int LOCK_STATS_BUCKETS = 24;
+
+/**
+ * Contention statistics of one place a lock is taken, identified by the
+ * source file and line. Bucket 0 of a histogram counts times below one
+ * microsecond, bucket i > 0 times of 2^(i-1) up to 2^i microseconds; the
+ * last one also counts everything longer. Only updated while
+ * fLockStats is set, with relaxed atomics.
+ */
+struct CLockSite
+{
+    const char* pszName;
+    const char* pszFile;
+    int nLine;
+
+    std::atomic<uint64_t> nAcquired;
+    //! Acquisitions that had to wait for another thread
+    std::atomic<uint64_t> nContended;
+    std::atomic<uint64_t> nWaitMicros;
+    std::atomic<uint64_t> nHoldMicros;
+    std::atomic<uint64_t> vWaitHistogram[LOCK_STATS_BUCKETS];
+    std::atomic<uint64_t> vHoldHistogram[LOCK_STATS_BUCKETS];
+
+    CLockSite(const char* pszNameIn, const char* pszFileIn, int nLineIn);
+};
+
+/** Whether LOCK, TRY_LOCK and ENTER_CRITICAL_SECTION record CLockSite statistics */
+extern std::atomic<bool> fLockStats;
+
+/** Return the statistics of the given site, or NULL if no more sites can be tracked */
+CLockSite* GetLockSite(const char* pszName, const char* pszFile, int nLine);
+/** Monotonic time in microseconds, for measuring lock wait and hold times */
+int64_t GetLockStatsMicros();
+void RecordLockWait(CLockSite* psite, bool fContended, int64_t nMicros);
+void RecordLockHold(CLockSite* psite, int64_t nMicros);
+/** All sites seen so far */
+std::vector<const CLockSite*> GetLockSites();
+
+/**
+ * Return the site, looking it up only the first time through the lock
+ * macro expansion that owns *pcache. GetLockSite hashes the file name, which
+ * is too slow to do on every acquisition.
+ */
+inline CLockSite* GetCachedLockSite(std::atomic<CLockSite*>* pcache, const char* pszName, const char* pszFile, int nLine)
+{
+    if (!pcache)
+        return GetLockSite(pszName, pszFile, nLine);
+    CLockSite* psite = pcache->load(std::memory_order_acquire);
+    if (!psite) {
+        psite = GetLockSite(pszName, pszFile, nLine);
+        pcache->store(psite, std::memory_order_release);
+    }
+    return psite;
+}
+
+/** A CLockSite cache of its own for every expansion of the macro using it */
+#define LOCK_SITE_CACHE() ([]() -> std::atomic<CLockSite*>* { static std::atomic<CLockSite*> psite(nullptr); return &psite; }())
+
+/** Lock cs, recording how long that took in the statistics of its site */
+template <typename Mutex>
+void EnterCriticalSectionProfiled(Mutex& cs, const char* pszName, const char* pszFile, int nLine, std::atomic<CLockSite*>* psiteCache = NULL)
+{
+    CLockSite* psite = GetCachedLockSite(psiteCache, pszName, pszFile, nLine);
+    if (cs.try_lock()) {
+        RecordLockWait(psite, false, 0);
+        return;
+    }
+    const int64_t nStart = GetLockStatsMicros();
+    cs.lock();
+    RecordLockWait(psite, true, GetLockStatsMicros() - nStart);
+}
+
 /** Wrapper around boost::unique_lock<Mutex> */
 template <typename Mutex>
 class SCOPED_LOCKABLE CMutexLock
 {
 private:
     boost::unique_lock<Mutex> lock;
+    //! Where the lock was taken and when, if fLockStats was set then
+    CLockSite* psite;
+    int64_t nAcquiredMicros;
 
-    void Enter(const char* pszName, const char* pszFile, int nLine)
+    void Enter(const char* pszName, const char* pszFile, int nLine, std::atomic<CLockSite*>* psiteCache)
     {
         EnterCritical(pszName, pszFile, nLine, (void*)(lock.mutex()));
+        if (fLockStats.load(std::memory_order_relaxed)) {
+            psite = GetCachedLockSite(psiteCache, pszName, pszFile, nLine);
+            if (lock.try_lock()) {
+                nAcquiredMicros = GetLockStatsMicros();
+                RecordLockWait(psite, false, 0);
+            } else {
+                const int64_t nStart = GetLockStatsMicros();
+                lock.lock();
+                nAcquiredMicros = GetLockStatsMicros();
+                RecordLockWait(psite, true, nAcquiredMicros - nStart);
+            }
+            return;
+        }
 #ifdef DEBUG_LOCKCONTENTION
         if (!lock.try_lock()) {
             PrintLockContention(pszName, pszFile, nLine);
@@ -128,39 +224,47 @@ private:
 #endif
     }
 
-    bool TryEnter(const char* pszName, const char* pszFile, int nLine)
+    bool TryEnter(const char* pszName, const char* pszFile, int nLine, std::atomic<CLockSite*>* psiteCache)
     {
         EnterCritical(pszName, pszFile, nLine, (void*)(lock.mutex()), true);
         lock.try_lock();
         if (!lock.owns_lock())
             LeaveCritical();
+        else if (fLockStats.load(std::memory_order_relaxed)) {
+            psite = GetCachedLockSite(psiteCache, pszName, pszFile, nLine);
+            nAcquiredMicros = GetLockStatsMicros();
+            RecordLockWait(psite, false, 0);
+        }
         return lock.owns_lock();
     }
 
 public:
-    CMutexLock(Mutex& mutexIn, const char* pszName, const char* pszFile, int nLine, bool fTry = false) EXCLUSIVE_LOCK_FUNCTION(mutexIn) : lock(mutexIn, boost::defer_lock)
+    CMutexLock(Mutex& mutexIn, const char* pszName, const char* pszFile, int nLine, bool fTry = false, std::atomic<CLockSite*>* psiteCache = NULL) EXCLUSIVE_LOCK_FUNCTION(mutexIn) : lock(mutexIn, boost::defer_lock), psite(NULL), nAcquiredMicros(0)
     {
         if (fTry)
-            TryEnter(pszName, pszFile, nLine);
+            TryEnter(pszName, pszFile, nLine, psiteCache);
         else
-            Enter(pszName, pszFile, nLine);
+            Enter(pszName, pszFile, nLine, psiteCache);
     }
 
-    CMutexLock(Mutex* pmutexIn, const char* pszName, const char* pszFile, int nLine, bool fTry = false) EXCLUSIVE_LOCK_FUNCTION(pmutexIn)
+    CMutexLock(Mutex* pmutexIn, const char* pszName, const char* pszFile, int nLine, bool fTry = false, std::atomic<CLockSite*>* psiteCache = NULL) EXCLUSIVE_LOCK_FUNCTION(pmutexIn) : psite(NULL), nAcquiredMicros(0)
     {
         if (!pmutexIn) return;
 
         lock = boost::unique_lock<Mutex>(*pmutexIn, boost::defer_lock);
         if (fTry)
-            TryEnter(pszName, pszFile, nLine);
+            TryEnter(pszName, pszFile, nLine, psiteCache);
         else
-            Enter(pszName, pszFile, nLine);
+            Enter(pszName, pszFile, nLine, psiteCache);
     }
 
     ~CMutexLock() UNLOCK_FUNCTION()
     {
-        if (lock.owns_lock())
+        if (lock.owns_lock()) {
+            if (psite)
+                RecordLockHold(psite, GetLockStatsMicros() - nAcquiredMicros);
             LeaveCritical();
+        }
     }
 
     operator bool()
@@ -174,14 +278,18 @@ typedef CMutexLock<CCriticalSection> CCriticalBlock;
 #define PASTE(x, y) x ## y
 #define PASTE2(x, y) PASTE(x, y)
 
-#define LOCK(cs) CCriticalBlock PASTE2(criticalblock, __COUNTER__)(cs, #cs, __FILE__, __LINE__)
-#define LOCK2(cs1, cs2) CCriticalBlock criticalblock1(cs1, #cs1, __FILE__, __LINE__), criticalblock2(cs2, #cs2, __FILE__, __LINE__)
-#define TRY_LOCK(cs, name) CCriticalBlock name(cs, #cs, __FILE__, __LINE__, true)
-
-#define ENTER_CRITICAL_SECTION(cs)                            \
-    {                                                         \
-        EnterCritical(#cs, __FILE__, __LINE__, (void*)(&cs)); \
-        (cs).lock();                                          \
+#define LOCK(cs) CCriticalBlock PASTE2(criticalblock, __COUNTER__)(cs, #cs, __FILE__, __LINE__, false, LOCK_SITE_CACHE())
+#define LOCK2(cs1, cs2) CCriticalBlock criticalblock1(cs1, #cs1, __FILE__, __LINE__, false, LOCK_SITE_CACHE()), criticalblock2(cs2, #cs2, __FILE__, __LINE__, false, LOCK_SITE_CACHE())
+#define TRY_LOCK(cs, name) CCriticalBlock name(cs, #cs, __FILE__, __LINE__, true, LOCK_SITE_CACHE())
+
+/** Only the wait is recorded here, as there is nowhere to keep the start of the hold */
+#define ENTER_CRITICAL_SECTION(cs)                                         \
+    {                                                                      \
+        EnterCritical(#cs, __FILE__, __LINE__, (void*)(&cs));              \
+        if (fLockStats.load(std::memory_order_relaxed))                    \
+            EnterCriticalSectionProfiled(cs, #cs, __FILE__, __LINE__, LOCK_SITE_CACHE()); \
+        else                                                               \
+            (cs).lock();                                                   \
     }
 
 #define LEAVE_CRITICAL_SECTION(cs) \
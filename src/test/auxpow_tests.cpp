@@ -3,12 +3,15 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "auxpow.h"
+#include "blockfilemap.h"
 #include "chainparams.h"
 #include "coins.h"
 #include "consensus/merkle.h"
 #include "junkcoin.h"
 #include "primitives/block.h"
 #include "script/script.h"
+#include "streams.h"
+#include "txdb.h"
 #include "uint256.h"
 #include "utilstrencodings.h"
 #include "validation.h"
@@ -356,25 +359,32 @@ BOOST_AUTO_TEST_CASE(auxpow_pow)
     CBlockHeader block;
     block.nBits = target.GetCompact();
 
+    /* Every header checked below is also collected for the batch check.  */
+    std::vector<CBlockHeader> vHeaders;
+
     /* Verify the block version checks.  */
 
     block.nVersion = 1;
     mineBlock(block, true);
     BOOST_CHECK(CheckAuxPowProofOfWork(block, params));
+    vHeaders.push_back(block);
 
     // Junkcoin block version 2 can be both AuxPoW and regular, so test 3
 
     block.nVersion = 3;
     mineBlock(block, true);
     BOOST_CHECK(!CheckAuxPowProofOfWork(block, params));
+    vHeaders.push_back(block);
 
     block.SetBaseVersion(2, params.nAuxpowChainId);
     mineBlock(block, true);
     BOOST_CHECK(CheckAuxPowProofOfWork(block, params));
+    vHeaders.push_back(block);
 
     block.SetChainId(params.nAuxpowChainId + 1);
     mineBlock(block, true);
     BOOST_CHECK(!CheckAuxPowProofOfWork(block, params));
+    vHeaders.push_back(block);
 
     /* Check the case when the block does not have auxpow (this is true
      right now).  */
@@ -383,12 +393,15 @@ BOOST_AUTO_TEST_CASE(auxpow_pow)
     block.SetAuxpowFlag(true);
     mineBlock(block, true);
     BOOST_CHECK(!CheckAuxPowProofOfWork(block, params));
+    vHeaders.push_back(block);
 
     block.SetAuxpowFlag(false);
     mineBlock(block, true);
     BOOST_CHECK(CheckAuxPowProofOfWork(block, params));
+    vHeaders.push_back(block);
     mineBlock(block, false);
     BOOST_CHECK(!CheckAuxPowProofOfWork(block, params));
+    vHeaders.push_back(block);
 
     /* ****************************************** */
     /* Check the case that the block has auxpow.  */
@@ -409,9 +422,11 @@ BOOST_AUTO_TEST_CASE(auxpow_pow)
     mineBlock(builder.parentBlock, false, block.nBits);
     block.SetAuxpow(new CAuxPow(builder.get()));
     BOOST_CHECK(!CheckAuxPowProofOfWork(block, params));
+    vHeaders.push_back(block);
     mineBlock(builder.parentBlock, true, block.nBits);
     block.SetAuxpow(new CAuxPow(builder.get()));
     BOOST_CHECK(CheckAuxPowProofOfWork(block, params));
+    vHeaders.push_back(block);
 
     /* Mismatch between auxpow being present and block.nVersion.  Note that
      block.SetAuxpow sets also the version and that we want to ensure
@@ -428,6 +443,7 @@ BOOST_AUTO_TEST_CASE(auxpow_pow)
     block.SetAuxpowFlag(false);
     BOOST_CHECK(hashAux == block.GetHash());
     BOOST_CHECK(!CheckAuxPowProofOfWork(block, params));
+    vHeaders.push_back(block);
 
     /* Modifying the block invalidates the PoW.  */
     block.SetAuxpowFlag(true);
@@ -437,8 +453,129 @@ BOOST_AUTO_TEST_CASE(auxpow_pow)
     mineBlock(builder.parentBlock, true, block.nBits);
     block.SetAuxpow(new CAuxPow(builder.get()));
     BOOST_CHECK(CheckAuxPowProofOfWork(block, params));
+    vHeaders.push_back(block);
     tamperWith(block.hashMerkleRoot);
     BOOST_CHECK(!CheckAuxPowProofOfWork(block, params));
+    vHeaders.push_back(block);
+
+    /* The batch check must agree with the single header check.  */
+    std::vector<unsigned char> vResults(vHeaders.size());
+    CheckAuxPowProofOfWorkBatch(&vHeaders[0], vHeaders.size(), params, &vResults[0]);
+    for (size_t i = 0; i < vHeaders.size(); i++)
+        BOOST_CHECK_EQUAL(vResults[i] != 0, CheckAuxPowProofOfWork(vHeaders[i], params));
+}
+
+/* ************************************************************************** */
+
+BOOST_FIXTURE_TEST_CASE(auxpow_header_fallback, TestingSetup)
+{
+    const Consensus::Params& params = Params().GetConsensus(0);
+
+    CAuxpowBuilder builder(5, 42);
+    builder.setCoinbase(CScript() << OP_TRUE);
+    CBlock block;
+    block.SetBaseVersion(2, params.nAuxpowChainId);
+    block.SetAuxpow(new CAuxPow(builder.get()));
+    const uint256 hash = block.GetHash();
+
+    CDiskBlockPos pos(1, 0);
+    BOOST_REQUIRE(WriteBlockToDisk(block, pos, Params().MessageStart()));
+
+    CBlockIndex index(block);
+    index.phashBlock = &hash;
+    index.nFile = pos.nFile;
+    index.nDataPos = pos.nPos;
+    index.nStatus = BLOCK_HAVE_DATA | BLOCK_HAVE_AUXPOW;
+
+    /* The auxpow is missing from the block tree database (DB_BLOCK_AUXPOW),
+       so it has to come from the block file.  */
+    BOOST_REQUIRE(pblocktree->WriteAuxPow(hash, *block.auxpow));
+    BOOST_REQUIRE(pblocktree->Erase(std::make_pair('a', hash)));
+
+    CBlockHeader header;
+    BOOST_CHECK(index.GetBlockHeader(header, params, false));
+    BOOST_REQUIRE(header.auxpow);
+    BOOST_CHECK(header.GetHash() == hash);
+    CDataStream ssHeader(SER_NETWORK, PROTOCOL_VERSION);
+    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
+    ssHeader << header;
+    ssBlock << block.GetBlockHeader();
+    BOOST_CHECK(ssHeader.str() == ssBlock.str());
+
+    /* Without the block data there is nothing to fall back to.  */
+    auxpowCache.Erase(&index);
+    index.nStatus = BLOCK_HAVE_AUXPOW;
+    BOOST_CHECK(!index.GetBlockHeader(header, params, false));
+    auxpowCache.Erase(&index);
+}
+
+/** TestingSetup on regtest, where blocks are easy to mine.  */
+struct RegtestingSetup : public TestingSetup
+{
+    RegtestingSetup() : TestingSetup(CBaseChainParams::REGTEST) {}
+};
+
+BOOST_FIXTURE_TEST_CASE(block_read_checks, RegtestingSetup)
+{
+    const Consensus::Params& params = Params().GetConsensus(0);
+
+    CMutableTransaction mtx;
+    mtx.vin.resize(1);
+    mtx.vin[0].prevout.SetNull();
+    mtx.vout.resize(1);
+    mtx.vout[0].nValue = 1;
+    CBlock block;
+    block.nVersion = 1;
+    block.nBits = UintToArith256(params.powLimit).GetCompact();
+    block.vtx.push_back(MakeTransactionRef(mtx));
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+
+    /* Without valid PoW, only entries that are BLOCK_VALID_TREE can be read,
+       unless -checkblockreads asks for the full check.  */
+    mineBlock(block, false);
+    const uint256 hash = block.GetHash();
+    CDiskBlockPos pos(1, 0);
+    BOOST_REQUIRE(WriteBlockToDisk(block, pos, Params().MessageStart()));
+
+    CBlockIndex index(block);
+    index.phashBlock = &hash;
+    index.nFile = pos.nFile;
+    index.nDataPos = pos.nPos;
+    index.nStatus = BLOCK_HAVE_DATA | BLOCK_VALID_TREE;
+
+    CBlock read;
+    BOOST_CHECK(ReadBlockFromDisk(read, &index, params));
+    BOOST_CHECK(read.GetHash() == hash);
+    BOOST_CHECK(!ReadBlockFromDisk(read, pos, params));
+    index.nStatus = BLOCK_HAVE_DATA;
+    BOOST_CHECK(!ReadBlockFromDisk(read, &index, params));
+    index.nStatus = BLOCK_HAVE_DATA | BLOCK_VALID_TREE;
+    fCheckBlockReads = true;
+    BOOST_CHECK(!ReadBlockFromDisk(read, &index, params));
+    CByteSpan span;
+    BOOST_CHECK(!ReadRawBlockFromDisk(span, &index, Params().MessageStart()));
+    fCheckBlockReads = false;
+    BOOST_CHECK(ReadRawBlockFromDisk(span, &index, Params().MessageStart()));
+
+    /* The block hash does not cover the transactions, so only
+       -checkblockreads notices that they changed.  */
+    mineBlock(block, true);
+    const uint256 hashMined = block.GetHash();
+    CBlock corrupted(block);
+    mtx.vout[0].nValue = 2;
+    corrupted.vtx[0] = MakeTransactionRef(mtx);
+    BOOST_REQUIRE(corrupted.GetHash() == hashMined);
+    CDiskBlockPos posCorrupted(2, 0);
+    BOOST_REQUIRE(WriteBlockToDisk(corrupted, posCorrupted, Params().MessageStart()));
+    index.phashBlock = &hashMined;
+    index.nFile = posCorrupted.nFile;
+    index.nDataPos = posCorrupted.nPos;
+    index.nStatus = BLOCK_HAVE_DATA;
+    BOOST_CHECK(ReadBlockFromDisk(read, &index, params));
+    fCheckBlockReads = true;
+    BOOST_CHECK(!ReadBlockFromDisk(read, &index, params));
+    BOOST_CHECK(!ReadRawBlockFromDisk(span, &index, Params().MessageStart()));
+    fCheckBlockReads = DEFAULT_CHECKBLOCKREADS;
 }
 
 /* ************************************************************************** */
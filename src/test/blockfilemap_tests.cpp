@@ -0,0 +1,206 @@
+// Copyright (c) 2026 The Junkcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilemap.h"
+#include "chain.h"
+#include "chainparams.h"
+#include "clientversion.h"
+#include "consensus/merkle.h"
+#include "netmessagemaker.h"
+#include "primitives/block.h"
+#include "streams.h"
+#include "validation.h"
+#include "version.h"
+#include "test/test_bitcoin.h"
+
+#include <string.h>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+CBlock MakeBlock(int n, bool fWitness = false)
+{
+    CBlock block;
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig = CScript() << n << OP_0;
+    if (fWitness)
+        tx.vin[0].scriptWitness.stack.push_back(std::vector<unsigned char>(32, n));
+    tx.vout.resize(1);
+    tx.vout[0].nValue = n;
+    block.vtx.push_back(MakeTransactionRef(std::move(tx)));
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+    return block;
+}
+
+//! Append block to file nFile, whose size is nFileSize
+CDiskBlockPos AppendBlock(const CBlock& block, int nFile, unsigned int& nFileSize)
+{
+    CDiskBlockPos pos(nFile, nFileSize);
+    BOOST_CHECK(WriteBlockToDisk(block, pos, Params().MessageStart()));
+    nFileSize = pos.nPos + ::GetSerializeSize(block, SER_DISK, CLIENT_VERSION);
+    return pos;
+}
+
+bool SpanMatches(const CByteSpan& span, const CBlock& block)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << block;
+    return span.size == ss.size() && memcmp(span.data, ss.data(), ss.size()) == 0;
+}
+}
+
+BOOST_FIXTURE_TEST_SUITE(blockfilemap_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(blockfilemap_records)
+{
+    const CMessageHeader::MessageStartChars& messageStart = Params().MessageStart();
+    CBlockFileMap map(4);
+    unsigned int nFileSize = 0;
+    CBlock block0 = MakeBlock(0), block1 = MakeBlock(1);
+    CDiskBlockPos pos0 = AppendBlock(block0, 1, nFileSize);
+
+    CByteSpan span0;
+    BOOST_CHECK(map.GetRecord(pos0, "blk", messageStart, 0, span0));
+    BOOST_CHECK(SpanMatches(span0, block0));
+    BOOST_CHECK_EQUAL(map.GetMappedCount(), 1U);
+
+    // A record appended after the file was mapped is found too.
+    CDiskBlockPos pos1 = AppendBlock(block1, 1, nFileSize);
+    CByteSpan span1;
+    BOOST_CHECK(map.GetRecord(pos1, "blk", messageStart, 0, span1));
+    BOOST_CHECK(SpanMatches(span1, block1));
+
+    // Positions that do not follow a record header are rejected.
+    CByteSpan span;
+    BOOST_CHECK(!map.GetRecord(CDiskBlockPos(1, pos1.nPos + 1), "blk", messageStart, 0, span));
+    BOOST_CHECK(!map.GetRecord(CDiskBlockPos(1, 4), "blk", messageStart, 0, span));
+    BOOST_CHECK(!map.GetRecord(CDiskBlockPos(1, nFileSize + 100), "blk", messageStart, 0, span));
+    BOOST_CHECK(!map.GetRecord(pos1, "blk", messageStart, 1, span));
+    BOOST_CHECK(!map.GetRecord(CDiskBlockPos(2, pos0.nPos), "blk", messageStart, 0, span));
+    CMessageHeader::MessageStartChars otherStart;
+    memcpy(otherStart, messageStart, sizeof(otherStart));
+    otherStart[0] ^= 1;
+    BOOST_CHECK(!map.GetRecord(pos0, "blk", otherStart, 0, span));
+
+    // Spans stay valid after their file is dropped from the map.
+    map.Forget(1);
+    BOOST_CHECK_EQUAL(map.GetMappedCount(), 0U);
+    BOOST_CHECK(SpanMatches(span0, block0));
+    BOOST_CHECK(SpanMatches(span1, block1));
+}
+
+BOOST_AUTO_TEST_CASE(blockfilemap_lru)
+{
+    const CMessageHeader::MessageStartChars& messageStart = Params().MessageStart();
+    CBlockFileMap map(2);
+    std::vector<CDiskBlockPos> vPos;
+    for (int nFile = 1; nFile <= 3; nFile++) {
+        unsigned int nFileSize = 0;
+        vPos.push_back(AppendBlock(MakeBlock(nFile), nFile, nFileSize));
+    }
+
+    CByteSpan span;
+    for (size_t i = 0; i < vPos.size(); i++) {
+        BOOST_CHECK(map.GetRecord(vPos[i], "blk", messageStart, 0, span));
+        BOOST_CHECK(SpanMatches(span, MakeBlock(i + 1)));
+        BOOST_CHECK_EQUAL(map.GetMappedCount(), std::min<size_t>(i + 1, 2));
+    }
+    // The least recently used file was unmapped, and is mapped again on demand.
+    BOOST_CHECK(map.GetRecord(vPos[0], "blk", messageStart, 0, span));
+    BOOST_CHECK(SpanMatches(span, MakeBlock(1)));
+    BOOST_CHECK_EQUAL(map.GetMappedCount(), 2U);
+}
+
+BOOST_AUTO_TEST_CASE(blockfilemap_read_block)
+{
+    const CChainParams& chainparams = Params();
+    unsigned int nFileSize = 0;
+    CBlock block = MakeBlock(7);
+    CDiskBlockPos pos = AppendBlock(block, 1, nFileSize);
+
+    CBlockFileMap map(4);
+    for (int i = 0; i < 2; i++) {
+        // Once read from the mapped file, once through fread.
+        pblockFileMap = i == 0 ? &map : NULL;
+
+        CBlock blockRead;
+        BOOST_CHECK(ReadBlockFromDisk(blockRead, pos, chainparams.GetConsensus(0), false));
+        BOOST_CHECK(blockRead.GetHash() == block.GetHash());
+        BOOST_CHECK(blockRead.vtx[0]->GetHash() == block.vtx[0]->GetHash());
+
+        CByteSpan span;
+        BOOST_CHECK(ReadRawBlockFromDisk(span, pos, chainparams.MessageStart()));
+        BOOST_CHECK(SpanMatches(span, block));
+        BOOST_CHECK(!ReadRawBlockFromDisk(span, CDiskBlockPos(1, pos.nPos + 1), chainparams.MessageStart()));
+    }
+    BOOST_CHECK_EQUAL(map.GetMappedCount(), 1U);
+    pblockFileMap = NULL;
+}
+
+BOOST_AUTO_TEST_CASE(blockfilemap_raw_block_is_network_block)
+{
+    // ProcessGetData sends the stored bytes of a block as the reply to a
+    // request for it with witnesses, and to one without if it has none.
+    const CChainParams& chainparams = Params();
+    const CNetMsgMaker msgMaker(PROTOCOL_VERSION);
+    unsigned int nFileSize = 0;
+    for (int i = 0; i < 2; i++) {
+        bool fWitness = i == 1;
+        CBlock block = MakeBlock(i, fWitness);
+        CDiskBlockPos pos = AppendBlock(block, 1, nFileSize);
+        CByteSpan span;
+        BOOST_CHECK(ReadRawBlockFromDisk(span, pos, chainparams.MessageStart()));
+        CSerializedNetMsg msgRaw = msgMaker.Make(NetMsgType::BLOCK, CFlatData((void*)span.data, (void*)(span.data + span.size)));
+
+        CSerializedNetMsg msgWitness = msgMaker.Make(NetMsgType::BLOCK, block);
+        CSerializedNetMsg msgNoWitness = msgMaker.Make(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::BLOCK, block);
+        BOOST_CHECK(msgRaw.data == msgWitness.data);
+        BOOST_CHECK_EQUAL(msgRaw.data == msgNoWitness.data, !fWitness);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(blockfilemap_block_cache)
+{
+    const CChainParams& chainparams = Params();
+    unsigned int nFileSize = 0;
+    CBlock block = MakeBlock(3, true);
+    CDiskBlockPos pos = AppendBlock(block, 1, nFileSize);
+    const uint256 hash = block.GetHash();
+    CBlockIndex index(block);
+    index.phashBlock = &hash;
+    index.nFile = pos.nFile;
+    index.nDataPos = pos.nPos;
+    index.nStatus |= BLOCK_HAVE_DATA;
+
+    blockCache.Clear();
+    CLRUCache<uint256, BlockHasher>::Stats stats = blockCache.GetStats();
+    for (int i = 0; i < 2; i++) {
+        // Read from disk first, then from the cache.
+        CByteSpan span;
+        BOOST_CHECK(ReadRawBlockCached(span, &index, chainparams.MessageStart()));
+        BOOST_CHECK(SpanMatches(span, block));
+        CBlock blockRead;
+        BOOST_CHECK(DecodeRawBlock(blockRead, span));
+        BOOST_CHECK(blockRead.GetHash() == hash);
+        BOOST_CHECK(blockRead.vtx[0]->GetWitnessHash() == block.vtx[0]->GetWitnessHash());
+    }
+    CLRUCache<uint256, BlockHasher>::Stats statsAfter = blockCache.GetStats();
+    BOOST_CHECK_EQUAL(statsAfter.nEntries, 1U);
+    BOOST_CHECK_EQUAL(statsAfter.nMisses - stats.nMisses, 1U);
+    BOOST_CHECK_EQUAL(statsAfter.nHits - stats.nHits, 1U);
+
+    // A block that does not match its index entry is not cached.
+    CBlockIndex indexOther(index);
+    const uint256 hashOther = MakeBlock(4).GetHash();
+    indexOther.phashBlock = &hashOther;
+    CByteSpan span;
+    BOOST_CHECK(!ReadRawBlockCached(span, &indexOther, chainparams.MessageStart()));
+    BOOST_CHECK_EQUAL(blockCache.GetStats().nEntries, 1U);
+    blockCache.Clear();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
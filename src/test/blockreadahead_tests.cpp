@@ -0,0 +1,129 @@
+// Copyright (c) 2026 The Junkcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockreadahead.h"
+#include "chain.h"
+#include "chainparams.h"
+#include "consensus/merkle.h"
+#include "primitives/block.h"
+#include "utiltime.h"
+#include "validation.h"
+#include "test/test_bitcoin.h"
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+namespace
+{
+struct ReadAheadSetup : public TestingSetup {
+    std::vector<CBlock> vBlocks;
+    std::vector<uint256> vHashes;
+    std::vector<CBlockIndex> vIndex;
+    std::vector<const CBlockIndex*> vpindex;
+
+    ReadAheadSetup()
+    {
+        const CChainParams& chainparams = Params();
+        vBlocks.resize(10);
+        vHashes.resize(vBlocks.size());
+        vIndex.resize(vBlocks.size());
+        for (size_t i = 0; i < vBlocks.size(); i++) {
+            CBlock& block = vBlocks[i];
+            CMutableTransaction tx;
+            tx.vin.resize(1);
+            tx.vin[0].scriptSig = CScript() << (int)i << OP_0;
+            tx.vout.resize(1);
+            tx.vout[0].nValue = i;
+            block.vtx.push_back(MakeTransactionRef(std::move(tx)));
+            block.hashMerkleRoot = BlockMerkleRoot(block);
+            vHashes[i] = block.GetHash();
+
+            // One file per block, well clear of the ones used by the chain.
+            CDiskBlockPos pos(1000 + i, 0);
+            BOOST_CHECK(WriteBlockToDisk(block, pos, chainparams.MessageStart()));
+            CBlockIndex& index = vIndex[i];
+            index.phashBlock = &vHashes[i];
+            index.nHeight = i + 1;
+            index.nFile = pos.nFile;
+            index.nDataPos = pos.nPos;
+            index.nStatus = BLOCK_HAVE_DATA | BLOCK_VALID_TREE;
+            vpindex.push_back(&index);
+        }
+    }
+};
+
+bool WaitForReady(const CBlockReadAhead& readahead, size_t nCount)
+{
+    for (int i = 0; i < 1000 && readahead.GetReadyCount() < nCount; i++)
+        MilliSleep(10);
+    return readahead.GetReadyCount() == nCount;
+}
+}
+
+BOOST_FIXTURE_TEST_SUITE(blockreadahead_tests, ReadAheadSetup)
+
+BOOST_AUTO_TEST_CASE(blockreadahead_read)
+{
+    CBlockReadAhead readahead(1 << 20);
+
+    // Without worker threads nothing is read ahead.
+    readahead.Request(vpindex, Params());
+    BOOST_CHECK(!readahead.Take(vpindex[0]));
+
+    boost::thread_group threadGroup;
+    readahead.StartThreads(threadGroup, 1);
+    readahead.Request(vpindex, Params());
+    BOOST_CHECK(WaitForReady(readahead, vpindex.size()));
+    for (size_t i = 0; i < 5; i++) {
+        std::shared_ptr<const CBlock> pblock = readahead.Take(vpindex[i]);
+        BOOST_CHECK(pblock);
+        if (pblock) {
+            BOOST_CHECK(pblock->GetHash() == vHashes[i]);
+            BOOST_CHECK_EQUAL(pblock->vtx[0]->vout[0].nValue, (CAmount)i);
+        }
+    }
+    BOOST_CHECK_EQUAL(readahead.GetReadyCount(), 5U);
+
+    // A block is handed out once.
+    BOOST_CHECK(!readahead.Take(vpindex[0]));
+
+    // Blocks that are no longer on the requested path are forgotten.
+    readahead.Request(std::vector<const CBlockIndex*>(vpindex.begin() + 7, vpindex.end()), Params());
+    BOOST_CHECK_EQUAL(readahead.GetReadyCount(), 3U);
+    BOOST_CHECK(!readahead.Take(vpindex[5]));
+    BOOST_CHECK(readahead.Take(vpindex[7]));
+
+    // Blocks without data are skipped.
+    vIndex[9].nStatus &= ~BLOCK_HAVE_DATA;
+    readahead.Request(std::vector<const CBlockIndex*>(vpindex.begin() + 9, vpindex.end()), Params());
+    BOOST_CHECK_EQUAL(readahead.GetReadyCount(), 0U);
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+}
+
+BOOST_AUTO_TEST_CASE(blockreadahead_memory_limit)
+{
+    // Not enough room for a single block: every block has to be taken
+    // before the next one is read.
+    CBlockReadAhead readahead(1);
+    boost::thread_group threadGroup;
+    readahead.StartThreads(threadGroup, 1);
+    readahead.Request(vpindex, Params());
+    for (size_t i = 0; i < vpindex.size(); i++) {
+        BOOST_CHECK(WaitForReady(readahead, 1));
+        MilliSleep(10);
+        BOOST_CHECK_EQUAL(readahead.GetReadyCount(), 1U);
+        std::shared_ptr<const CBlock> pblock = readahead.Take(vpindex[i]);
+        BOOST_CHECK(pblock && pblock->GetHash() == vHashes[i]);
+    }
+    BOOST_CHECK_EQUAL(readahead.GetReadyCount(), 0U);
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -209,6 +209,34 @@ BOOST_AUTO_TEST_CASE(test_CheckQueue_Correct_Random)
     Correct_Queue_range(range);
 }
 
+/** Test that more workers than the old limit of 16 all take part, and come
+ * and go without losing checks.
+ */
+BOOST_AUTO_TEST_CASE(test_CheckQueue_ManyWorkers)
+{
+    auto queue = std::unique_ptr<Correct_Queue>(new Correct_Queue {QUEUE_BATCH_SIZE});
+    for (int round = 0; round < 2; ++round) {
+        boost::thread_group tg;
+        for (auto x = 0; x < 63; ++x) {
+           tg.create_thread([&]{queue->Thread();});
+        }
+        for (size_t i = 0; i < 20; ++i) {
+            FakeCheckCheckCompletion::n_calls = 0;
+            CCheckQueueControl<FakeCheckCheckCompletion> control(queue.get());
+            size_t total = 10000;
+            std::vector<FakeCheckCheckCompletion> vChecks;
+            while (total) {
+                vChecks.resize(std::min(total, (size_t) GetRand(10)));
+                total -= vChecks.size();
+                control.Add(vChecks);
+            }
+            BOOST_REQUIRE(control.Wait());
+            BOOST_REQUIRE_EQUAL(FakeCheckCheckCompletion::n_calls, 10000U);
+        }
+        tg.interrupt_all();
+        tg.join_all();
+    }
+}
 
 /** Test that failing checks are caught */
 BOOST_AUTO_TEST_CASE(test_CheckQueue_Catches_Failure)
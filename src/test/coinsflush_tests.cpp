@@ -0,0 +1,158 @@
+// Copyright (c) 2026 The Junkcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "coins.h"
+#include "coinsflush.h"
+#include "random.h"
+#include "txdb.h"
+#include "utxocommitment.h"
+#include "test/test_bitcoin.h"
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+namespace
+{
+/** Passes writes through to its base only once opened, or fails them. */
+class CCoinsViewGateTest : public CCoinsViewBacked
+{
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    bool fOpen;
+    bool fFail;
+
+public:
+    CCoinsViewGateTest(CCoinsView* viewIn) : CCoinsViewBacked(viewIn), fOpen(false), fFail(false) {}
+
+    void Open(bool fFailIn = false)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fOpen = true;
+        fFail = fFailIn;
+        cond.notify_all();
+    }
+
+    bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock)
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            while (!fOpen)
+                cond.wait(lock);
+            if (fFail)
+                return false;
+        }
+        return base->BatchWrite(mapCoins, hashBlock);
+    }
+};
+
+Coin MakeCoin(int i)
+{
+    Coin coin;
+    coin.out.nValue = i + 1;
+    coin.out.scriptPubKey.assign((size_t)(1 + i % 30), OP_TRUE);
+    coin.nHeight = i + 1;
+    return coin;
+}
+}
+
+BOOST_FIXTURE_TEST_SUITE(coinsflush_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(coinsflush_background)
+{
+    CCoinsViewDB db(1 << 20, true);
+    CCoinsViewGateTest gate(&db);
+    CUTXOCommitment commitment;
+    CCoinsViewFlusher flusher(&gate, &commitment);
+    db.SetCommitment(flusher.GetWritingCommitment());
+    CCoinsViewCache cache(&flusher);
+
+    boost::thread_group threadGroup;
+    flusher.StartThread(threadGroup);
+
+    std::vector<COutPoint> vOutPoints;
+    for (int i = 0; i < 100; i++) {
+        vOutPoints.push_back(COutPoint(GetRandHash(), i % 4));
+        cache.AddCoin(vOutPoints.back(), MakeCoin(i), false);
+        commitment.Add(vOutPoints.back(), MakeCoin(i));
+    }
+    uint256 hashBlock = GetRandHash();
+    cache.SetBestBlock(hashBlock);
+    commitment.hashBlock = hashBlock;
+    uint256 hashUTXOSet = commitment.GetHash();
+
+    // The flush returns while the write is held up, leaving the cache empty.
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK(flusher.IsWriting());
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0U);
+
+    // Validation carries on: the coins being written are still found, and
+    // the commitment may move on without affecting the one being written.
+    BOOST_CHECK(flusher.GetBestBlock() == hashBlock);
+    for (size_t i = 0; i < vOutPoints.size(); i++) {
+        BOOST_CHECK(!db.HaveCoin(vOutPoints[i]));
+        BOOST_CHECK_EQUAL(cache.AccessCoin(vOutPoints[i]).out.nValue, i + 1);
+    }
+    Coin coinSpent;
+    BOOST_CHECK(cache.SpendCoin(vOutPoints[0], &coinSpent));
+    commitment.Remove(vOutPoints[0], coinSpent);
+    commitment.hashBlock = GetRandHash();
+
+    // Nothing, not even the best block, reaches the database before the batch commits.
+    BOOST_CHECK(db.GetBestBlock().IsNull());
+    CUTXOCommitment commitmentStored;
+    BOOST_CHECK(!db.ReadCommitment(commitmentStored));
+
+    gate.Open();
+    BOOST_CHECK(flusher.Sync());
+    BOOST_CHECK(!flusher.IsWriting());
+    BOOST_CHECK(db.GetBestBlock() == hashBlock);
+    BOOST_CHECK(db.ReadCommitment(commitmentStored));
+    BOOST_CHECK(commitmentStored.hashBlock == hashBlock);
+    BOOST_CHECK(commitmentStored.GetHash() == hashUTXOSet);
+    for (size_t i = 0; i < vOutPoints.size(); i++) {
+        Coin coin;
+        BOOST_CHECK(db.GetCoin(vOutPoints[i], coin));
+        BOOST_CHECK_EQUAL(coin.out.nValue, i + 1);
+    }
+
+    // Once the writer thread is gone, batches are written synchronously.
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+    cache.SetBestBlock(commitment.hashBlock);
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK(!flusher.IsWriting());
+    BOOST_CHECK(!db.HaveCoin(vOutPoints[0]));
+    BOOST_CHECK(db.HaveCoin(vOutPoints[1]));
+    BOOST_CHECK(db.GetBestBlock() == commitment.hashBlock);
+}
+
+BOOST_AUTO_TEST_CASE(coinsflush_failure)
+{
+    CCoinsViewDB db(1 << 20, true);
+    CCoinsViewGateTest gate(&db);
+    CCoinsViewFlusher flusher(&gate, NULL);
+    CCoinsViewCache cache(&flusher);
+
+    boost::thread_group threadGroup;
+    flusher.StartThread(threadGroup);
+
+    COutPoint outpoint(GetRandHash(), 0);
+    cache.AddCoin(outpoint, MakeCoin(0), false);
+    cache.SetBestBlock(GetRandHash());
+    BOOST_CHECK(cache.Flush());
+
+    // A failed write is reported by the next flush, and sticks.
+    gate.Open(true);
+    BOOST_CHECK(!flusher.Sync());
+    BOOST_CHECK(!cache.Flush());
+    BOOST_CHECK(!flusher.Sync());
+    BOOST_CHECK(!db.HaveCoin(outpoint));
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
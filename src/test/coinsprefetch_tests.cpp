@@ -0,0 +1,232 @@
+// Copyright (c) 2026 The Junkcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "coins.h"
+#include "coinsprefetch.h"
+#include "random.h"
+#include "utiltime.h"
+#include "test/test_bitcoin.h"
+
+#include <atomic>
+#include <map>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+namespace
+{
+/** Map-backed view that can be read from several threads at once, as long as nobody writes. */
+class CCoinsViewMapTest : public CCoinsView
+{
+public:
+    std::map<COutPoint, Coin> map;
+    mutable std::atomic<int> nReads;
+
+    CCoinsViewMapTest() : nReads(0) {}
+
+    bool GetCoin(const COutPoint& outpoint, Coin& coin) const
+    {
+        nReads++;
+        std::map<COutPoint, Coin>::const_iterator it = map.find(outpoint);
+        if (it == map.end())
+            return false;
+        coin = it->second;
+        return true;
+    }
+
+    bool HaveCoin(const COutPoint& outpoint) const
+    {
+        return map.count(outpoint);
+    }
+
+    bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock)
+    {
+        for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end(); it++) {
+            if (!(it->second.flags & CCoinsCacheEntry::DIRTY))
+                continue;
+            if (it->second.coin.IsSpent())
+                map.erase(it->first);
+            else
+                map[it->first] = it->second.coin;
+        }
+        mapCoins.clear();
+        return true;
+    }
+};
+
+bool WaitForStaged(const CCoinsViewPrefetch& view, size_t nCount)
+{
+    for (int i = 0; i < 1000 && view.GetStagedCount() < nCount; i++)
+        MilliSleep(10);
+    return view.GetStagedCount() == nCount;
+}
+}
+
+BOOST_FIXTURE_TEST_SUITE(coinsprefetch_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(coinsprefetch_staging)
+{
+    CCoinsViewMapTest base;
+    std::vector<COutPoint> vOutPoints;
+    for (int i = 0; i < 500; i++) {
+        COutPoint outpoint(GetRandHash(), i % 3);
+        Coin coin;
+        coin.out.nValue = i + 1;
+        coin.nHeight = i + 1;
+        base.map[outpoint] = coin;
+        vOutPoints.push_back(outpoint);
+    }
+
+    CCoinsViewPrefetch prefetch(&base, 1 << 20);
+
+    // Without worker threads prefetching does nothing.
+    prefetch.Prefetch(std::vector<COutPoint>(vOutPoints), 1);
+    BOOST_CHECK_EQUAL(prefetch.GetStagedCount(), 0U);
+
+    boost::thread_group threadGroup;
+    prefetch.StartThreads(threadGroup, 3);
+
+    // Outpoints that do not exist are not staged.
+    std::vector<COutPoint> vRequest(vOutPoints);
+    for (int i = 0; i < 20; i++)
+        vRequest.push_back(COutPoint(GetRandHash(), 0));
+    prefetch.Prefetch(std::move(vRequest), 1);
+    BOOST_CHECK(WaitForStaged(prefetch, vOutPoints.size()));
+
+    // Misses in the cache above are answered from the staged coins, which
+    // are handed over rather than read again.
+    base.nReads = 0;
+    {
+        CCoinsViewCache cache(&prefetch);
+        for (size_t i = 0; i < vOutPoints.size(); i++) {
+            const Coin& coin = cache.AccessCoin(vOutPoints[i]);
+            BOOST_CHECK_EQUAL(coin.out.nValue, base.map[vOutPoints[i]].out.nValue);
+            BOOST_CHECK_EQUAL(coin.nHeight, base.map[vOutPoints[i]].nHeight);
+        }
+        BOOST_CHECK_EQUAL(base.nReads, 0);
+        BOOST_CHECK_EQUAL(prefetch.GetStagedCount(), 0U);
+    }
+
+    // Writing through the view drops the staged copies of whatever changed.
+    prefetch.Prefetch(std::vector<COutPoint>(vOutPoints.begin(), vOutPoints.begin() + 10), 1);
+    BOOST_CHECK(WaitForStaged(prefetch, 10));
+    {
+        // Spend the first output.
+        CCoinsMap mapCoins;
+        CCoinsCacheEntry entry;
+        entry.flags = CCoinsCacheEntry::DIRTY;
+        mapCoins.emplace(vOutPoints[0], std::move(entry));
+        BOOST_CHECK(prefetch.BatchWrite(mapCoins, uint256()));
+    }
+    BOOST_CHECK_EQUAL(prefetch.GetStagedCount(), 9U);
+    {
+        CCoinsViewCache cache(&prefetch);
+        BOOST_CHECK(!cache.HaveCoin(vOutPoints[0]));
+        BOOST_CHECK(cache.HaveCoin(vOutPoints[1]));
+    }
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+}
+
+BOOST_AUTO_TEST_CASE(coinsprefetch_memory_limit)
+{
+    CCoinsViewMapTest base;
+    std::vector<COutPoint> vOutPoints;
+    for (int i = 0; i < 200; i++) {
+        COutPoint outpoint(GetRandHash(), 0);
+        Coin coin;
+        coin.out.nValue = i + 1;
+        coin.out.scriptPubKey.assign((size_t)1000, 0);
+        base.map[outpoint] = coin;
+        vOutPoints.push_back(outpoint);
+    }
+
+    // Room for a few dozen coins with 1000 byte scripts.
+    CCoinsViewPrefetch prefetch(&base, 32 * 1024);
+    boost::thread_group threadGroup;
+    prefetch.StartThreads(threadGroup, 1);
+    prefetch.Prefetch(std::move(vOutPoints), 1);
+    for (int i = 0; i < 100 && base.nReads < 200; i++)
+        MilliSleep(10);
+    MilliSleep(50);
+    BOOST_CHECK(prefetch.GetStagedCount() > 0);
+    BOOST_CHECK(prefetch.GetStagedCount() < 40);
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+}
+
+BOOST_AUTO_TEST_CASE(coinsprefetch_expire)
+{
+    CCoinsViewMapTest base;
+    std::vector<COutPoint> vOutPoints;
+    for (int i = 0; i < 200; i++) {
+        COutPoint outpoint(GetRandHash(), 0);
+        Coin coin;
+        coin.out.nValue = i + 1;
+        coin.out.scriptPubKey.assign((size_t)1000, 0);
+        base.map[outpoint] = coin;
+        vOutPoints.push_back(outpoint);
+    }
+    std::vector<COutPoint> vFirst(vOutPoints.begin(), vOutPoints.begin() + 100);
+    std::vector<COutPoint> vSecond(vOutPoints.begin() + 100, vOutPoints.end());
+
+    CCoinsViewPrefetch prefetch(&base, 32 * 1024);
+    boost::thread_group threadGroup;
+    prefetch.StartThreads(threadGroup, 1);
+
+    // Fill the staging area with coins of a block at height 5 that is
+    // never connected.
+    prefetch.Prefetch(std::vector<COutPoint>(vFirst), 5);
+    for (int i = 0; i < 100 && base.nReads < 100; i++)
+        MilliSleep(10);
+    MilliSleep(50);
+    const size_t nStaged = prefetch.GetStagedCount();
+    BOOST_CHECK(nStaged > 0);
+
+    // While it is full, nothing is staged for the next block.
+    base.nReads = 0;
+    prefetch.Prefetch(std::vector<COutPoint>(vSecond), 6);
+    MilliSleep(100);
+    BOOST_CHECK_EQUAL(base.nReads, 0);
+    BOOST_CHECK_EQUAL(prefetch.GetStagedCount(), nStaged);
+
+    // Once the chain has passed height 5, its coins are dropped...
+    prefetch.Expire(4);
+    BOOST_CHECK_EQUAL(prefetch.GetStagedCount(), nStaged);
+    prefetch.Expire(5);
+    BOOST_CHECK_EQUAL(prefetch.GetStagedCount(), 0U);
+
+    // ...and prefetching resumes.
+    prefetch.Prefetch(std::vector<COutPoint>(vSecond), 6);
+    for (int i = 0; i < 100 && base.nReads < 100; i++)
+        MilliSleep(10);
+    MilliSleep(50);
+    const size_t nStagedSecond = prefetch.GetStagedCount();
+    BOOST_CHECK(nStagedSecond > 0);
+
+    // Coins staged again for a later block stay until that one is reached.
+    prefetch.Prefetch(std::vector<COutPoint>(vSecond), 8);
+    MilliSleep(100);
+    prefetch.Expire(7);
+    BOOST_CHECK_EQUAL(prefetch.GetStagedCount(), nStagedSecond);
+    prefetch.Expire(8);
+    BOOST_CHECK_EQUAL(prefetch.GetStagedCount(), 0U);
+
+    // Clear drops everything, whatever its height.
+    prefetch.Prefetch(std::vector<COutPoint>(vFirst), 9);
+    for (int i = 0; i < 100 && prefetch.GetStagedCount() == 0; i++)
+        MilliSleep(10);
+    BOOST_CHECK(prefetch.GetStagedCount() > 0);
+    MilliSleep(50);
+    prefetch.Clear();
+    BOOST_CHECK_EQUAL(prefetch.GetStagedCount(), 0U);
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -9,6 +9,8 @@
 #include "crypto/sha512.h"
 #include "crypto/hmac_sha256.h"
 #include "crypto/hmac_sha512.h"
+#include "crypto/muhash.h"
+#include "hash.h"
 #include "utilstrencodings.h"
 #include "test/test_bitcoin.h"
 #include "test/test_random.h"
@@ -255,6 +257,22 @@ BOOST_AUTO_TEST_CASE(sha256_testvectors) {
     TestSHA256(test1, "a316d55510b49662420f49d145d42fb83f31ef8dc016aa4e32df049991a91e26");
 }
 
+BOOST_AUTO_TEST_CASE(sha256d64)
+{
+    for (int i = 0; i <= 32; ++i) {
+        unsigned char in[64 * 32];
+        unsigned char out1[32 * 32], out2[32 * 32];
+        for (int j = 0; j < 64 * i; ++j) {
+            in[j] = insecure_rand();
+        }
+        for (int j = 0; j < i; ++j) {
+            CHash256().Write(in + 64 * j, 64).Finalize(out1 + 32 * j);
+        }
+        SHA256D64(out2, in, i);
+        BOOST_CHECK(memcmp(out1, out2, 32 * i) == 0);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(sha512_testvectors) {
     TestSHA512("",
                "cf83e1357eefb8bdf1542850d66d8007d620e4050b5715dc83f4a921d36ce9ce"
@@ -439,4 +457,84 @@ BOOST_AUTO_TEST_CASE(aes_cbc_testvectors) {
                   "b2eb05e2c39be9fcda6c19078c6a9d1b3f461796d6b0d6b2e0c2a72b4d80e644");
 }
 
+static uint256 FromInt(int i)
+{
+    unsigned char tmp = i;
+    uint256 ret;
+    CSHA256().Write(&tmp, 1).Finalize(ret.begin());
+    return ret;
+}
+
+static uint256 FinalizeMuHash(MuHash3072 muhash)
+{
+    uint256 out;
+    muhash.Finalize(out.begin());
+    return out;
+}
+
+BOOST_AUTO_TEST_CASE(muhash_tests)
+{
+    // (p - 1)^2 = 1 mod p, which exercises the reduction of the largest values.
+    unsigned char data[Num3072::BYTE_SIZE];
+    memset(data, 0xff, sizeof(data));
+    data[0] = 0x9a;
+    data[1] = 0x28;
+    data[2] = 0xef;
+    Num3072 pminus1(data);
+    pminus1.Multiply(Num3072(data));
+    unsigned char squared[Num3072::BYTE_SIZE];
+    pminus1.ToBytes(squared);
+    unsigned char one[Num3072::BYTE_SIZE];
+    Num3072().ToBytes(one);
+    BOOST_CHECK(memcmp(squared, one, sizeof(one)) == 0);
+
+    // A number divided by itself is one.
+    for (size_t i = 0; i < Num3072::BYTE_SIZE; i++)
+        data[i] = insecure_rand();
+    Num3072 x(data);
+    x.Divide(Num3072(data));
+    x.ToBytes(squared);
+    BOOST_CHECK(memcmp(squared, one, sizeof(one)) == 0);
+
+    // The hash of a set does not depend on the order of insertions and removals.
+    uint256 hashEmpty = FinalizeMuHash(MuHash3072());
+    uint256 hashSet;
+    for (int iter = 0; iter < 10; iter++) {
+        MuHash3072 muhash;
+        std::vector<int> order;
+        for (int i = 0; i < 4; i++)
+            order.push_back(insecure_rand() % 4);
+        for (int i = 0; i < 4; i++)
+            muhash.Insert(FromInt(order[i]).begin(), 32);
+        for (int i = 3; i >= 0; i--)
+            muhash.Insert(FromInt(4 + i).begin(), 32).Remove(FromInt(order[i]).begin(), 32);
+        uint256 hash = FinalizeMuHash(muhash);
+        if (iter == 0)
+            hashSet = hash;
+        BOOST_CHECK(hash == hashSet);
+    }
+    BOOST_CHECK(hashSet != hashEmpty);
+
+    // Removing what was inserted gives the empty set.
+    MuHash3072 muhash;
+    muhash.Insert(FromInt(0).begin(), 32).Insert(FromInt(1).begin(), 32);
+    muhash.Remove(FromInt(1).begin(), 32).Remove(FromInt(0).begin(), 32);
+    BOOST_CHECK(FinalizeMuHash(muhash) == hashEmpty);
+
+    // Combining sets is the same as inserting into and removing from one.
+    MuHash3072 set1, set2, combined;
+    set1.Insert(FromInt(0).begin(), 32).Insert(FromInt(1).begin(), 32);
+    set2.Insert(FromInt(2).begin(), 32).Remove(FromInt(1).begin(), 32);
+    combined.Insert(FromInt(0).begin(), 32).Insert(FromInt(2).begin(), 32);
+    set1 *= set2;
+    BOOST_CHECK(FinalizeMuHash(set1) == FinalizeMuHash(combined));
+
+    // The state survives a roundtrip.
+    unsigned char num[Num3072::BYTE_SIZE], den[Num3072::BYTE_SIZE];
+    set2.GetState(num, den);
+    MuHash3072 restored;
+    restored.SetState(num, den);
+    BOOST_CHECK(FinalizeMuHash(restored) == FinalizeMuHash(set2));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,73 @@
+// Copyright (c) 2026 The Junkcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "lrucache.h"
+
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(lrucache_tests, BasicTestingSetup)
+
+static CLRUCache<int>::value_ptr MakeValue(size_t nSize, unsigned char ch)
+{
+    return std::make_shared<const std::vector<unsigned char> >(nSize, ch);
+}
+
+BOOST_AUTO_TEST_CASE(lrucache_test)
+{
+    CLRUCache<int> cache(1 << 20);
+
+    // a miss is counted and returns null
+    BOOST_CHECK(!cache.Get(1));
+    cache.Insert(1, MakeValue(100, 1));
+    CLRUCache<int>::value_ptr value = cache.Get(1);
+    BOOST_CHECK(value && value->size() == 100 && (*value)[0] == 1);
+
+    // replacing an entry keeps a single copy
+    cache.Insert(1, MakeValue(200, 2));
+    value = cache.Get(1);
+    BOOST_CHECK(value && value->size() == 200 && (*value)[0] == 2);
+
+    CLRUCache<int>::Stats stats = cache.GetStats();
+    BOOST_CHECK_EQUAL(stats.nEntries, 1U);
+    BOOST_CHECK_EQUAL(stats.nHits, 2U);
+    BOOST_CHECK_EQUAL(stats.nMisses, 1U);
+
+    // shrink the cache so that it holds a bit more than 3 entries of 1000 bytes
+    cache.Clear();
+    cache.Insert(0, MakeValue(1000, 0));
+    const size_t nUsageWithEntry = cache.GetStats().nUsage;
+    cache.Erase(0);
+    const size_t nEntryUsage = nUsageWithEntry - cache.GetStats().nUsage;
+    cache.SetMaxUsage(nEntryUsage * 3 + nEntryUsage / 2);
+    for (int i = 0; i < 3; i++)
+        cache.Insert(i, MakeValue(1000, i));
+    BOOST_CHECK_EQUAL(cache.GetStats().nEntries, 3U);
+
+    // touching 0 makes 1 the least recently used entry
+    BOOST_CHECK(cache.Get(0));
+    cache.Insert(3, MakeValue(1000, 3));
+    BOOST_CHECK_EQUAL(cache.GetStats().nEntries, 3U);
+    BOOST_CHECK(cache.Get(0));
+    BOOST_CHECK(!cache.Get(1));
+    BOOST_CHECK(cache.Get(2));
+    BOOST_CHECK(cache.Get(3));
+
+    // an evicted value stays valid for whoever still holds it
+    value = cache.Get(2);
+    cache.Clear();
+    BOOST_CHECK(value && value->size() == 1000 && (*value)[0] == 2);
+
+    // values that do not fit in the whole cache are not kept
+    cache.Insert(4, MakeValue(nEntryUsage * 4, 4));
+    BOOST_CHECK(!cache.Get(4));
+    BOOST_CHECK_EQUAL(cache.GetStats().nEntries, 0U);
+
+    cache.Insert(5, MakeValue(1000, 5));
+    cache.Erase(5);
+    BOOST_CHECK(!cache.Get(5));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,139 @@
+// Copyright (c) 2026 The Junkcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "memusage.h"
+#include "support/allocators/pool.h"
+
+#include "test/test_bitcoin.h"
+#include "test/test_random.h"
+
+#include <stdint.h>
+
+#include <map>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/unordered_map.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(pool_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(pool_resource_blocks)
+{
+    PoolResource<64, 8> resource(1024);
+    BOOST_CHECK_EQUAL(resource.MaxChunkSizeBytes(), 1024U);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 0U);
+
+    // Blocks are carved out of the chunk one after the other.
+    void* a = resource.Allocate(8, 8);
+    void* b = resource.Allocate(8, 8);
+    BOOST_CHECK_EQUAL(static_cast<char*>(b) - static_cast<char*>(a), 8);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+
+    // A freed block is reused by the next allocation of that size only.
+    resource.Deallocate(a, 8, 8);
+    void* c = resource.Allocate(16, 8);
+    BOOST_CHECK(c != a);
+    void* d = resource.Allocate(5, 8);
+    BOOST_CHECK(d == a);
+
+    // Too large or too strictly aligned allocations do not come from the pool.
+    void* e = resource.Allocate(65, 8);
+    void* f = resource.Allocate(8, 16);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+    resource.Deallocate(e, 65, 8);
+    resource.Deallocate(f, 8, 16);
+
+    // Fill up the first chunk; the next one is only taken when needed.
+    std::vector<void*> vBlocks;
+    for (int i = 0; i < (1024 - 32) / 64; i++)
+        vBlocks.push_back(resource.Allocate(64, 8));
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+    vBlocks.push_back(resource.Allocate(64, 8));
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 2U);
+
+    // The unused end of the first chunk (32 bytes) was kept for later.
+    void* g = resource.Allocate(32, 8);
+    BOOST_CHECK_EQUAL(static_cast<char*>(g) - static_cast<char*>(a), 1024 - 32);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 2U);
+
+    for (size_t i = 0; i < vBlocks.size(); i++)
+        resource.Deallocate(vBlocks[i], 64, 8);
+    resource.Deallocate(b, 8, 8);
+    resource.Deallocate(c, 16, 8);
+    resource.Deallocate(d, 5, 8);
+    resource.Deallocate(g, 32, 8);
+}
+
+BOOST_AUTO_TEST_CASE(pool_resource_chunk_growth)
+{
+    PoolResource<64, 8> resource(4096, 1024);
+    BOOST_CHECK_EQUAL(resource.NewestChunkSizeBytes(), 0U);
+    BOOST_CHECK_EQUAL(resource.AllocatedBytes(), 0U);
+
+    // Each chunk is twice the size of the one before, up to the maximum.
+    std::vector<void*> vBlocks;
+    size_t nExpected = 0;
+    const size_t vChunkSizes[] = {1024, 2048, 4096, 4096};
+    for (size_t i = 0; i < 4; i++) {
+        for (size_t j = 0; j < vChunkSizes[i] / 64; j++)
+            vBlocks.push_back(resource.Allocate(64, 8));
+        nExpected += vChunkSizes[i];
+        BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), i + 1);
+        BOOST_CHECK_EQUAL(resource.NewestChunkSizeBytes(), vChunkSizes[i]);
+        BOOST_CHECK_EQUAL(resource.AllocatedBytes(), nExpected);
+    }
+    for (size_t i = 0; i < vBlocks.size(); i++)
+        resource.Deallocate(vBlocks[i], 64, 8);
+
+    // Chunks always hold at least one block of the largest size.
+    PoolResource<64, 8> tiny(8, 8);
+    BOOST_CHECK(tiny.MaxChunkSizeBytes() >= 64);
+    void* p = tiny.Allocate(64, 8);
+    BOOST_CHECK_EQUAL(tiny.NumAllocatedChunks(), 1U);
+    tiny.Deallocate(p, 64, 8);
+}
+
+BOOST_AUTO_TEST_CASE(pool_allocator_map)
+{
+    typedef PoolAllocator<std::pair<const uint64_t, uint64_t>, 64, 8> Allocator;
+    typedef boost::unordered_map<uint64_t, uint64_t, boost::hash<uint64_t>, std::equal_to<uint64_t>, Allocator> Map;
+
+    Map map;
+    std::map<uint64_t, uint64_t> expected;
+    for (int i = 0; i < 10000; i++) {
+        uint64_t key = insecure_rand() % 5000;
+        if (insecure_rand() % 4 == 0) {
+            BOOST_CHECK_EQUAL(map.erase(key), expected.erase(key));
+        } else {
+            map[key] = i;
+            expected[key] = i;
+        }
+    }
+    BOOST_CHECK_EQUAL(map.size(), expected.size());
+    for (std::map<uint64_t, uint64_t>::const_iterator it = expected.begin(); it != expected.end(); it++)
+        BOOST_CHECK(map.count(it->first) && map[it->first] == it->second);
+    size_t nChunks = map.get_allocator().GetResource().NumAllocatedChunks();
+    BOOST_CHECK(nChunks > 0);
+    BOOST_CHECK(memusage::DynamicUsage(map) >= map.get_allocator().GetResource().AllocatedBytes());
+
+    // A copy gets a pool of its own.
+    Map copy(map);
+    BOOST_CHECK(copy.get_allocator() != map.get_allocator());
+    BOOST_CHECK(copy == map);
+
+    // Swapping takes the pool along with the elements.
+    Map other;
+    Allocator alloc = map.get_allocator();
+    other.swap(map);
+    BOOST_CHECK(other.get_allocator() == alloc);
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK(other == copy);
+    map[1] = 2;
+    BOOST_CHECK_EQUAL(map.get_allocator().GetResource().NumAllocatedChunks(), 1U);
+
+    // A map with a few elements only has a small chunk.
+    BOOST_CHECK(memusage::DynamicUsage(map) <= 2048);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
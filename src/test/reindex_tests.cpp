@@ -0,0 +1,79 @@
+// Copyright (c) 2026 The Junkcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chainparams.h"
+#include "consensus/merkle.h"
+#include "primitives/block.h"
+#include "reindex.h"
+#include "validation.h"
+#include "test/test_bitcoin.h"
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(reindex_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(reindex_reader_order)
+{
+    const CChainParams& chainparams = Params();
+
+    // Files 1 to 3 hold 3, 2 and 1 made up blocks; file 4 is missing, so
+    // file 5 is never reached. File 0 holds the genesis block.
+    std::vector<std::vector<uint256> > vHashes(6);
+    std::vector<std::vector<CDiskBlockPos> > vPos(6);
+    int nBlock = 0;
+    for (int nFile = 1; nFile <= 5; nFile++) {
+        if (nFile == 4)
+            continue;
+        unsigned int nPos = 0;
+        for (int i = 0; i < (nFile == 5 ? 1 : 4 - nFile); i++) {
+            CBlock block;
+            CMutableTransaction tx;
+            tx.vin.resize(1);
+            tx.vin[0].scriptSig = CScript() << nBlock++ << OP_0;
+            tx.vout.resize(1);
+            block.vtx.push_back(MakeTransactionRef(std::move(tx)));
+            block.hashMerkleRoot = BlockMerkleRoot(block);
+
+            CDiskBlockPos pos(nFile, nPos);
+            BOOST_CHECK(WriteBlockToDisk(block, pos, chainparams.MessageStart()));
+            nPos = pos.nPos + ::GetSerializeSize(block, SER_DISK, CLIENT_VERSION);
+            vHashes[nFile].push_back(block.GetHash());
+            vPos[nFile].push_back(pos);
+        }
+    }
+
+    CReindexReader reader(chainparams, 2, DEFAULT_REINDEX_READAHEAD << 20);
+    std::vector<CReindexReader::Block> vBlocks;
+
+    BOOST_CHECK(reader.Take(0, vBlocks));
+    BOOST_CHECK_EQUAL(vBlocks.size(), 1U);
+    BOOST_CHECK(vBlocks[0].pblock->GetHash() == chainparams.GetConsensus(0).hashGenesisBlock);
+    // The genesis block passes the context-free checks...
+    BOOST_CHECK(vBlocks[0].pblock->fChecked);
+
+    for (int nFile = 1; nFile <= 3; nFile++) {
+        BOOST_CHECK(reader.Take(nFile, vBlocks));
+        BOOST_CHECK_EQUAL(vBlocks.size(), vHashes[nFile].size());
+        for (size_t i = 0; i < vBlocks.size() && i < vHashes[nFile].size(); i++) {
+            BOOST_CHECK(vBlocks[i].pblock->GetHash() == vHashes[nFile][i]);
+            BOOST_CHECK(vBlocks[i].pos == vPos[nFile][i]);
+            // ...and these, without any proof of work, do not.
+            BOOST_CHECK(!vBlocks[i].pblock->fChecked);
+        }
+    }
+
+    BOOST_CHECK(!reader.Take(4, vBlocks));
+
+    // With no room to read ahead, the next file to be taken is still read.
+    CReindexReader readerNoAhead(chainparams, 2, 0);
+    for (int nFile = 0; nFile <= 3; nFile++) {
+        BOOST_CHECK(readerNoAhead.Take(nFile, vBlocks));
+        BOOST_CHECK_EQUAL(vBlocks.size(), nFile == 0 ? 1U : vHashes[nFile].size());
+    }
+    BOOST_CHECK(!readerNoAhead.Take(4, vBlocks));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -32,4 +32,35 @@ BOOST_AUTO_TEST_CASE(scrypt_hashtest)
     }
 }
 
+BOOST_AUTO_TEST_CASE(scrypt_multi_hashtest)
+{
+    // Batches of every size up to a few full passes must match the single-lane
+    // hash, so lane interleaving and the tail handling are both covered.
+    const int lanes = scrypt_multi_lanes();
+    const size_t count = 3 * lanes + 3;
+    std::vector<char> input(80 * count);
+    for (size_t i = 0; i < input.size(); i++)
+        input[i] = (char)(i * 7 + (i >> 8));
+
+    std::vector<uint256> expected(count);
+    for (size_t i = 0; i < count; i++)
+        scrypt_1024_1_1_256(&input[80 * i], BEGIN(expected[i]));
+
+    for (size_t n = 1; n <= count; n++) {
+        std::vector<uint256> hashes(n);
+        scrypt_1024_1_1_256_multi(&input[0], BEGIN(hashes[0]), n);
+        for (size_t i = 0; i < n; i++)
+            BOOST_CHECK_EQUAL(hashes[i].ToString(), expected[i].ToString());
+    }
+
+#if defined(__GNUC__)
+    // The portable 4-way kernel is always built, test it regardless of the CPU.
+    std::vector<char> scratchpad(scrypt_multi_scratchpad_size(4));
+    uint256 hashes[4];
+    scrypt_1024_1_1_256_sp_4way(&input[0], BEGIN(hashes[0]), &scratchpad[0]);
+    for (int i = 0; i < 4; i++)
+        BOOST_CHECK_EQUAL(hashes[i].ToString(), expected[i].ToString());
+#endif
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -143,4 +143,80 @@ BOOST_AUTO_TEST_CASE(findearliestatleast_test)
         BOOST_CHECK(vBlocksMain[r].GetAncestor(ret->nHeight) == ret);
     }
 }
+BOOST_AUTO_TEST_CASE(blockindex_arena_test)
+{
+    CBlockIndexArena arena;
+    BOOST_CHECK_EQUAL(arena.size(), 0U);
+
+    // Build a chain well past the first chunk; earlier entries must not move.
+    std::vector<CBlockIndex*> vIndex;
+    for (int i = 0; i < 10000; i++) {
+        CBlockIndex* pindex = arena.Allocate();
+        BOOST_CHECK(pindex->pprev == NULL && pindex->nHeight == 0 && pindex->nChainWork == 0);
+        pindex->pprev = vIndex.empty() ? NULL : vIndex.back();
+        pindex->nHeight = i;
+        pindex->BuildSkip();
+        vIndex.push_back(pindex);
+    }
+    BOOST_CHECK_EQUAL(arena.size(), 10000U);
+    for (int i = 1; i < 10000; i++) {
+        BOOST_CHECK(vIndex[i]->pprev == vIndex[i - 1]);
+        BOOST_CHECK_EQUAL(vIndex[i]->nHeight, i);
+    }
+    for (int i = 0; i < 1000; i++) {
+        int from = insecure_rand() % 10000;
+        int to = insecure_rand() % (from + 1);
+        BOOST_CHECK(vIndex[from]->GetAncestor(to) == vIndex[to]);
+    }
+
+    arena.Clear();
+    BOOST_CHECK_EQUAL(arena.size(), 0U);
+    BOOST_CHECK_EQUAL(arena.Allocate()->nHeight, 0);
+    BOOST_CHECK_EQUAL(arena.size(), 1U);
+}
+
+BOOST_AUTO_TEST_CASE(chaintip_test)
+{
+    // A main chain of 1000 blocks and a branch off block 499 of 600 blocks.
+    std::vector<CBlockIndex> vBlocksMain(1000);
+    for (unsigned int i=0; i<vBlocksMain.size(); i++) {
+        vBlocksMain[i].nHeight = i;
+        vBlocksMain[i].pprev = i ? &vBlocksMain[i - 1] : NULL;
+        vBlocksMain[i].BuildSkip();
+    }
+    std::vector<CBlockIndex> vBlocksSide(600);
+    for (unsigned int i=0; i<vBlocksSide.size(); i++) {
+        vBlocksSide[i].nHeight = i + 500;
+        vBlocksSide[i].pprev = i ? &vBlocksSide[i - 1] : &vBlocksMain[499];
+        vBlocksSide[i].BuildSkip();
+    }
+
+    CChain chain;
+    chain.SetTip(&vBlocksMain.back());
+    CChainTip snapshot(chain.Tip());
+    BOOST_CHECK(snapshot.Tip() == chain.Tip());
+    BOOST_CHECK_EQUAL(snapshot.Height(), chain.Height());
+    BOOST_CHECK(snapshot[-1] == NULL);
+    BOOST_CHECK(snapshot[chain.Height() + 1] == NULL);
+    for (int n=0; n<1000; n++) {
+        int r = insecure_rand() % 1600;
+        const CBlockIndex* pindex = (r < 1000) ? &vBlocksMain[r] : &vBlocksSide[r - 1000];
+        BOOST_CHECK(snapshot[pindex->nHeight] == chain[pindex->nHeight]);
+        BOOST_CHECK_EQUAL(snapshot.Contains(pindex), chain.Contains(pindex));
+        BOOST_CHECK(snapshot.Next(pindex) == chain.Next(pindex));
+    }
+
+    // The snapshot keeps its view when the chain moves to the branch.
+    chain.SetTip(&vBlocksSide.back());
+    BOOST_CHECK(snapshot.Contains(&vBlocksMain[999]));
+    BOOST_CHECK(!snapshot.Contains(&vBlocksSide[0]));
+    BOOST_CHECK_EQUAL(snapshot.Height(), 999);
+
+    CChainTip empty(NULL);
+    BOOST_CHECK(empty.Tip() == NULL);
+    BOOST_CHECK_EQUAL(empty.Height(), -1);
+    BOOST_CHECK(empty[0] == NULL);
+    BOOST_CHECK(!empty.Contains(&vBlocksMain[0]));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
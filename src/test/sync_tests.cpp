@@ -0,0 +1,107 @@
+// Copyright (c) 2026 The Junkcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "sync.h"
+#include "utiltime.h"
+#include "test/test_bitcoin.h"
+
+#include <string.h>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+namespace
+{
+//! The first site of the lock in this file
+const CLockSite* FindLockSite(const char* pszName)
+{
+    const CLockSite* pfound = NULL;
+    for (const CLockSite* psite : GetLockSites())
+        if (strcmp(psite->pszName, pszName) == 0 && (!pfound || psite->nLine < pfound->nLine))
+            pfound = psite;
+    return pfound;
+}
+
+uint64_t HistogramCount(const std::atomic<uint64_t>* vHistogram)
+{
+    uint64_t nCount = 0;
+    for (int i = 0; i < LOCK_STATS_BUCKETS; i++)
+        nCount += vHistogram[i];
+    return nCount;
+}
+}
+
+BOOST_FIXTURE_TEST_SUITE(sync_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(lockstats_sites)
+{
+    CCriticalSection cs_lockstats_test;
+    for (int i = 0; i < 2; i++) {
+        // Not recorded the first time, recorded the second.
+        fLockStats = i == 1;
+        LOCK(cs_lockstats_test);
+        {
+            TRY_LOCK(cs_lockstats_test, lockTry);
+            BOOST_CHECK(bool(lockTry));
+        }
+    }
+    fLockStats = DEFAULT_LOCK_STATS;
+
+    const CLockSite* psite = FindLockSite("cs_lockstats_test");
+    BOOST_REQUIRE(psite);
+    BOOST_CHECK_EQUAL(psite->nAcquired.load(), 1U);
+    BOOST_CHECK_EQUAL(psite->nContended.load(), 0U);
+    BOOST_CHECK_EQUAL(HistogramCount(psite->vWaitHistogram), 1U);
+    BOOST_CHECK_EQUAL(HistogramCount(psite->vHoldHistogram), 1U);
+    BOOST_CHECK(strstr(psite->pszFile, "sync_tests.cpp"));
+
+    // TRY_LOCK is a site of its own.
+    const CLockSite* psiteTry = GetLockSite("cs_lockstats_test", psite->pszFile, psite->nLine + 2);
+    BOOST_CHECK(psiteTry != psite);
+    BOOST_CHECK_EQUAL(psiteTry->nAcquired.load(), 1U);
+    BOOST_CHECK(GetLockSite("cs_lockstats_test", psite->pszFile, psite->nLine) == psite);
+
+    // A header locking in several translation units is one site, even though
+    // each of them has a __FILE__ string of its own.
+    std::string strFile(psite->pszFile);
+    BOOST_CHECK(GetLockSite("cs_lockstats_test", strFile.c_str(), psite->nLine) == psite);
+
+    // The macros look their site up once and keep it.
+    std::atomic<CLockSite*> cache(nullptr);
+    BOOST_CHECK(GetCachedLockSite(&cache, "cs_lockstats_test", psite->pszFile, psite->nLine) == psite);
+    BOOST_CHECK(cache.load() == psite);
+    BOOST_CHECK(GetCachedLockSite(&cache, "cs_lockstats_test", psite->pszFile, psite->nLine + 2) == psite);
+}
+
+BOOST_AUTO_TEST_CASE(lockstats_contention)
+{
+    CCriticalSection cs_lockstats_contended;
+    fLockStats = true;
+    boost::thread thread;
+    {
+        LOCK(cs_lockstats_contended);
+        thread = boost::thread([&cs_lockstats_contended] {
+            LOCK(cs_lockstats_contended);
+        });
+        MilliSleep(50);
+    }
+    thread.join();
+    fLockStats = DEFAULT_LOCK_STATS;
+
+    uint64_t nAcquired = 0, nContended = 0, nWaitMicros = 0, nHoldMicros = 0;
+    for (const CLockSite* psite : GetLockSites()) {
+        if (strcmp(psite->pszName, "cs_lockstats_contended") != 0)
+            continue;
+        nAcquired += psite->nAcquired;
+        nContended += psite->nContended;
+        nWaitMicros += psite->nWaitMicros;
+        nHoldMicros += psite->nHoldMicros;
+    }
+    BOOST_CHECK_EQUAL(nAcquired, 2U);
+    BOOST_CHECK_EQUAL(nContended, 1U);
+    BOOST_CHECK(nWaitMicros >= 40000);
+    BOOST_CHECK(nHoldMicros >= 40000);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
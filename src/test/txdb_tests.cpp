@@ -0,0 +1,95 @@
+// Copyright (c) 2026 The Junkcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chain.h"
+#include "random.h"
+#include "txdb.h"
+#include "test/test_bitcoin.h"
+#include "test/test_random.h"
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+/** Stand-in for mapBlockIndex */
+struct CBlockIndexMapTest
+{
+    std::map<uint256, CBlockIndex*> mapIndex;
+    CBlockIndexArena arena;
+
+    CBlockIndex* Insert(const uint256& hash)
+    {
+        if (hash.IsNull())
+            return NULL;
+        std::map<uint256, CBlockIndex*>::iterator it = mapIndex.find(hash);
+        if (it != mapIndex.end())
+            return it->second;
+        CBlockIndex* pindex = arena.Allocate();
+        pindex->phashBlock = &mapIndex.insert(std::make_pair(hash, pindex)).first->first;
+        return pindex;
+    }
+};
+}
+
+BOOST_FIXTURE_TEST_SUITE(txdb_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(load_block_index_threads)
+{
+    CBlockTreeDB blocktree(1 << 20, true);
+
+    // A chain with a fork, and random fields to check they are carried over.
+    std::vector<uint256> vHashes(600);
+    std::vector<CBlockIndex> vIndex(600);
+    for (int i = 0; i < 600; i++) {
+        int nPrev = i == 500 ? 399 : i - 1;
+        CBlockHeader header;
+        header.nVersion = 1 + insecure_rand() % 4;
+        header.hashPrevBlock = nPrev < 0 ? uint256() : vHashes[nPrev];
+        header.hashMerkleRoot = GetRandHash();
+        header.nTime = insecure_rand();
+        header.nBits = 0x1d00ffff - (insecure_rand() % 0x10000);
+        header.nNonce = insecure_rand();
+        vHashes[i] = header.GetHash();
+        vIndex[i] = CBlockIndex(header);
+        vIndex[i].phashBlock = &vHashes[i];
+        vIndex[i].pprev = nPrev < 0 ? NULL : &vIndex[nPrev];
+        vIndex[i].nHeight = nPrev + 1;
+        vIndex[i].nTx = 1 + insecure_rand() % 100;
+        vIndex[i].nStatus = BLOCK_VALID_TREE | BLOCK_HAVE_DATA;
+        vIndex[i].nFile = i / 100;
+        vIndex[i].nDataPos = insecure_rand();
+    }
+    std::vector<const CBlockIndex*> vWrite;
+    for (size_t i = 0; i < vIndex.size(); i++)
+        vWrite.push_back(&vIndex[i]);
+    CBlockFileInfo info;
+    std::vector<std::pair<int, const CBlockFileInfo*> > vFiles(1, std::make_pair(0, &info));
+    BOOST_CHECK(blocktree.WriteBatchSync(vFiles, 0, vWrite));
+
+    for (int nThreads = 1; nThreads <= 4; nThreads += 3) {
+        CBlockIndexMapTest test;
+        BOOST_CHECK(blocktree.LoadBlockIndexGuts(boost::bind(&CBlockIndexMapTest::Insert, &test, _1), nThreads));
+        BOOST_CHECK_EQUAL(test.mapIndex.size(), vIndex.size());
+        for (size_t i = 0; i < vIndex.size(); i++) {
+            const CBlockIndex* pindex = test.mapIndex[vHashes[i]];
+            BOOST_CHECK(pindex->GetBlockHash() == vHashes[i]);
+            BOOST_CHECK(vIndex[i].pprev ? pindex->pprev->GetBlockHash() == vIndex[i].pprev->GetBlockHash() : pindex->pprev == NULL);
+            BOOST_CHECK_EQUAL(pindex->nHeight, vIndex[i].nHeight);
+            BOOST_CHECK_EQUAL(pindex->nTx, vIndex[i].nTx);
+            BOOST_CHECK_EQUAL(pindex->nStatus, vIndex[i].nStatus);
+            BOOST_CHECK_EQUAL(pindex->nFile, vIndex[i].nFile);
+            BOOST_CHECK_EQUAL(pindex->nDataPos, vIndex[i].nDataPos);
+            BOOST_CHECK_EQUAL(pindex->nBits, vIndex[i].nBits);
+            // Only the work of the block itself; the caller adds it up.
+            BOOST_CHECK(pindex->nChainWork == GetBlockProof(vIndex[i]));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,165 @@
+// Copyright (c) 2026 The Junkcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chain.h"
+#include "coins.h"
+#include "init.h"
+#include "random.h"
+#include "txdb.h"
+#include "utxocommitment.h"
+#include "utxosnapshot.h"
+#include "validation.h"
+#include "test/test_bitcoin.h"
+#include "test/test_random.h"
+
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+struct SnapshotSetup : public TestingSetup {
+    uint256 hashBase;
+    CBlockIndex* pindexBase;
+    std::vector<COutPoint> vOutPoints;
+    std::vector<Coin> vCoins;
+
+    SnapshotSetup()
+    {
+        // A header on top of genesis, of which we never get the block.
+        LOCK(cs_main);
+        hashBase = GetRandHash();
+        pindexBase = InsertBlockIndex(hashBase);
+        pindexBase->pprev = chainActive.Genesis();
+        pindexBase->nHeight = 1;
+        pindexBase->nChainTx = 1 + 20;
+        pindexBase->nStatus = BLOCK_VALID_TREE;
+        pindexBase->BuildSkip();
+        pindexBestHeader = pindexBase;
+
+        for (int i = 0; i < 200; i++) {
+            CTxOut txout;
+            txout.nValue = insecure_rand() % 1000000;
+            txout.scriptPubKey.assign(1 + (insecure_rand() & 0x3F), OP_TRUE);
+            // Several outputs of the same transaction, out of order
+            uint256 txid = vOutPoints.empty() || insecure_rand() % 3 ? GetRandHash() : vOutPoints.back().hash;
+            vOutPoints.push_back(COutPoint(txid, insecure_rand() % 1000));
+            vCoins.push_back(Coin(txout, insecure_rand() % 2, insecure_rand() & 1));
+        }
+    }
+
+    /** Give pcoinsTip the coins, at pindexBase, as if it had been connected. */
+    void AddCoins()
+    {
+        LOCK(cs_main);
+        for (size_t i = 0; i < vOutPoints.size(); i++) {
+            if (!pcoinsTip->HaveCoin(vOutPoints[i])) {
+                pcoinsTip->AddCoin(vOutPoints[i], Coin(vCoins[i]), false);
+                utxoCommitment.Add(vOutPoints[i], vCoins[i]);
+            }
+        }
+        pcoinsTip->SetBestBlock(hashBase);
+        utxoCommitment.hashBlock = hashBase;
+    }
+
+    /** Start over with an empty coins database at genesis. */
+    void ResetCoins()
+    {
+        LOCK(cs_main);
+        delete pcoinsTip;
+        delete pcoinsdbview;
+        pcoinsdbview = new CCoinsViewDB(1 << 23, true);
+        LoadUTXOCommitment(pcoinsdbview);
+        pcoinsTip = new CCoinsViewCache(pcoinsdbview);
+        pcoinsTip->SetBestBlock(chainActive.Genesis()->GetBlockHash());
+        utxoCommitment.hashBlock = chainActive.Genesis()->GetBlockHash();
+    }
+};
+
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(utxosnapshot_tests, SnapshotSetup)
+
+BOOST_AUTO_TEST_CASE(utxosnapshot_roundtrip)
+{
+    AddCoins();
+    uint256 hashUTXOSet = utxoCommitment.GetHash();
+    uint64_t nCoins = utxoCommitment.nTransactionOutputs;
+
+    boost::filesystem::path path = pathTemp / "utxo.dat";
+    CUTXOSnapshotHeader header;
+    std::string strError;
+    BOOST_CHECK(DumpUTXOSnapshot(path, header, strError));
+    BOOST_CHECK(header.hashBlock == hashBase);
+    BOOST_CHECK_EQUAL(header.nHeight, 1);
+    BOOST_CHECK_EQUAL(header.nChainTx, 21U);
+    BOOST_CHECK_EQUAL(header.nTransactionOutputs, nCoins);
+    BOOST_CHECK(header.hashUTXOSet == hashUTXOSet);
+
+    ResetCoins();
+
+    // Nothing is loaded before the headers are synced up to the snapshot's block.
+    CUTXOSnapshotHeader headerLoaded;
+    pindexBestHeader = chainActive.Genesis();
+    BOOST_CHECK(!LoadUTXOSnapshot(path, headerLoaded, strError));
+    BOOST_CHECK(!ShutdownRequested());
+    pindexBestHeader = pindexBase;
+
+    // Load in many small batches.
+    size_t nCoinCacheUsageOld = nCoinCacheUsage;
+    nCoinCacheUsage = 1;
+    BOOST_CHECK_MESSAGE(LoadUTXOSnapshot(path, headerLoaded, strError), strError);
+    nCoinCacheUsage = nCoinCacheUsageOld;
+
+    LOCK(cs_main);
+    BOOST_CHECK(chainActive.Tip() == pindexBase);
+    BOOST_CHECK(pindexSnapshotBase == pindexBase);
+    BOOST_CHECK_EQUAL(pindexBase->nChainTx, 21U);
+    BOOST_CHECK(pcoinsTip->GetBestBlock() == hashBase);
+    BOOST_CHECK(utxoCommitment.hashBlock == hashBase);
+    BOOST_CHECK(utxoCommitment.GetHash() == hashUTXOSet);
+    for (size_t i = 0; i < vOutPoints.size(); i++)
+        BOOST_CHECK(pcoinsTip->HaveCoin(vOutPoints[i]));
+
+    // The coins database holds the set and its commitment.
+    CUTXOCommitment commitmentStored;
+    BOOST_CHECK(pcoinsdbview->ReadCommitment(commitmentStored));
+    BOOST_CHECK(commitmentStored.GetHash() == hashUTXOSet);
+    bool fLoading = true;
+    BOOST_CHECK(pblocktree->ReadFlag("utxosnapshotloading", fLoading));
+    BOOST_CHECK(!fLoading);
+}
+
+BOOST_AUTO_TEST_CASE(utxosnapshot_corrupt)
+{
+    AddCoins();
+    boost::filesystem::path path = pathTemp / "utxo.dat";
+    CUTXOSnapshotHeader header;
+    std::string strError;
+    BOOST_CHECK(DumpUTXOSnapshot(path, header, strError));
+    ResetCoins();
+
+    // Flip a byte in the coins; the file is rejected before anything is written.
+    FILE* file = fopen(path.string().c_str(), "r+b");
+    BOOST_REQUIRE(file);
+    fseek(file, 200, SEEK_SET);
+    int ch = fgetc(file);
+    fseek(file, 200, SEEK_SET);
+    fputc(ch ^ 1, file);
+    fclose(file);
+
+    CUTXOSnapshotHeader headerLoaded;
+    BOOST_CHECK(!LoadUTXOSnapshot(path, headerLoaded, strError));
+    BOOST_CHECK(!ShutdownRequested());
+
+    LOCK(cs_main);
+    BOOST_CHECK_EQUAL(chainActive.Height(), 0);
+    for (size_t i = 0; i < vOutPoints.size(); i++)
+        BOOST_CHECK(!pcoinsTip->HaveCoin(vOutPoints[i]));
+    bool fLoading = false;
+    BOOST_CHECK(!pblocktree->ReadFlag("utxosnapshotloading", fLoading) || !fLoading);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -5,36 +5,143 @@
 
 #include "txdb.h"
 
+#include "auxpow.h"
 #include "chainparams.h"
 #include "hash.h"
+#include "init.h"
 #include "pow.h"
 #include "uint256.h"
+#include "ui_interface.h"
+#include "util.h"
+#include "utxocommitment.h"
 
 #include <stdint.h>
 
+#include <atomic>
+
+#include <boost/bind.hpp>
 #include <boost/thread.hpp>
 
+static const char DB_COIN = 'C';
 static const char DB_COINS = 'c';
 static const char DB_BLOCK_FILES = 'f';
 static const char DB_TXINDEX = 't';
 static const char DB_BLOCK_INDEX = 'b';
+static const char DB_BLOCK_AUXPOW = 'a';
 
 static const char DB_BEST_BLOCK = 'B';
+static const char DB_UTXO_COMMITMENT = 'M';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
+static const char DB_SNAPSHOT_BASE = 'S';
+
+namespace {
 
+struct CoinEntry {
+    COutPoint* outpoint;
+    char key;
+    CoinEntry(const COutPoint* ptr) : outpoint(const_cast<COutPoint*>(ptr)), key(DB_COIN)  {}
+
+    template<typename Stream>
+    void Serialize(Stream &s) const {
+        s << key;
+        s << outpoint->hash;
+        s << VARINT(outpoint->n);
+    }
 
-CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true) 
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        s >> key;
+        s >> outpoint->hash;
+        s >> VARINT(outpoint->n);
+    }
+};
+
+/**
+ * Legacy per-transaction UTXO record, only kept to upgrade old databases.
+ *
+ * Serialized format:
+ * - VARINT(nVersion)
+ * - VARINT(nCode)
+ * - unspentness bitvector, for vout[2] and further; least significant byte first
+ * - the non-spent CTxOuts (via CTxOutCompressor)
+ * - VARINT(nHeight)
+ *
+ * The nCode value consists of:
+ * - bit 0: IsCoinBase()
+ * - bit 1: vout[0] is not spent
+ * - bit 2: vout[1] is not spent
+ * - The higher bits encode N, the number of non-zero bytes in the following bitvector.
+ *   - In case both bit 1 and bit 2 are unset, they encode N-1, as there must be at
+ *     least one non-spent output).
+ */
+class CCoins
 {
+public:
+    //! whether transaction is a coinbase
+    bool fCoinBase;
+
+    //! unspent transaction outputs; spent outputs are .IsNull()
+    std::vector<CTxOut> vout;
+
+    //! at which height this transaction was included in the active block chain
+    int nHeight;
+
+    //! empty constructor
+    CCoins() : fCoinBase(false), vout(0), nHeight(0) { }
+
+    template<typename Stream>
+    void Unserialize(Stream &s) {
+        unsigned int nCode = 0;
+        // version
+        int nVersionDummy;
+        ::Unserialize(s, VARINT(nVersionDummy));
+        // header code
+        ::Unserialize(s, VARINT(nCode));
+        fCoinBase = nCode & 1;
+        std::vector<bool> vAvail(2, false);
+        vAvail[0] = (nCode & 2) != 0;
+        vAvail[1] = (nCode & 4) != 0;
+        unsigned int nMaskCode = (nCode / 8) + ((nCode & 6) != 0 ? 0 : 1);
+        // spentness bitmask
+        while (nMaskCode > 0) {
+            unsigned char chAvail = 0;
+            ::Unserialize(s, chAvail);
+            for (unsigned int p = 0; p < 8; p++) {
+                bool f = (chAvail & (1 << p)) != 0;
+                vAvail.push_back(f);
+            }
+            if (chAvail != 0)
+                nMaskCode--;
+        }
+        // txouts themself
+        vout.assign(vAvail.size(), CTxOut());
+        for (unsigned int i = 0; i < vAvail.size(); i++) {
+            if (vAvail[i])
+                ::Unserialize(s, REF(CTxOutCompressor(vout[i])));
+        }
+        // coinbase height
+        ::Unserialize(s, VARINT(nHeight));
+    }
+};
+
+}
+
+CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true), pcommitment(NULL)
+{
+}
+
+bool CCoinsViewDB::GetCoin(const COutPoint &outpoint, Coin &coin) const {
+    return db.Read(CoinEntry(&outpoint), coin);
 }
 
-bool CCoinsViewDB::GetCoins(const uint256 &txid, CCoins &coins) const {
-    return db.Read(std::make_pair(DB_COINS, txid), coins);
+bool CCoinsViewDB::HaveCoin(const COutPoint &outpoint) const {
+    return db.Exists(CoinEntry(&outpoint));
 }
 
-bool CCoinsViewDB::HaveCoins(const uint256 &txid) const {
-    return db.Exists(std::make_pair(DB_COINS, txid));
+bool CCoinsViewDB::ReadCommitment(CUTXOCommitment& commitment) const {
+    return db.Read(DB_UTXO_COMMITMENT, commitment) && commitment.hashBlock == GetBestBlock();
 }
 
 uint256 CCoinsViewDB::GetBestBlock() const {
@@ -48,25 +155,100 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     CDBBatch batch(db);
     size_t count = 0;
     size_t changed = 0;
-    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
+    // mapCoins is left alone: CCoinsViewFlusher keeps serving lookups from
+    // it until the batch is committed.
+    for (CCoinsMap::const_iterator it = mapCoins.begin(); it != mapCoins.end(); it++) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) {
-            if (it->second.coins.IsPruned())
-                batch.Erase(std::make_pair(DB_COINS, it->first));
+            CoinEntry entry(&it->first);
+            if (it->second.coin.IsSpent())
+                batch.Erase(entry);
             else
-                batch.Write(std::make_pair(DB_COINS, it->first), it->second.coins);
+                batch.Write(entry, it->second.coin);
             changed++;
         }
         count++;
-        CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
     }
-    if (!hashBlock.IsNull())
+    if (!hashBlock.IsNull()) {
         batch.Write(DB_BEST_BLOCK, hashBlock);
+        // Never leave a commitment behind that belongs to another block.
+        if (pcommitment && pcommitment->hashBlock == hashBlock)
+            batch.Write(DB_UTXO_COMMITMENT, *pcommitment);
+        else
+            batch.Erase(DB_UTXO_COMMITMENT);
+    }
 
-    LogPrint("coindb", "Committing %u changed transactions (out of %u) to coin database...\n", (unsigned int)changed, (unsigned int)count);
+    LogPrint("coindb", "Committing %u changed transaction outputs (out of %u) to coin database...\n", (unsigned int)changed, (unsigned int)count);
     return db.WriteBatch(batch);
 }
 
+/** Upgrade the database from older formats.
+ *
+ * Currently implemented: from the per-tx utxo model (0.8..0.14.x) to per-txout.
+ */
+bool CCoinsViewDB::Upgrade() {
+    std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
+    pcursor->Seek(std::make_pair(DB_COINS, uint256()));
+    if (!pcursor->Valid()) {
+        return true;
+    }
+
+    int64_t count = 0;
+    LogPrintf("Upgrading utxo-set database...\n");
+    LogPrintf("[0%%]...");
+    uiInterface.ShowProgress(_("Upgrading UTXO database"), 0);
+    size_t batch_size = 1 << 24;
+    CDBBatch batch(db);
+    int reportDone = 0;
+    std::pair<unsigned char, uint256> key;
+    std::pair<unsigned char, uint256> prev_key = std::make_pair((unsigned char)DB_COINS, uint256());
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        if (ShutdownRequested()) {
+            break;
+        }
+        if (pcursor->GetKey(key) && key.first == DB_COINS) {
+            if (count++ % 256 == 0) {
+                uint32_t high = 0x100 * *key.second.begin() + *(key.second.begin() + 1);
+                int percentageDone = (int)(high * 100.0 / 65536.0 + 0.5);
+                uiInterface.ShowProgress(_("Upgrading UTXO database"), percentageDone);
+                if (reportDone < percentageDone/10) {
+                    // report max. every 10% step
+                    LogPrintf("[%d%%]...", percentageDone);
+                    reportDone = percentageDone/10;
+                }
+            }
+            CCoins old_coins;
+            if (!pcursor->GetValue(old_coins)) {
+                return error("%s: cannot parse CCoins record", __func__);
+            }
+            COutPoint outpoint(key.second, 0);
+            for (size_t i = 0; i < old_coins.vout.size(); ++i) {
+                if (!old_coins.vout[i].IsNull() && !old_coins.vout[i].scriptPubKey.IsUnspendable()) {
+                    Coin newcoin(std::move(old_coins.vout[i]), old_coins.nHeight, old_coins.fCoinBase);
+                    outpoint.n = i;
+                    CoinEntry entry(&outpoint);
+                    batch.Write(entry, newcoin);
+                }
+            }
+            batch.Erase(key);
+            if (batch.SizeEstimate() > batch_size) {
+                db.WriteBatch(batch);
+                batch.Clear();
+                db.CompactRange(prev_key, key);
+                prev_key = key;
+            }
+            pcursor->Next();
+        } else {
+            break;
+        }
+    }
+    db.WriteBatch(batch);
+    db.CompactRange(std::make_pair((unsigned char)DB_COINS, uint256()), key);
+    uiInterface.ShowProgress("", 100);
+    LogPrintf("[%s].\n", ShutdownRequested() ? "CANCELLED" : "DONE");
+    return !ShutdownRequested();
+}
+
 CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe) {
 }
 
@@ -90,35 +272,50 @@ bool CBlockTreeDB::ReadLastBlockFile(int &nFile) {
     return Read(DB_LAST_BLOCK, nFile);
 }
 
+bool CBlockTreeDB::WriteSnapshotBase(const uint256 &hash, unsigned int nChainTx) {
+    return Write(DB_SNAPSHOT_BASE, std::make_pair(hash, nChainTx));
+}
+
+bool CBlockTreeDB::ReadSnapshotBase(uint256 &hash, unsigned int &nChainTx) {
+    std::pair<uint256, unsigned int> base;
+    if (!Read(DB_SNAPSHOT_BASE, base))
+        return false;
+    hash = base.first;
+    nChainTx = base.second;
+    return true;
+}
+
 CCoinsViewCursor *CCoinsViewDB::Cursor() const
 {
     CCoinsViewDBCursor *i = new CCoinsViewDBCursor(const_cast<CDBWrapper*>(&db)->NewIterator(), GetBestBlock());
     /* It seems that there are no "const iterators" for LevelDB.  Since we
        only need read operations on it, use a const-cast to get around
        that restriction.  */
-    i->pcursor->Seek(DB_COINS);
+    i->pcursor->Seek(DB_COIN);
     // Cache key of first record
     if (i->pcursor->Valid()) {
-        i->pcursor->GetKey(i->keyTmp);
+        CoinEntry entry(&i->keyTmp.second);
+        i->pcursor->GetKey(entry);
+        i->keyTmp.first = entry.key;
     } else {
         i->keyTmp.first = 0; // Make sure Valid() and GetKey() return false
     }
     return i;
 }
 
-bool CCoinsViewDBCursor::GetKey(uint256 &key) const
+bool CCoinsViewDBCursor::GetKey(COutPoint &key) const
 {
     // Return cached key
-    if (keyTmp.first == DB_COINS) {
+    if (keyTmp.first == DB_COIN) {
         key = keyTmp.second;
         return true;
     }
     return false;
 }
 
-bool CCoinsViewDBCursor::GetValue(CCoins &coins) const
+bool CCoinsViewDBCursor::GetValue(Coin &coin) const
 {
-    return pcursor->GetValue(coins);
+    return pcursor->GetValue(coin);
 }
 
 unsigned int CCoinsViewDBCursor::GetValueSize() const
@@ -128,14 +325,18 @@ unsigned int CCoinsViewDBCursor::GetValueSize() const
 
 bool CCoinsViewDBCursor::Valid() const
 {
-    return keyTmp.first == DB_COINS;
+    return keyTmp.first == DB_COIN;
 }
 
 void CCoinsViewDBCursor::Next()
 {
     pcursor->Next();
-    if (!pcursor->Valid() || !pcursor->GetKey(keyTmp))
+    CoinEntry entry(&keyTmp.second);
+    if (!pcursor->Valid() || !pcursor->GetKey(entry)) {
         keyTmp.first = 0; // Invalidate cached key after last record so that Valid() and GetKey() return false
+    } else {
+        keyTmp.first = entry.key;
+    }
 }
 
 bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo) {
@@ -161,6 +362,14 @@ bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos>
     return WriteBatch(batch);
 }
 
+bool CBlockTreeDB::ReadAuxPow(const uint256 &hash, CAuxPow &auxpow) {
+    return Read(std::make_pair(DB_BLOCK_AUXPOW, hash), auxpow);
+}
+
+bool CBlockTreeDB::WriteAuxPow(const uint256 &hash, const CAuxPow &auxpow) {
+    return Write(std::make_pair(DB_BLOCK_AUXPOW, hash), auxpow);
+}
+
 bool CBlockTreeDB::WriteFlag(const std::string &name, bool fValue) {
     return Write(std::make_pair(DB_FLAG, name), fValue ? '1' : '0');
 }
@@ -173,47 +382,109 @@ bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
     return true;
 }
 
-bool CBlockTreeDB::LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256&)> insertBlockIndex)
+/** Shared state of the threads loading the block index */
+struct CBlockIndexLoad
+{
+    boost::function<CBlockIndex*(const uint256&)> insertBlockIndex;
+    //! Next slice of the key space to be read
+    std::atomic<unsigned int> nNextSlice;
+    //! Protects the calls to insertBlockIndex and fFailed
+    boost::mutex mutex;
+    bool fFailed;
+    //! Set once any of the threads has been interrupted, so that all stop
+    std::atomic<bool> fInterrupted;
+
+    CBlockIndexLoad(boost::function<CBlockIndex*(const uint256&)> insertBlockIndexIn) :
+        insertBlockIndex(insertBlockIndexIn), nNextSlice(0), fFailed(false), fInterrupted(false) {}
+};
+
+void CBlockTreeDB::LoadBlockIndexSlices(CBlockIndexLoad* pload)
 {
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    std::vector<std::pair<uint256, CDiskBlockIndex> > vEntries;
+    std::vector<arith_uint256> vProofs;
+
+    unsigned int nSlice;
+    while ((nSlice = pload->nNextSlice++) < BLOCK_INDEX_LOAD_SLICES) {
+        // The calling thread runs with interruption disabled; it only notes the
+        // request here, and the interruption point after the join throws.
+        if (boost::this_thread::interruption_requested())
+            pload->fInterrupted = true;
+        if (pload->fInterrupted)
+            return;
+
+        // Read, hash and weigh the entries whose hash starts with this byte
+        // without holding the lock.
+        uint256 hashStart;
+        *hashStart.begin() = nSlice;
+        pcursor->Seek(std::make_pair(DB_BLOCK_INDEX, hashStart));
+        vEntries.clear();
+        vProofs.clear();
+        bool fOk = true;
+        while (pcursor->Valid()) {
+            std::pair<char, uint256> key;
+            if (!pcursor->GetKey(key) || key.first != DB_BLOCK_INDEX || *key.second.begin() != nSlice)
+                break;
+            vEntries.push_back(std::make_pair(uint256(), CDiskBlockIndex()));
+            if (!pcursor->GetValue(vEntries.back().second)) {
+                fOk = false;
+                break;
+            }
+            vEntries.back().first = vEntries.back().second.GetBlockHash();
+            vProofs.push_back(GetBlockProof(vEntries.back().second));
+            pcursor->Next();
+        }
 
-    pcursor->Seek(std::make_pair(DB_BLOCK_INDEX, uint256()));
+        boost::unique_lock<boost::mutex> lock(pload->mutex);
+        if (!fOk || pload->fFailed) {
+            pload->fFailed = true;
+            return;
+        }
+        for (size_t i = 0; i < vEntries.size(); i++) {
+            const CDiskBlockIndex& diskindex = vEntries[i].second;
+            // Construct block index object
+            CBlockIndex* pindexNew = pload->insertBlockIndex(vEntries[i].first);
+            pindexNew->pprev          = pload->insertBlockIndex(diskindex.hashPrev);
+            pindexNew->nHeight        = diskindex.nHeight;
+            pindexNew->nFile          = diskindex.nFile;
+            pindexNew->nDataPos       = diskindex.nDataPos;
+            pindexNew->nUndoPos       = diskindex.nUndoPos;
+            pindexNew->nVersion       = diskindex.nVersion;
+            pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
+            pindexNew->nTime          = diskindex.nTime;
+            pindexNew->nBits          = diskindex.nBits;
+            pindexNew->nNonce         = diskindex.nNonce;
+            pindexNew->nStatus        = diskindex.nStatus;
+            pindexNew->nTx            = diskindex.nTx;
+            pindexNew->nChainWork     = vProofs[i];
+
+            /* Bitcoin checks the PoW here.  We don't do this because
+               the CDiskBlockIndex does not contain the auxpow.
+               This check isn't important, since the data on disk should
+               already be valid and can be trusted.  */
+        }
+    }
+}
+
+bool CBlockTreeDB::LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256&)> insertBlockIndex, int nThreads)
+{
+    CBlockIndexLoad load(insertBlockIndex);
 
     // Load mapBlockIndex
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        std::pair<char, uint256> key;
-        if (pcursor->GetKey(key) && key.first == DB_BLOCK_INDEX) {
-            CDiskBlockIndex diskindex;
-            if (pcursor->GetValue(diskindex)) {
-                // Construct block index object
-                CBlockIndex* pindexNew = insertBlockIndex(diskindex.GetBlockHash());
-                pindexNew->pprev          = insertBlockIndex(diskindex.hashPrev);
-                pindexNew->nHeight        = diskindex.nHeight;
-                pindexNew->nFile          = diskindex.nFile;
-                pindexNew->nDataPos       = diskindex.nDataPos;
-                pindexNew->nUndoPos       = diskindex.nUndoPos;
-                pindexNew->nVersion       = diskindex.nVersion;
-                pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
-                pindexNew->nTime          = diskindex.nTime;
-                pindexNew->nBits          = diskindex.nBits;
-                pindexNew->nNonce         = diskindex.nNonce;
-                pindexNew->nStatus        = diskindex.nStatus;
-                pindexNew->nTx            = diskindex.nTx;
-
-                /* Bitcoin checks the PoW here.  We don't do this because
-                   the CDiskBlockIndex does not contain the auxpow.
-                   This check isn't important, since the data on disk should
-                   already be valid and can be trusted.  */
-
-                pcursor->Next();
-            } else {
-                return error("LoadBlockIndex() : failed to read value");
-            }
-        } else {
-            break;
+    {
+        boost::thread_group threadGroup;
+        for (int i = 1; i < nThreads; i++)
+            threadGroup.create_thread(boost::bind(&CBlockTreeDB::LoadBlockIndexSlices, this, &load));
+        {
+            // The other threads use load, so they have to be done before we can leave.
+            boost::this_thread::disable_interruption di;
+            LoadBlockIndexSlices(&load);
+            threadGroup.join_all();
         }
     }
+    boost::this_thread::interruption_point();
 
+    if (load.fFailed)
+        return error("LoadBlockIndex() : failed to read value");
     return true;
 }
@@ -17,8 +17,11 @@
 
 #include <boost/function.hpp>
 
+class CAuxPow;
 class CBlockIndex;
+struct CBlockIndexLoad;
 class CCoinsViewDBCursor;
+class CUTXOCommitment;
 class uint256;
 
 //! Compensate for extra memory peak (x1.5-x1.9) at flush time.
@@ -41,6 +44,10 @@ static const int64_t nMaxBlockDBCache = 2;
 static const int64_t nMaxBlockDBAndTxIndexCache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
+//! Number of slices (by first byte of the block hash) the block index is read in
+static const unsigned int BLOCK_INDEX_LOAD_SLICES = 256;
+//! Maximum number of threads reading the block index at startup
+static const int MAX_BLOCK_INDEX_LOAD_THREADS = 8;
 
 struct CDiskTxPos : public CDiskBlockPos
 {
@@ -72,14 +79,24 @@ class CCoinsViewDB : public CCoinsView
 {
 protected:
     CDBWrapper db;
+    //! Written along with the best block whenever it belongs to that block
+    const CUTXOCommitment* pcommitment;
 public:
     CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
 
-    bool GetCoins(const uint256 &txid, CCoins &coins) const;
-    bool HaveCoins(const uint256 &txid) const;
+    bool GetCoin(const COutPoint &outpoint, Coin &coin) const;
+    bool HaveCoin(const COutPoint &outpoint) const;
     uint256 GetBestBlock() const;
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock);
     CCoinsViewCursor *Cursor() const;
+
+    //! Attempt to update from an older database format. Returns false on failure or interruption.
+    bool Upgrade();
+
+    //! Persist *pcommitmentIn with every write it is up to date for (protected by cs_main)
+    void SetCommitment(const CUTXOCommitment* pcommitmentIn) { pcommitment = pcommitmentIn; }
+    //! Read the commitment stored with the best block, if there is one
+    bool ReadCommitment(CUTXOCommitment& commitment) const;
 };
 
 /** Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB */
@@ -88,8 +105,8 @@ class CCoinsViewDBCursor: public CCoinsViewCursor
 public:
     ~CCoinsViewDBCursor() {}
 
-    bool GetKey(uint256 &key) const;
-    bool GetValue(CCoins &coins) const;
+    bool GetKey(COutPoint &key) const;
+    bool GetValue(Coin &coin) const;
     unsigned int GetValueSize() const;
 
     bool Valid() const;
@@ -99,7 +116,7 @@ private:
     CCoinsViewDBCursor(CDBIterator* pcursorIn, const uint256 &hashBlockIn):
         CCoinsViewCursor(hashBlockIn), pcursor(pcursorIn) {}
     std::unique_ptr<CDBIterator> pcursor;
-    std::pair<char, uint256> keyTmp;
+    std::pair<char, COutPoint> keyTmp;
 
     friend class CCoinsViewDB;
 };
@@ -118,11 +135,22 @@ public:
     bool ReadLastBlockFile(int &nFile);
     bool WriteReindexing(bool fReindex);
     bool ReadReindexing(bool &fReindex);
+    bool WriteSnapshotBase(const uint256 &hash, unsigned int nChainTx);
+    bool ReadSnapshotBase(uint256 &hash, unsigned int &nChainTx);
     bool ReadTxIndex(const uint256 &txid, CDiskTxPos &pos);
     bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> > &list);
+    bool ReadAuxPow(const uint256 &hash, CAuxPow &auxpow);
+    bool WriteAuxPow(const uint256 &hash, const CAuxPow &auxpow);
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
-    bool LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256&)> insertBlockIndex);
+    /**
+     * Load all block index entries, using nThreads threads to read and hash
+     * them. insertBlockIndex is only called by one thread at a time. The
+     * nChainWork of every entry read is set to the work of that block alone.
+     */
+    bool LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256&)> insertBlockIndex, int nThreads = 1);
+private:
+    void LoadBlockIndexSlices(CBlockIndexLoad* pload);
 };
 
 #endif // BITCOIN_TXDB_H
@@ -0,0 +1,70 @@
+// Copyright (c) 2026 The Junkcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "utxocommitment.h"
+
+#include "coins.h"
+#include "primitives/transaction.h"
+#include "streams.h"
+#include "version.h"
+
+namespace {
+
+/** The element hashed for a coin: its outpoint, height and coinbase flag, and output. */
+void SerializeElement(CDataStream& ss, const COutPoint& outpoint, const Coin& coin)
+{
+    ss << outpoint;
+    ss << (uint32_t)(coin.nHeight * 2 + coin.fCoinBase);
+    ss << coin.out;
+}
+
+uint64_t GetBogoSize(const Coin& coin)
+{
+    return 32 /* txid */ +
+           4 /* vout index */ +
+           4 /* height + coinbase */ +
+           8 /* amount */ +
+           2 /* scriptPubKey len */ +
+           coin.out.scriptPubKey.size() /* scriptPubKey */;
+}
+
+} // namespace
+
+void CUTXOCommitment::Add(const COutPoint& outpoint, const Coin& coin)
+{
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    SerializeElement(ss, outpoint, coin);
+    muhash.Insert((const unsigned char*)ss.data(), ss.size());
+    nTransactionOutputs++;
+    nBogoSize += GetBogoSize(coin);
+    nTotalAmount += coin.out.nValue;
+}
+
+void CUTXOCommitment::Remove(const COutPoint& outpoint, const Coin& coin)
+{
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    SerializeElement(ss, outpoint, coin);
+    muhash.Remove((const unsigned char*)ss.data(), ss.size());
+    nTransactionOutputs--;
+    nBogoSize -= GetBogoSize(coin);
+    nTotalAmount -= coin.out.nValue;
+}
+
+void CUTXOCommitment::Apply(const CUTXOCommitment& delta)
+{
+    // The counters wrap around for a delta that shrinks the set, and back
+    // again when it is applied.
+    nTransactionOutputs += delta.nTransactionOutputs;
+    nBogoSize += delta.nBogoSize;
+    nTotalAmount += delta.nTotalAmount;
+    muhash *= delta.muhash;
+}
+
+uint256 CUTXOCommitment::GetHash() const
+{
+    MuHash3072 muhashCopy(muhash);
+    uint256 hash;
+    muhashCopy.Finalize(hash.begin());
+    return hash;
+}
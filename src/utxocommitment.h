@@ -0,0 +1,72 @@
+// Copyright (c) 2026 The Junkcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_UTXOCOMMITMENT_H
+#define BITCOIN_UTXOCOMMITMENT_H
+
+#include "amount.h"
+#include "crypto/muhash.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <stdint.h>
+
+class COutPoint;
+class Coin;
+
+/**
+ * Statistics and a rolling hash of a UTXO set, kept up to date as coins are
+ * added and spent instead of being computed by walking the whole set.
+ *
+ * The hash is a MuHash3072 over the serialized outpoints and coins, so it
+ * does not depend on the order in which coins came and went. A commitment
+ * built up for the changes of a single block can be applied to the one for
+ * the set before it with Apply().
+ */
+class CUTXOCommitment
+{
+public:
+    //! Block the set belongs to
+    uint256 hashBlock;
+    //! Number of unspent outputs
+    uint64_t nTransactionOutputs;
+    //! Rough size of the set, independent of how the database stores it
+    uint64_t nBogoSize;
+    //! Sum of the values of all unspent outputs
+    CAmount nTotalAmount;
+
+private:
+    MuHash3072 muhash;
+
+public:
+    CUTXOCommitment() : nTransactionOutputs(0), nBogoSize(0), nTotalAmount(0) {}
+
+    void Add(const COutPoint& outpoint, const Coin& coin);
+    void Remove(const COutPoint& outpoint, const Coin& coin);
+
+    //! Add the changes recorded in delta; hashBlock is left alone
+    void Apply(const CUTXOCommitment& delta);
+
+    //! The MuHash of the set. Involves a modular inversion, so takes a few milliseconds.
+    uint256 GetHash() const;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(hashBlock);
+        READWRITE(nTransactionOutputs);
+        READWRITE(nBogoSize);
+        READWRITE(nTotalAmount);
+        unsigned char num[Num3072::BYTE_SIZE], den[Num3072::BYTE_SIZE];
+        if (!ser_action.ForRead())
+            muhash.GetState(num, den);
+        READWRITE(FLATDATA(num));
+        READWRITE(FLATDATA(den));
+        if (ser_action.ForRead())
+            muhash.SetState(num, den);
+    }
+};
+
+#endif // BITCOIN_UTXOCOMMITMENT_H
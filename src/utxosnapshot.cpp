@@ -0,0 +1,362 @@
+// Copyright (c) 2026 The Junkcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "utxosnapshot.h"
+
+#include "chain.h"
+#include "chainparams.h"
+#include "coins.h"
+#include "consensus/validation.h"
+#include "hash.h"
+#include "init.h"
+#include "streams.h"
+#include "txdb.h"
+#include "util.h"
+#include "utiltime.h"
+#include "utxocommitment.h"
+#include "validation.h"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+
+#include <boost/thread.hpp>
+
+const unsigned char CUTXOSnapshotHeader::MAGIC[5] = {'u', 't', 'x', 'o', 0xff};
+
+CUTXOSnapshotHeader::CUTXOSnapshotHeader() : nVersion(UTXO_SNAPSHOT_VERSION), nHeight(0), nChainTx(0), nTransactionOutputs(0)
+{
+    memcpy(magic, MAGIC, sizeof(magic));
+    memcpy(pchMessageStart, Params().MessageStart(), sizeof(pchMessageStart));
+}
+
+namespace {
+
+/** Flag in the block tree database that is set while coins are being loaded */
+const char* const SNAPSHOT_LOADING_FLAG = "utxosnapshotloading";
+
+/** A file that hashes everything that is read from or written to it */
+class CHashedFile
+{
+private:
+    CAutoFile& file;
+    CHashWriter hasher;
+
+public:
+    CHashedFile(CAutoFile& fileIn) : file(fileIn), hasher(fileIn.GetType(), fileIn.GetVersion()) {}
+
+    int GetType() const { return file.GetType(); }
+    int GetVersion() const { return file.GetVersion(); }
+
+    void read(char* pch, size_t nSize)
+    {
+        file.read(pch, nSize);
+        hasher.write(pch, nSize);
+    }
+
+    void ignore(size_t nSize)
+    {
+        char data[1024];
+        while (nSize > 0) {
+            size_t nNow = std::min<size_t>(nSize, sizeof(data));
+            read(data, nNow);
+            nSize -= nNow;
+        }
+    }
+
+    void write(const char* pch, size_t nSize)
+    {
+        file.write(pch, nSize);
+        hasher.write(pch, nSize);
+    }
+
+    template<typename T>
+    CHashedFile& operator<<(const T& obj)
+    {
+        ::Serialize(*this, obj);
+        return *this;
+    }
+
+    template<typename T>
+    CHashedFile& operator>>(T& obj)
+    {
+        ::Unserialize(*this, obj);
+        return *this;
+    }
+
+    uint256 GetHash() { return hasher.GetHash(); }
+};
+
+void WriteCoins(CHashedFile& file, const uint256& txid, std::map<uint32_t, Coin>& outputs)
+{
+    file << txid;
+    WriteCompactSize(file, outputs.size());
+    for (auto& output : outputs) {
+        file << VARINT(output.first);
+        file << output.second;
+    }
+}
+
+/**
+ * Read the coins that follow the header and the checksum after them, and
+ * pass each coin to fn, which returns false to stop. Rejects anything that
+ * DumpUTXOSnapshot could not have written.
+ */
+template<typename Callable>
+bool ReadCoins(CAutoFile& filein, const CUTXOSnapshotHeader& header, uint256& hashChecksum, Callable fn, std::string& strError)
+{
+    CHashedFile file(filein);
+    CUTXOSnapshotHeader headerRead;
+    file >> headerRead;
+
+    uint64_t nRead = 0;
+    uint256 txidPrev;
+    while (nRead < header.nTransactionOutputs) {
+        boost::this_thread::interruption_point();
+        uint256 txid;
+        file >> txid;
+        uint64_t nOutputs = ReadCompactSize(file);
+        if ((nRead > 0 && !(txidPrev < txid)) || nOutputs == 0 || nOutputs > header.nTransactionOutputs - nRead) {
+            strError = "Snapshot coins are not in order";
+            return false;
+        }
+        uint32_t nPrev = 0;
+        for (uint64_t i = 0; i < nOutputs; i++) {
+            uint32_t n;
+            Coin coin;
+            file >> VARINT(n);
+            file >> coin;
+            if ((i > 0 && n <= nPrev) || coin.IsSpent() || coin.out.scriptPubKey.IsUnspendable() || (int)coin.nHeight > header.nHeight) {
+                strError = "Snapshot contains an invalid coin";
+                return false;
+            }
+            nPrev = n;
+            if (!fn(COutPoint(txid, n), std::move(coin)))
+                return false;
+        }
+        txidPrev = txid;
+        nRead += nOutputs;
+    }
+
+    hashChecksum = file.GetHash();
+    uint256 hashStored;
+    filein >> hashStored;
+    if (hashStored != hashChecksum) {
+        strError = "Snapshot checksum mismatch";
+        return false;
+    }
+    if (fgetc(filein.Get()) != EOF) {
+        strError = "Snapshot has trailing data";
+        return false;
+    }
+    return true;
+}
+
+/** Whether the node is in a state to load a snapshot at the header's block */
+bool CheckSnapshotBase(const CUTXOSnapshotHeader& header, CBlockIndex*& pindexBase, std::string& strError)
+{
+    AssertLockHeld(cs_main);
+    if (fTxIndex) {
+        strError = "A UTXO snapshot cannot be loaded with -txindex enabled";
+        return false;
+    }
+    if (fReindex || fImporting) {
+        strError = "A UTXO snapshot cannot be loaded while blocks are being imported";
+        return false;
+    }
+    if (chainActive.Height() != 0) {
+        strError = "Blocks beyond the genesis block have been connected already";
+        return false;
+    }
+    BlockMap::iterator it = mapBlockIndex.find(header.hashBlock);
+    if (it == mapBlockIndex.end() || !pindexBestHeader || pindexBestHeader->GetAncestor(it->second->nHeight) != it->second) {
+        strError = strprintf("The headers up to the snapshot's block %s are not synced yet", header.hashBlock.ToString());
+        return false;
+    }
+    pindexBase = it->second;
+    if (pindexBase->nHeight != header.nHeight || pindexBase->nHeight == 0 || (pindexBase->nStatus & BLOCK_FAILED_MASK)) {
+        strError = "The snapshot's block is not valid";
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+bool DumpUTXOSnapshot(const boost::filesystem::path& path, CUTXOSnapshotHeader& header, std::string& strError)
+{
+    int64_t nStart = GetTimeMillis();
+    std::unique_ptr<CCoinsViewCursor> pcursor;
+    CUTXOCommitment commitment;
+    {
+        LOCK(cs_main);
+        FlushStateToDisk();
+        // The cursor reads from a snapshot of the database taken here.
+        pcursor.reset(pcoinsTip->Cursor());
+        commitment = utxoCommitment;
+        if (pcursor->GetBestBlock() != commitment.hashBlock) {
+            strError = "UTXO set commitment does not match the coins database";
+            return false;
+        }
+        // Null or unknown while -reindex has not connected the genesis block yet
+        BlockMap::const_iterator it = mapBlockIndex.find(commitment.hashBlock);
+        if (it == mapBlockIndex.end()) {
+            strError = "The UTXO set has no best block yet";
+            return false;
+        }
+        const CBlockIndex* pindex = it->second;
+        header.hashBlock = pindex->GetBlockHash();
+        header.nHeight = pindex->nHeight;
+        header.nChainTx = pindex->nChainTx;
+    }
+    header.nTransactionOutputs = commitment.nTransactionOutputs;
+    header.hashUTXOSet = commitment.GetHash();
+
+    boost::filesystem::path pathTmp = path;
+    pathTmp += ".incomplete";
+    CAutoFile fileout(fopen(pathTmp.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+    if (fileout.IsNull()) {
+        strError = "Unable to open " + pathTmp.string() + " for writing";
+        return false;
+    }
+
+    CHashedFile file(fileout);
+    file << header;
+    uint64_t nWritten = 0;
+    uint256 txidPrev;
+    std::map<uint32_t, Coin> outputs;
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        COutPoint key;
+        Coin coin;
+        if (!pcursor->GetKey(key) || !pcursor->GetValue(coin)) {
+            strError = "Unable to read UTXO set";
+            return false;
+        }
+        if (!outputs.empty() && key.hash != txidPrev) {
+            WriteCoins(file, txidPrev, outputs);
+            outputs.clear();
+        }
+        txidPrev = key.hash;
+        outputs[key.n] = std::move(coin);
+        nWritten++;
+        pcursor->Next();
+    }
+    if (!outputs.empty())
+        WriteCoins(file, txidPrev, outputs);
+    if (nWritten != header.nTransactionOutputs) {
+        strError = strprintf("Wrote %u coins where the commitment has %u", nWritten, header.nTransactionOutputs);
+        return false;
+    }
+    fileout << file.GetHash();
+
+    FileCommit(fileout.Get());
+    fileout.fclose();
+    if (!RenameOver(pathTmp, path)) {
+        strError = "Unable to rename " + pathTmp.string();
+        return false;
+    }
+    LogPrintf("%s: wrote %u coins at height %d to %s in %dms\n", __func__, nWritten, header.nHeight, path.string(), GetTimeMillis() - nStart);
+    return true;
+}
+
+bool LoadUTXOSnapshot(const boost::filesystem::path& path, CUTXOSnapshotHeader& header, std::string& strError)
+{
+    int64_t nStart = GetTimeMillis();
+    CAutoFile filein(fopen(path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull()) {
+        strError = "Unable to open " + path.string();
+        return false;
+    }
+
+    // Verify the whole file before touching the coins database.
+    CUTXOCommitment commitment;
+    uint256 hashChecksum;
+    try {
+        filein >> header;
+        if (memcmp(header.magic, CUTXOSnapshotHeader::MAGIC, sizeof(header.magic)) != 0) {
+            strError = "Not a UTXO snapshot";
+            return false;
+        }
+        if (header.nVersion != UTXO_SNAPSHOT_VERSION) {
+            strError = strprintf("Unsupported UTXO snapshot version %d", header.nVersion);
+            return false;
+        }
+        if (memcmp(header.pchMessageStart, Params().MessageStart(), sizeof(header.pchMessageStart)) != 0) {
+            strError = "UTXO snapshot is for another network";
+            return false;
+        }
+        {
+            LOCK(cs_main);
+            CBlockIndex* pindexBase;
+            if (!CheckSnapshotBase(header, pindexBase, strError))
+                return false;
+        }
+        rewind(filein.Get());
+        auto addToCommitment = [&commitment](const COutPoint& outpoint, Coin&& coin) {
+            commitment.Add(outpoint, coin);
+            return true;
+        };
+        if (!ReadCoins(filein, header, hashChecksum, addToCommitment, strError))
+            return false;
+    } catch (const std::exception& e) {
+        strError = strprintf("Corrupt UTXO snapshot: %s", e.what());
+        return false;
+    }
+    if (commitment.nTransactionOutputs != header.nTransactionOutputs || commitment.GetHash() != header.hashUTXOSet) {
+        strError = "UTXO snapshot contents do not match its hash";
+        return false;
+    }
+    LogPrintf("%s: verified %u coins at height %d in %dms\n", __func__, header.nTransactionOutputs, header.nHeight, GetTimeMillis() - nStart);
+
+    // Hold cs_main while loading, so that no block can be connected on top
+    // of a partial set.
+    LOCK(cs_main);
+    CBlockIndex* pindexBase;
+    if (!CheckSnapshotBase(header, pindexBase, strError))
+        return false;
+    // Until the load completes, the coins database is neither at genesis
+    // nor at the snapshot's block.
+    if (!pblocktree->WriteFlag(SNAPSHOT_LOADING_FLAG, true)) {
+        strError = "Failed to write to the block tree database";
+        return false;
+    }
+    bool fLoaded = false;
+    try {
+        rewind(filein.Get());
+        uint256 hashChecksumLoaded;
+        bool fFlushed = true;
+        auto addToCoins = [&fFlushed](const COutPoint& outpoint, Coin&& coin) {
+            pcoinsTip->AddCoin(outpoint, std::move(coin), false);
+            if (pcoinsTip->DynamicMemoryUsage() > nCoinCacheUsage)
+                fFlushed = pcoinsTip->Flush();
+            return fFlushed;
+        };
+        if (!ReadCoins(filein, header, hashChecksumLoaded, addToCoins, strError)) {
+            // strError is set
+        } else if (!fFlushed || !pcoinsTip->Flush()) {
+            strError = "Failed to write to the coins database";
+        } else if (hashChecksumLoaded != hashChecksum) {
+            strError = "UTXO snapshot changed while it was being loaded";
+        } else {
+            CValidationState state;
+            fLoaded = ActivateUTXOSnapshot(state, pindexBase, header.nChainTx, commitment);
+            if (!fLoaded)
+                strError = FormatStateMessage(state);
+        }
+    } catch (const std::exception& e) {
+        strError = strprintf("Corrupt UTXO snapshot: %s", e.what());
+    }
+    if (!fLoaded) {
+        // Part of the set may have been written already; nothing may be
+        // connected on top of it.
+        strError += ". Restart with -reindex-chainstate";
+        LogPrintf("*** %s: %s\n", __func__, strError);
+        StartShutdown();
+        return false;
+    }
+    pblocktree->WriteFlag(SNAPSHOT_LOADING_FLAG, false);
+    LogPrintf("%s: loaded %u coins at height %d in %dms\n", __func__, header.nTransactionOutputs, header.nHeight, GetTimeMillis() - nStart);
+    return true;
+}
@@ -0,0 +1,77 @@
+// Copyright (c) 2026 The Junkcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_UTXOSNAPSHOT_H
+#define BITCOIN_UTXOSNAPSHOT_H
+
+#include "protocol.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <stdint.h>
+#include <string>
+
+#include <boost/filesystem/path.hpp>
+
+/** Version of the snapshot format written by DumpUTXOSnapshot */
+static const uint16_t UTXO_SNAPSHOT_VERSION = 1;
+
+/**
+ * Header of a UTXO set snapshot file.
+ *
+ * The header is followed by the coins, grouped per transaction in the order
+ * of the coins database: the txid, the number of its unspent outputs, and
+ * for each of those its index and the Coin. The file ends with the double
+ * SHA256 of everything before it.
+ */
+class CUTXOSnapshotHeader
+{
+public:
+    static const unsigned char MAGIC[5];
+
+    unsigned char magic[5];
+    uint16_t nVersion;
+    CMessageHeader::MessageStartChars pchMessageStart;
+    //! The block the set is at
+    uint256 hashBlock;
+    int nHeight;
+    //! Number of transactions in the chain up to and including hashBlock
+    unsigned int nChainTx;
+    uint64_t nTransactionOutputs;
+    //! The MuHash of the set, as reported by gettxoutsetinfo
+    uint256 hashUTXOSet;
+
+    CUTXOSnapshotHeader();
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(FLATDATA(magic));
+        READWRITE(nVersion);
+        READWRITE(FLATDATA(pchMessageStart));
+        READWRITE(hashBlock);
+        READWRITE(nHeight);
+        READWRITE(nChainTx);
+        READWRITE(nTransactionOutputs);
+        READWRITE(hashUTXOSet);
+    }
+};
+
+/**
+ * Write the UTXO set at the current tip to a file. The coins database is
+ * flushed and read through a consistent view of it, so cs_main is only held
+ * at the start.
+ */
+bool DumpUTXOSnapshot(const boost::filesystem::path& path, CUTXOSnapshotHeader& header, std::string& strError);
+
+/**
+ * Load a UTXO set written by DumpUTXOSnapshot into the coins database of a
+ * node that has not connected anything beyond the genesis block, and make
+ * its block the tip. The headers up to that block must be known. The file
+ * is verified before anything is written.
+ */
+bool LoadUTXOSnapshot(const boost::filesystem::path& path, CUTXOSnapshotHeader& header, std::string& strError);
+
+#endif // BITCOIN_UTXOSNAPSHOT_H
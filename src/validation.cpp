@@ -7,9 +7,13 @@
 #include "validation.h"
 
 #include "arith_uint256.h"
+#include "blockfilemap.h"
+#include "blockreadahead.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "checkqueue.h"
+#include "coinsflush.h"
+#include "coinsprefetch.h"
 #include "consensus/consensus.h"
 #include "consensus/merkle.h"
 #include "consensus/validation.h"
@@ -24,6 +28,7 @@
 #include "primitives/pureheader.h"
 #include "primitives/transaction.h"
 #include "random.h"
+#include "reindex.h"
 #include "script/script.h"
 #include "script/sigcache.h"
 #include "script/standard.h"
@@ -33,6 +38,7 @@
 #include "txmempool.h"
 #include "ui_interface.h"
 #include "util.h"
+#include "utxocommitment.h"
 #include "utilmoneystr.h"
 #include "utilstrencodings.h"
 #include "validationinterface.h"
@@ -62,8 +68,18 @@
 CCriticalSection cs_main;
 
 BlockMap mapBlockIndex;
+/** Holds the entries of mapBlockIndex */
+static CBlockIndexArena blockIndexArena;
+/**
+ * Held exclusively (besides cs_main) while mapBlockIndex changes, and shared
+ * by LookupBlockIndex, which is used without cs_main.
+ */
+static boost::shared_mutex csBlockIndexLookup;
 CChain chainActive;
+/** Published with std::atomic_store by PublishChainTip, after every change of chainActive */
+static std::shared_ptr<const CChainTip> chainTipSnapshot = std::make_shared<const CChainTip>(nullptr);
 CBlockIndex *pindexBestHeader = NULL;
+CBlockIndex *pindexSnapshotBase = NULL;
 CWaitableCriticalSection csBestBlock;
 CConditionVariable cvBlockChange;
 int nScriptCheckThreads = 0;
@@ -76,6 +92,7 @@ bool fIsBareMultisigStd = DEFAULT_PERMIT_BAREMULTISIG;
 bool fRequireStandard = true;
 bool fCheckBlockIndex = false;
 bool fCheckpointsEnabled = DEFAULT_CHECKPOINTS_ENABLED;
+bool fCheckBlockReads = DEFAULT_CHECKBLOCKREADS;
 size_t nCoinCacheUsage = 5000 * 300;
 uint64_t nPruneTarget = 0;
 int64_t nMaxTipAge = DEFAULT_MAX_TIP_AGE;
@@ -242,7 +259,14 @@ CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& loc
 }
 
 CCoinsViewCache *pcoinsTip = NULL;
+CCoinsViewFlusher *pcoinsFlusher = NULL;
+CCoinsViewPrefetch *pcoinsPrefetch = NULL;
+CBlockReadAhead *pblockReadAhead = NULL;
+CBlockFileMap *pblockFileMap = NULL;
+CUTXOCommitment utxoCommitment;
 CBlockTreeDB *pblocktree = NULL;
+CLRUCache<const CBlockIndex*> auxpowCache(DEFAULT_AUXPOW_CACHE_SIZE << 20);
+CLRUCache<uint256, BlockHasher> blockCache(DEFAULT_BLOCK_CACHE_SIZE << 20);
 
 enum FlushStateMode {
     FLUSH_STATE_NONE,
@@ -430,15 +454,15 @@ bool CheckSequenceLocks(const CTransaction &tx, int flags, LockPoints* lp, bool
         prevheights.resize(tx.vin.size());
         for (size_t txinIndex = 0; txinIndex < tx.vin.size(); txinIndex++) {
             const CTxIn& txin = tx.vin[txinIndex];
-            CCoins coins;
-            if (!viewMemPool.GetCoins(txin.prevout.hash, coins)) {
+            Coin coin;
+            if (!viewMemPool.GetCoin(txin.prevout, coin)) {
                 return error("%s: Missing input", __func__);
             }
-            if (coins.nHeight == MEMPOOL_HEIGHT) {
+            if (coin.nHeight == MEMPOOL_HEIGHT) {
                 // Assume all mempool transaction confirm in the next block
                 prevheights[txinIndex] = tip->nHeight + 1;
             } else {
-                prevheights[txinIndex] = coins.nHeight;
+                prevheights[txinIndex] = coin.nHeight;
             }
         }
         lockPair = CalculateSequenceLocks(tx, flags, &prevheights, index);
@@ -579,9 +603,9 @@ void LimitMempoolSize(CTxMemPool& pool, size_t limit, unsigned long age) {
     if (expired != 0)
         LogPrint("mempool", "Expired %i transactions from the memory pool\n", expired);
 
-    std::vector<uint256> vNoSpendsRemaining;
+    std::vector<COutPoint> vNoSpendsRemaining;
     pool.TrimToSize(limit, &vNoSpendsRemaining);
-    BOOST_FOREACH(const uint256& removed, vNoSpendsRemaining)
+    BOOST_FOREACH(const COutPoint& removed, vNoSpendsRemaining)
         pcoinsTip->Uncache(removed);
 }
 
@@ -608,7 +632,7 @@ static bool IsCurrentForFeeEstimation()
 
 bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState& state, const CTransactionRef& ptx, bool fLimitFree,
                               bool* pfMissingInputs, int64_t nAcceptTime, std::list<CTransactionRef>* plTxnReplaced,
-                              bool fOverrideMempoolLimit, const CAmount& nAbsurdFee, std::vector<uint256>& vHashTxnToUncache)
+                              bool fOverrideMempoolLimit, const CAmount& nAbsurdFee, std::vector<COutPoint>& vCoinsToUncache)
 {
     const CTransaction& tx = *ptx;
     const uint256 hash = tx.GetHash();
@@ -701,20 +725,21 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState& state, const C
         view.SetBackend(viewMemPool);
 
         // do we already have it?
-        bool fHadTxInCache = pcoinsTip->HaveCoinsInCache(hash);
-        if (view.HaveCoins(hash)) {
-            if (!fHadTxInCache)
-                vHashTxnToUncache.push_back(hash);
-            return state.Invalid(false, REJECT_ALREADY_KNOWN, "txn-already-known");
+        for (size_t out = 0; out < tx.vout.size(); out++) {
+            COutPoint outpoint(hash, out);
+            bool fHadCoinInCache = pcoinsTip->HaveCoinInCache(outpoint);
+            if (view.HaveCoin(outpoint)) {
+                if (!fHadCoinInCache)
+                    vCoinsToUncache.push_back(outpoint);
+                return state.Invalid(false, REJECT_ALREADY_KNOWN, "txn-already-known");
+            }
         }
 
         // do all inputs exist?
-        // Note that this does not check for the presence of actual outputs (see the next check for that),
-        // and only helps with filling in pfMissingInputs (to determine missing vs spent).
         BOOST_FOREACH(const CTxIn txin, tx.vin) {
-            if (!pcoinsTip->HaveCoinsInCache(txin.prevout.hash))
-                vHashTxnToUncache.push_back(txin.prevout.hash);
-            if (!view.HaveCoins(txin.prevout.hash)) {
+            if (!pcoinsTip->HaveCoinInCache(txin.prevout))
+                vCoinsToUncache.push_back(txin.prevout);
+            if (!view.HaveCoin(txin.prevout)) {
                 if (pfMissingInputs)
                     *pfMissingInputs = true;
                 return false; // fMissingInputs and !state.IsInvalid() is used to detect this condition, don't set state.Invalid()
@@ -766,8 +791,8 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState& state, const C
         // during reorgs to ensure COINBASE_MATURITY is still met.
         bool fSpendsCoinbase = false;
         BOOST_FOREACH(const CTxIn &txin, tx.vin) {
-            const CCoins *coins = view.AccessCoins(txin.prevout.hash);
-            if (coins->IsCoinBase()) {
+            const Coin &coin = view.AccessCoin(txin.prevout);
+            if (coin.IsCoinBase()) {
                 fSpendsCoinbase = true;
                 break;
             }
@@ -1052,11 +1077,11 @@ bool AcceptToMemoryPoolWithTime(CTxMemPool& pool, CValidationState &state, const
                         bool* pfMissingInputs, int64_t nAcceptTime, std::list<CTransactionRef>* plTxnReplaced,
                         bool fOverrideMempoolLimit, const CAmount nAbsurdFee)
 {
-    std::vector<uint256> vHashTxToUncache;
-    bool res = AcceptToMemoryPoolWorker(pool, state, tx, fLimitFree, pfMissingInputs, nAcceptTime, plTxnReplaced, fOverrideMempoolLimit, nAbsurdFee, vHashTxToUncache);
+    std::vector<COutPoint> vCoinsToUncache;
+    bool res = AcceptToMemoryPoolWorker(pool, state, tx, fLimitFree, pfMissingInputs, nAcceptTime, plTxnReplaced, fOverrideMempoolLimit, nAbsurdFee, vCoinsToUncache);
     if (!res) {
-        BOOST_FOREACH(const uint256& hashTx, vHashTxToUncache)
-            pcoinsTip->Uncache(hashTx);
+        BOOST_FOREACH(const COutPoint& outpoint, vCoinsToUncache)
+            pcoinsTip->Uncache(outpoint);
     }
     // After we've (potentially) uncached entries, ensure our coins cache is still within its size limits
     CValidationState stateDummy;
@@ -1107,15 +1132,9 @@ bool GetTransaction(const uint256 &hash, CTransactionRef &txOut, const Consensus
     }
 
     if (fAllowSlow) { // use coin database to locate block that contains transaction, and scan it
-        int nHeight = -1;
-        {
-            const CCoinsViewCache& view = *pcoinsTip;
-            const CCoins* coins = view.AccessCoins(hash);
-            if (coins)
-                nHeight = coins->nHeight;
-        }
-        if (nHeight > 0)
-            pindexSlow = chainActive[nHeight];
+        const Coin& coin = AccessByTxid(*pcoinsTip, hash);
+        if (!coin.IsSpent())
+            pindexSlow = chainActive[coin.nHeight];
     }
 
     if (pindexSlow) {
@@ -1173,22 +1192,31 @@ static bool ReadBlockOrHeader(T& block, const CDiskBlockPos& pos, const Consensu
 {
     block.SetNull();
 
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+    CByteSpan span;
+    if (pblockFileMap && pblockFileMap->GetRecord(pos, "blk", Params().MessageStart(), 0, span)) {
+        // Deserialize straight from the mapped file
+        try {
+            CSpanReader reader(SER_DISK, CLIENT_VERSION, span.data, span.size);
+            reader >> block;
+        }
+        catch (const std::exception& e) {
+            return error("%s: Deserialize error - %s at %s", __func__, e.what(), pos.ToString());
+        }
+    } else {
+        // Open history file to read
+        CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
 
-    // Read block
-    try {
-        filein >> block;
-    }
-    catch (const std::exception& e) {
-        return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+        // Read block
+        try {
+            filein >> block;
+        }
+        catch (const std::exception& e) {
+            return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+        }
     }
 
-
-
-
     // Check the header
     if (fCheckPOW && !CheckAuxPowProofOfWork(block, consensusParams))
         return error("ReadBlockFromDisk: Errors in block header at %s", pos.ToString());
@@ -1196,14 +1224,34 @@ static bool ReadBlockOrHeader(T& block, const CDiskBlockPos& pos, const Consensu
     return true;
 }
 
+static bool CheckMerkleRootRead(const CBlockHeader& block)
+{
+    return true;
+}
+
+static bool CheckMerkleRootRead(const CBlock& block)
+{
+    return BlockMerkleRoot(block) == block.hashMerkleRoot;
+}
+
 template<typename T>
 static bool ReadBlockOrHeader(T& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams, bool fCheckPOW)
 {
+    // A header that made it into the block tree had its PoW checked when it
+    // was accepted, and the hash comparison below ties the data read back to
+    // that header. Only redo the scrypt and auxpow checks for entries that
+    // never got that far. The hash does not cover the auxpow or the
+    // transactions though, so -checkblockreads checks those as well.
+    if (fCheckPOW && pindex->IsValid(BLOCK_VALID_TREE) && !fCheckBlockReads)
+        fCheckPOW = false;
     if (!ReadBlockOrHeader(block, pindex->GetBlockPos(), consensusParams, fCheckPOW))
         return false;
     if (block.GetHash() != pindex->GetBlockHash())
         return error("ReadBlockOrHeader(CBlock&, CBlockIndex*): GetHash() doesn't match index for %s at %s",
                 pindex->ToString(), pindex->GetBlockPos().ToString());
+    if (fCheckBlockReads && !CheckMerkleRootRead(block))
+        return error("ReadBlockOrHeader(CBlock&, CBlockIndex*): merkle root doesn't match transactions for %s at %s",
+                pindex->ToString(), pindex->GetBlockPos().ToString());
     return true;
 }
 
@@ -1222,6 +1270,83 @@ bool ReadBlockHeaderFromDisk(CBlockHeader& block, const CBlockIndex* pindex, con
     return ReadBlockOrHeader(block, pindex, consensusParams, fCheckPOW);
 }
 
+bool ReadRawBlockFromDisk(CByteSpan& span, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart)
+{
+    if (pblockFileMap && pblockFileMap->GetRecord(pos, "blk", messageStart, 0, span))
+        return true;
+
+    // Without a mapping, copy the record out of the file.
+    const unsigned int nHeaderSize = CMessageHeader::MESSAGE_START_SIZE + sizeof(unsigned int);
+    if (pos.nPos < nHeaderSize)
+        return error("%s: no block at %s", __func__, pos.ToString());
+    CAutoFile filein(OpenBlockFile(CDiskBlockPos(pos.nFile, pos.nPos - nHeaderSize), true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("%s: OpenBlockFile failed for %s", __func__, pos.ToString());
+    try {
+        CMessageHeader::MessageStartChars buf;
+        unsigned int nSize;
+        filein >> FLATDATA(buf) >> nSize;
+        if (memcmp(buf, messageStart, CMessageHeader::MESSAGE_START_SIZE) != 0 || nSize > MAX_BLOCK_SERIALIZED_SIZE)
+            return error("%s: no block at %s", __func__, pos.ToString());
+        std::shared_ptr<std::vector<unsigned char> > pdata = std::make_shared<std::vector<unsigned char> >(nSize);
+        filein.read((char*)pdata->data(), nSize);
+        span.owner = pdata;
+        span.data = pdata->data();
+        span.size = nSize;
+    }
+    catch (const std::exception& e) {
+        return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+    }
+    return true;
+}
+
+bool ReadRawBlockFromDisk(CByteSpan& span, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& messageStart)
+{
+    if (!ReadRawBlockFromDisk(span, pindex->GetBlockPos(), messageStart))
+        return false;
+    // The block hash only covers the 80 byte header that starts the block.
+    if (span.size < 80 || Hash(span.data, span.data + 80) != pindex->GetBlockHash())
+        return error("%s: block at %s does not match index for %s", __func__, pindex->GetBlockPos().ToString(), pindex->ToString());
+    if (fCheckBlockReads) {
+        CBlock block;
+        if (!DecodeRawBlock(block, span))
+            return false;
+        if (!CheckAuxPowProofOfWork(block, Params().GetConsensus(pindex->nHeight)) || !CheckMerkleRootRead(block))
+            return error("%s: errors in block at %s for %s", __func__, pindex->GetBlockPos().ToString(), pindex->ToString());
+    }
+    return true;
+}
+
+bool ReadRawBlockCached(CByteSpan& span, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& messageStart)
+{
+    CLRUCache<uint256, BlockHasher>::value_ptr pdata = blockCache.Get(pindex->GetBlockHash());
+    if (!pdata) {
+        CByteSpan spanDisk;
+        if (!ReadRawBlockFromDisk(spanDisk, pindex, messageStart))
+            return false;
+        // Copy the block, so the cache does not keep its file mapped.
+        pdata = std::make_shared<const std::vector<unsigned char> >(spanDisk.data, spanDisk.data + spanDisk.size);
+        blockCache.Insert(pindex->GetBlockHash(), pdata);
+    }
+    span.owner = pdata;
+    span.data = pdata->data();
+    span.size = pdata->size();
+    return true;
+}
+
+bool DecodeRawBlock(CBlock& block, const CByteSpan& span)
+{
+    block.SetNull();
+    try {
+        CSpanReader reader(SER_DISK, CLIENT_VERSION, span.data, span.size);
+        reader >> block;
+    }
+    catch (const std::exception& e) {
+        return error("%s: Deserialize error - %s", __func__, e.what());
+    }
+    return true;
+}
+
 bool IsInitialBlockDownload()
 {
     const CChainParams& chainParams = Params();
@@ -1381,24 +1506,13 @@ void UpdateCoins(const CTransaction& tx, CCoinsViewCache& inputs, CTxUndo &txund
     if (!tx.IsCoinBase()) {
         txundo.vprevout.reserve(tx.vin.size());
         BOOST_FOREACH(const CTxIn &txin, tx.vin) {
-            CCoinsModifier coins = inputs.ModifyCoins(txin.prevout.hash);
-            unsigned nPos = txin.prevout.n;
-
-            if (nPos >= coins->vout.size() || coins->vout[nPos].IsNull())
-                assert(false);
-            // mark an outpoint spent, and construct undo information
-            txundo.vprevout.push_back(CTxInUndo(coins->vout[nPos]));
-            coins->Spend(nPos);
-            if (coins->vout.size() == 0) {
-                CTxInUndo& undo = txundo.vprevout.back();
-                undo.nHeight = coins->nHeight;
-                undo.fCoinBase = coins->fCoinBase;
-                undo.nVersion = coins->nVersion;
-            }
+            txundo.vprevout.emplace_back();
+            bool is_spent = inputs.SpendCoin(txin.prevout, &txundo.vprevout.back());
+            assert(is_spent);
         }
     }
     // add outputs
-    inputs.ModifyNewCoins(tx.GetHash(), tx.IsCoinBase())->FromTx(tx, nHeight);
+    AddCoins(inputs, tx, nHeight);
 }
 
 void UpdateCoins(const CTransaction& tx, CCoinsViewCache& inputs, int nHeight)
@@ -1436,22 +1550,22 @@ bool CheckTxInputs(const CChainParams& params, const CTransaction& tx, CValidati
         for (unsigned int i = 0; i < tx.vin.size(); i++)
         {
             const COutPoint &prevout = tx.vin[i].prevout;
-            const CCoins *coins = inputs.AccessCoins(prevout.hash);
-            assert(coins);
+            const Coin& coin = inputs.AccessCoin(prevout);
+            assert(!coin.IsSpent());
 
             // If prev is coinbase, check that it's matured
-            if (coins->IsCoinBase()) {
+            if (coin.IsCoinBase()) {
                 // junkcoin: Switch maturity at digishield activation
-                int nCoinbaseMaturity = params.GetConsensus(coins->nHeight).nCoinbaseMaturity;
-                if (nSpendHeight - coins->nHeight < nCoinbaseMaturity)
+                int nCoinbaseMaturity = params.GetConsensus(coin.nHeight).nCoinbaseMaturity;
+                if (nSpendHeight - coin.nHeight < nCoinbaseMaturity)
                     return state.Invalid(false,
                         REJECT_INVALID, "bad-txns-premature-spend-of-coinbase",
-                        strprintf("tried to spend coinbase at depth %d", nSpendHeight - coins->nHeight));
+                        strprintf("tried to spend coinbase at depth %d", nSpendHeight - coin.nHeight));
             }
 
             // Check for negative or overflow input values
-            nValueIn += coins->vout[prevout.n].nValue;
-            if (!MoneyRange(coins->vout[prevout.n].nValue) || !MoneyRange(nValueIn))
+            nValueIn += coin.out.nValue;
+            if (!MoneyRange(coin.out.nValue) || !MoneyRange(nValueIn))
                 return state.DoS(100, false, REJECT_INVALID, "bad-txns-inputvalues-outofrange");
 
         }
@@ -1493,11 +1607,11 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
         if (fScriptChecks) {
             for (unsigned int i = 0; i < tx.vin.size(); i++) {
                 const COutPoint &prevout = tx.vin[i].prevout;
-                const CCoins* coins = inputs.AccessCoins(prevout.hash);
-                assert(coins);
+                const Coin& coin = inputs.AccessCoin(prevout);
+                assert(!coin.IsSpent());
 
                 // Verify signature
-                CScriptCheck check(*coins, tx, i, flags, cacheStore, &txdata);
+                CScriptCheck check(coin.out, tx, i, flags, cacheStore, &txdata);
                 if (pvChecks) {
                     pvChecks->push_back(CScriptCheck());
                     check.swap(pvChecks->back());
@@ -1509,7 +1623,7 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
                         // arguments; if so, don't trigger DoS protection to
                         // avoid splitting the network between upgraded and
                         // non-upgraded nodes.
-                        CScriptCheck check2(*coins, tx, i,
+                        CScriptCheck check2(coin.out, tx, i,
                                 flags & ~STANDARD_NOT_MANDATORY_VERIFY_FLAGS, cacheStore, &txdata);
                         if (check2())
                             return state.Invalid(false, REJECT_NONSTANDARD, strprintf("non-mandatory-script-verify-flag (%s)", ScriptErrorString(check.GetScriptError())));
@@ -1561,19 +1675,32 @@ bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint
 
 bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uint256& hashBlock)
 {
-    // Open history file to read
-    CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("%s: OpenUndoFile failed", __func__);
-
-    // Read block
     uint256 hashChecksum;
-    try {
-        filein >> blockundo;
-        filein >> hashChecksum;
-    }
-    catch (const std::exception& e) {
-        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+    CByteSpan span;
+    if (pblockFileMap && pblockFileMap->GetRecord(pos, "rev", Params().MessageStart(), sizeof(hashChecksum), span)) {
+        // Deserialize straight from the mapped file
+        try {
+            CSpanReader reader(SER_DISK, CLIENT_VERSION, span.data, span.size);
+            reader >> blockundo;
+            reader >> hashChecksum;
+        }
+        catch (const std::exception& e) {
+            return error("%s: Deserialize error - %s", __func__, e.what());
+        }
+    } else {
+        // Open history file to read
+        CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            return error("%s: OpenUndoFile failed", __func__);
+
+        // Read block
+        try {
+            filein >> blockundo;
+            filein >> hashChecksum;
+        }
+        catch (const std::exception& e) {
+            return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+        }
     }
 
     // Verify checksum
@@ -1609,40 +1736,46 @@ bool AbortNode(CValidationState& state, const std::string& strMessage, const std
 
 } // anon namespace
 
+/** Result of undoing the effect of a block, or of one of its inputs, on the UTXO set. */
+enum DisconnectResult
+{
+    DISCONNECT_OK,      // All good.
+    DISCONNECT_UNCLEAN, // Rolled back, but UTXO set was inconsistent with block.
+    DISCONNECT_FAILED   // Something else went wrong.
+};
+
 /**
- * Apply the undo operation of a CTxInUndo to the given chain state.
- * @param undo The undo object.
+ * Restore the UTXO in a Coin at a given COutPoint
+ * @param undo The Coin to be restored.
  * @param view The coins view to which to apply the changes.
  * @param out The out point that corresponds to the tx input.
- * @return True on success.
+ * @return A DisconnectResult as an int
  */
-bool ApplyTxInUndo(const CTxInUndo& undo, CCoinsViewCache& view, const COutPoint& out)
+int ApplyTxInUndo(Coin&& undo, CCoinsViewCache& view, const COutPoint& out)
 {
     bool fClean = true;
 
-    CCoinsModifier coins = view.ModifyCoins(out.hash);
-    if (undo.nHeight != 0) {
-        // undo data contains height: this is the last output of the prevout tx being spent
-        if (!coins->IsPruned())
-            fClean = fClean && error("%s: undo data overwriting existing transaction", __func__);
-        coins->Clear();
-        coins->fCoinBase = undo.fCoinBase;
-        coins->nHeight = undo.nHeight;
-        coins->nVersion = undo.nVersion;
-    } else {
-        if (coins->IsPruned())
-            fClean = fClean && error("%s: undo data adding output to missing transaction", __func__);
-    }
-    if (coins->IsAvailable(out.n))
+    if (view.HaveCoin(out))
         fClean = fClean && error("%s: undo data overwriting existing output", __func__);
-    if (coins->vout.size() < out.n+1)
-        coins->vout.resize(out.n+1);
-    coins->vout[out.n] = undo.txout;
 
-    return fClean;
+    if (undo.nHeight == 0) {
+        // Missing undo metadata (height and coinbase). Older versions included this
+        // information only in undo records for the last spend of a transactions'
+        // outputs. This implies that it must be present for some other output of the same tx.
+        const Coin& alternate = AccessByTxid(view, out.hash);
+        if (alternate.IsSpent()) {
+            error("%s: undo data adding output to missing transaction", __func__);
+            return DISCONNECT_FAILED;
+        }
+        undo.nHeight = alternate.nHeight;
+        undo.fCoinBase = alternate.fCoinBase;
+    }
+    view.AddCoin(out, std::move(undo), !fClean);
+
+    return fClean ? DISCONNECT_OK : DISCONNECT_UNCLEAN;
 }
 
-bool DisconnectBlock(const CBlock& block, CValidationState& state, const CBlockIndex* pindex, CCoinsViewCache& view, bool* pfClean)
+bool DisconnectBlock(const CBlock& block, CValidationState& state, const CBlockIndex* pindex, CCoinsViewCache& view, bool* pfClean, CUTXOCommitment* pcommitment)
 {
     assert(pindex->GetBlockHash() == view.GetBestBlock());
 
@@ -1650,6 +1783,7 @@ bool DisconnectBlock(const CBlock& block, CValidationState& state, const CBlockI
         *pfClean = false;
 
     bool fClean = true;
+    CUTXOCommitment delta;
 
     CBlockUndo blockUndo;
     CDiskBlockPos pos = pindex->GetUndoPos();
@@ -1666,36 +1800,41 @@ bool DisconnectBlock(const CBlock& block, CValidationState& state, const CBlockI
     for (int i = block.vtx.size() - 1; i >= 0; i--) {
         const CTransaction &tx = *(block.vtx[i]);
         uint256 hash = tx.GetHash();
+        bool fCoinBase = tx.IsCoinBase();
 
         // Check that all outputs are available and match the outputs in the block itself
         // exactly.
-        {
-        CCoinsModifier outs = view.ModifyCoins(hash);
-        outs->ClearUnspendable();
-
-        CCoins outsBlock(tx, pindex->nHeight);
-        // The CCoins serialization does not serialize negative numbers.
-        // No network rules currently depend on the version here, so an inconsistency is harmless
-        // but it must be corrected before txout nversion ever influences a network rule.
-        if (outsBlock.nVersion < 0)
-            outs->nVersion = outsBlock.nVersion;
-        if (*outs != outsBlock)
-            fClean = fClean && error("DisconnectBlock(): added transaction mismatch? database corrupted");
-
-        // remove outputs
-        outs->Clear();
+        for (size_t o = 0; o < tx.vout.size(); o++) {
+            if (!tx.vout[o].scriptPubKey.IsUnspendable()) {
+                COutPoint out(hash, o);
+                Coin coin;
+                bool fSpent = view.SpendCoin(out, &coin);
+                if (!fSpent || tx.vout[o] != coin.out || pindex->nHeight != (int)coin.nHeight || fCoinBase != (bool)coin.fCoinBase)
+                    fClean = fClean && error("DisconnectBlock(): added transaction mismatch? database corrupted");
+                if (pcommitment && fSpent)
+                    delta.Remove(out, coin);
+            }
         }
 
         // restore inputs
         if (i > 0) { // not coinbases
-            const CTxUndo &txundo = blockUndo.vtxundo[i-1];
+            CTxUndo &txundo = blockUndo.vtxundo[i-1];
             if (txundo.vprevout.size() != tx.vin.size())
                 return error("DisconnectBlock(): transaction and undo data inconsistent");
             for (unsigned int j = tx.vin.size(); j-- > 0;) {
                 const COutPoint &out = tx.vin[j].prevout;
-                const CTxInUndo &undo = txundo.vprevout[j];
-                if (!ApplyTxInUndo(undo, view, out))
-                    fClean = false;
+                if (pcommitment) {
+                    // An unclean restore overwrites whatever is there.
+                    const Coin& existing = view.AccessCoin(out);
+                    if (!existing.IsSpent())
+                        delta.Remove(out, existing);
+                }
+                int res = ApplyTxInUndo(std::move(txundo.vprevout[j]), view, out);
+                if (res == DISCONNECT_FAILED)
+                    return error("DisconnectBlock(): cannot restore input %s", out.ToString());
+                fClean = fClean && res != DISCONNECT_UNCLEAN;
+                if (pcommitment)
+                    delta.Add(out, view.AccessCoin(out));
             }
         }
     }
@@ -1703,6 +1842,11 @@ bool DisconnectBlock(const CBlock& block, CValidationState& state, const CBlockI
     // move best block pointer to prevout block
     view.SetBestBlock(pindex->pprev->GetBlockHash());
 
+    if (pcommitment && (fClean || pfClean)) {
+        pcommitment->Apply(delta);
+        pcommitment->hashBlock = pindex->pprev->GetBlockHash();
+    }
+
     if (pfClean) {
         *pfClean = fClean;
         return true;
@@ -1732,6 +1876,10 @@ void static FlushBlockFile(bool fFinalize = false)
         FileCommit(fileOld);
         fclose(fileOld);
     }
+
+    // Mappings of the preallocated space past the new end would fault.
+    if (fFinalize && pblockFileMap)
+        pblockFileMap->Forget(nLastBlockFile);
 }
 
 bool FindUndoPos(CValidationState &state, int nFile, CDiskBlockPos &pos, unsigned int nAddSize);
@@ -1743,6 +1891,42 @@ void ThreadScriptCheck() {
     scriptcheckqueue.Thread();
 }
 
+/**
+ * Context-free proof-of-work check of a slice of a headers message. The
+ * outcome for each header is written to its own slot in results, so slices
+ * can be checked concurrently.
+ */
+class CHeaderPoWCheck
+{
+private:
+    const CBlockHeader* headers;
+    size_t count;
+    unsigned char* results;
+
+public:
+    CHeaderPoWCheck(): headers(NULL), count(0), results(NULL) {}
+    CHeaderPoWCheck(const CBlockHeader* headersIn, size_t countIn, unsigned char* resultsIn) :
+        headers(headersIn), count(countIn), results(resultsIn) {}
+
+    bool operator()() {
+        CheckAuxPowProofOfWorkBatch(headers, count, Params().GetConsensus(0), results);
+        return true;
+    }
+
+    void swap(CHeaderPoWCheck& check) {
+        std::swap(headers, check.headers);
+        std::swap(count, check.count);
+        std::swap(results, check.results);
+    }
+};
+
+static CCheckQueue<CHeaderPoWCheck> headercheckqueue(4);
+
+void ThreadHeaderCheck() {
+    RenameThread("junkcoin-headerch");
+    headercheckqueue.Thread();
+}
+
 // Protected by cs_main
 VersionBitsCache versionbitscache;
 
@@ -1797,7 +1981,7 @@ static int64_t nTimeCallbacks = 0;
 static int64_t nTimeTotal = 0;
 
 bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex,
-                  CCoinsViewCache& view, const CChainParams& chainparams, bool fJustCheck)
+                  CCoinsViewCache& view, const CChainParams& chainparams, bool fJustCheck, CUTXOCommitment* pcommitment)
 {
     AssertLockHeld(cs_main);
 
@@ -1835,8 +2019,11 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     // Special case for the genesis block, skipping connection of its transactions
     // (its coinbase is unspendable)
     if (block.GetHash() == Params().GetConsensus(0).hashGenesisBlock) {
-        if (!fJustCheck)
+        if (!fJustCheck) {
             view.SetBestBlock(pindex->GetBlockHash());
+            if (pcommitment)
+                pcommitment->hashBlock = pindex->GetBlockHash();
+        }
         return true;
     }
 
@@ -1907,10 +2094,12 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 
     if (fEnforceBIP30) {
         for (const auto& tx : block.vtx) {
-            const CCoins* coins = view.AccessCoins(tx->GetHash());
-            if (coins && !coins->IsPruned())
-                return state.DoS(100, error("ConnectBlock(): tried to overwrite transaction"),
-                                 REJECT_INVALID, "bad-txns-BIP30");
+            for (size_t o = 0; o < tx->vout.size(); o++) {
+                if (view.HaveCoin(COutPoint(tx->GetHash(), o))) {
+                    return state.DoS(100, error("ConnectBlock(): tried to overwrite transaction"),
+                                     REJECT_INVALID, "bad-txns-BIP30");
+                }
+            }
         }
     }
 
@@ -1955,6 +2144,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     LogPrint("bench", "    - Fork checks: %.2fms [%.2fs]\n", 0.001 * (nTime2 - nTime1), nTimeForks * 0.000001);
 
     CBlockUndo blockundo;
+    CUTXOCommitment commitmentDelta;
 
     CCheckQueueControl<CScriptCheck> control(fScriptChecks && nScriptCheckThreads ? &scriptcheckqueue : NULL);
 
@@ -1985,7 +2175,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
             // be in ConnectBlock because they require the UTXO set
             prevheights.resize(tx.vin.size());
             for (size_t j = 0; j < tx.vin.size(); j++) {
-                prevheights[j] = view.AccessCoins(tx.vin[j].prevout.hash)->nHeight;
+                prevheights[j] = view.AccessCoin(tx.vin[j].prevout).nHeight;
             }
 
             if (!SequenceLocks(tx, nLockTimeFlags, &prevheights, *pindex)) {
@@ -2020,7 +2210,28 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         if (i > 0) {
             blockundo.vtxundo.push_back(CTxUndo());
         }
+        if (pcommitment && !fJustCheck && !fEnforceBIP30 && tx.IsCoinBase()) {
+            // Without BIP30 a coinbase can overwrite an unspent output of an
+            // earlier one, which then leaves the set.
+            for (size_t o = 0; o < tx.vout.size(); o++) {
+                COutPoint out(tx.GetHash(), o);
+                const Coin& existing = view.AccessCoin(out);
+                if (!existing.IsSpent())
+                    commitmentDelta.Remove(out, existing);
+            }
+        }
         UpdateCoins(tx, view, i == 0 ? undoDummy : blockundo.vtxundo.back(), pindex->nHeight);
+        if (pcommitment && !fJustCheck) {
+            if (i > 0) {
+                const CTxUndo& txundo = blockundo.vtxundo.back();
+                for (size_t j = 0; j < tx.vin.size(); j++)
+                    commitmentDelta.Remove(tx.vin[j].prevout, txundo.vprevout[j]);
+            }
+            for (size_t o = 0; o < tx.vout.size(); o++) {
+                if (!tx.vout[o].scriptPubKey.IsUnspendable())
+                    commitmentDelta.Add(COutPoint(tx.GetHash(), o), Coin(tx.vout[o], pindex->nHeight, tx.IsCoinBase()));
+            }
+        }
 
         vPos.push_back(std::make_pair(tx.GetHash(), pos));
         pos.nTxOffset += ::GetSerializeSize(tx, SER_DISK, CLIENT_VERSION);
@@ -2068,6 +2279,10 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
+    if (pcommitment) {
+        pcommitment->Apply(commitmentDelta);
+        pcommitment->hashBlock = pindex->GetBlockHash();
+    }
 
     int64_t nTime5 = GetTimeMicros(); nTimeIndex += nTime5 - nTime4;
     LogPrint("bench", "    - Index writing: %.2fms [%.2fs]\n", 0.001 * (nTime5 - nTime4), nTimeIndex * 0.000001);
@@ -2172,15 +2387,22 @@ bool static FlushStateToDisk(CValidationState &state, FlushStateMode mode, int n
     }
     // Flush best chain related state. This can only be done if the blocks / block index write was also done.
     if (fDoFullFlush) {
-        // Typical CCoins structures on disk are around 128 bytes in size.
+        // Typical Coin structures on disk are around 48 bytes in size.
         // Pushing a new one to the database can cause it to be written
         // twice (once in the log, and once in the tables). This is already
         // an overestimation, as most will delete an existing entry or
         // overwrite one. Still, use a conservative safety factor of 2.
-        if (!CheckDiskSpace(128 * 2 * 2 * pcoinsTip->GetCacheSize()))
+        if (!CheckDiskSpace(48 * 2 * 2 * pcoinsTip->GetCacheSize()))
             return state.Error("out of disk space");
-        // Flush the chainstate (which may refer to block index entries).
-        if (!pcoinsTip->Flush())
+        // Flush the chainstate (which may refer to block index entries),
+        // keeping the most recently created coins in the cache so the hit
+        // rate does not drop to zero right after.
+        size_t nKeepUsage = nCoinCacheUsage / DB_PEAK_USAGE_FACTOR / 100 * std::max<int64_t>(0, std::min<int64_t>(100, GetArg("-dbcachekeep", DEFAULT_COINS_CACHE_KEEP)));
+        if (!pcoinsTip->FlushAndTrim(nKeepUsage))
+            return AbortNode(state, "Failed to write to coin database");
+        // The write goes on in the background, unless it has to be on disk
+        // by the time we return, or block files are being pruned.
+        if ((mode == FLUSH_STATE_ALWAYS || fFlushForPrune) && pcoinsFlusher && !pcoinsFlusher->Sync())
             return AbortNode(state, "Failed to write to coin database");
         nLastFlush = nNow;
     }
@@ -2206,9 +2428,31 @@ void PruneAndFlush() {
     FlushStateToDisk(state, FLUSH_STATE_NONE);
 }
 
+/** Make the current tip of chainActive the one GetChainTipSnapshot returns */
+static void PublishChainTip()
+{
+    std::atomic_store(&chainTipSnapshot, std::make_shared<const CChainTip>(chainActive.Tip()));
+}
+
+std::shared_ptr<const CChainTip> GetChainTipSnapshot()
+{
+    return std::atomic_load(&chainTipSnapshot);
+}
+
+const CBlockIndex* LookupBlockIndex(const uint256& hash)
+{
+    boost::shared_lock<boost::shared_mutex> lockLookup(csBlockIndexLookup);
+    BlockMap::const_iterator it = mapBlockIndex.find(hash);
+    return it == mapBlockIndex.end() ? NULL : it->second;
+}
+
 /** Update chainActive and related internal data structures. */
 void static UpdateTip(CBlockIndex *pindexNew, const CChainParams& chainParams) {
     chainActive.SetTip(pindexNew);
+    PublishChainTip();
+    // Coins staged for blocks up to here are not going to be used any more.
+    if (pcoinsPrefetch)
+        pcoinsPrefetch->Expire(chainActive.Height());
 
     // New best block
     mempool.AddTransactionsUpdated(1);
@@ -2258,7 +2502,7 @@ void static UpdateTip(CBlockIndex *pindexNew, const CChainParams& chainParams) {
             }
         }
     }
-    LogPrintf("%s: new best=%s height=%d version=0x%08x log2_work=%.8g tx=%lu date='%s' progress=%f cache=%.1fMiB(%utx)", __func__,
+    LogPrintf("%s: new best=%s height=%d version=0x%08x log2_work=%.8g tx=%lu date='%s' progress=%f cache=%.1fMiB(%utxo)", __func__,
       chainActive.Tip()->GetBlockHash().ToString(), chainActive.Height(), chainActive.Tip()->nVersion,
       log(chainActive.Tip()->nChainWork.getdouble())/log(2.0), (unsigned long)chainActive.Tip()->nChainTx,
       DateTimeStrFormat("%Y-%m-%d %H:%M:%S", chainActive.Tip()->GetBlockTime()),
@@ -2282,7 +2526,7 @@ bool static DisconnectTip(CValidationState& state, const CChainParams& chainpara
     int64_t nStart = GetTimeMicros();
     {
         CCoinsViewCache view(pcoinsTip);
-        if (!DisconnectBlock(block, state, pindexDelete, view))
+        if (!DisconnectBlock(block, state, pindexDelete, view, NULL, &utxoCommitment))
             return error("DisconnectTip(): DisconnectBlock %s failed", pindexDelete->GetBlockHash().ToString());
         bool flushed = view.Flush();
         assert(flushed);
@@ -2339,7 +2583,8 @@ struct ConnectTrace {
 
 /**
  * Connect a new block to chainActive. pblock is either NULL or a pointer to a CBlock
- * corresponding to pindexNew, to bypass loading it again from disk.
+ * corresponding to pindexNew, to bypass loading it again from disk. Without pblock,
+ * a copy that pblockReadAhead has already read is used if there is one.
  *
  * The block is always added to connectTrace (either after loading from disk or by copying
  * pblock) - if that is not intended, care must be taken to remove the last entry in
@@ -2350,7 +2595,12 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
     assert(pindexNew->pprev == chainActive.Tip());
     // Read block from disk.
     int64_t nTime1 = GetTimeMicros();
-    if (!pblock) {
+    std::shared_ptr<const CBlock> pblockReadAheadNew;
+    if (!pblock && pblockReadAhead)
+        pblockReadAheadNew = pblockReadAhead->Take(pindexNew);
+    if (pblockReadAheadNew) {
+        connectTrace.blocksConnected.emplace_back(pindexNew, pblockReadAheadNew);
+    } else if (!pblock) {
         std::shared_ptr<CBlock> pblockNew = std::make_shared<CBlock>();
         connectTrace.blocksConnected.emplace_back(pindexNew, pblockNew);
         if (!ReadBlockFromDisk(*pblockNew, pindexNew, chainparams.GetConsensus(pindexNew->nHeight)))
@@ -2365,7 +2615,7 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
     LogPrint("bench", "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * 0.001, nTimeReadFromDisk * 0.000001);
     {
         CCoinsViewCache view(pcoinsTip);
-        bool rv = ConnectBlock(blockConnecting, state, pindexNew, view, chainparams);
+        bool rv = ConnectBlock(blockConnecting, state, pindexNew, view, chainparams, false, &utxoCommitment);
         GetMainSignals().BlockChecked(blockConnecting, state);
         if (!rv) {
             if (state.IsInvalid())
@@ -2500,6 +2750,18 @@ static bool ActivateBestChainStep(CValidationState& state, const CChainParams& c
         }
         nHeight = nTargetHeight;
 
+        // Let the blocks after the one we connect first be read from disk
+        // while that one is being connected.
+        if (pblockReadAhead) {
+            std::vector<const CBlockIndex*> vpindexReadAhead;
+            vpindexReadAhead.reserve(vpindexToConnect.size());
+            BOOST_REVERSE_FOREACH(CBlockIndex *pindexConnect, vpindexToConnect) {
+                if (!(pblock && pindexConnect == pindexMostWork))
+                    vpindexReadAhead.push_back(pindexConnect);
+            }
+            pblockReadAhead->Request(vpindexReadAhead, chainparams);
+        }
+
         // Connect new blocks.
         BOOST_REVERSE_FOREACH(CBlockIndex *pindexConnect, vpindexToConnect) {
             if (!ConnectTip(state, chainparams, pindexConnect, pindexConnect == pindexMostWork ? pblock : std::shared_ptr<const CBlock>(), connectTrace)) {
@@ -2795,9 +3057,18 @@ CBlockIndex* AddToBlockIndex(const CBlockHeader& block)
     if (it != mapBlockIndex.end())
         return it->second;
 
-    // Construct new block index object
-    CBlockIndex* pindexNew = new CBlockIndex(block);
-    assert(pindexNew);
+    // CDiskBlockIndex has no room for the auxpow, so keep it next to the index
+    // entry. This write is not synced, but it is ordered before the synced
+    // index write in FlushStateToDisk. It comes first so that a lock-free
+    // lookup never finds the entry before its auxpow can be read.
+    if (block.auxpow)
+        pblocktree->WriteAuxPow(hash, *block.auxpow);
+
+    // Construct new block index object. Lock-free lookups only find it once
+    // the fields they may read are set.
+    boost::unique_lock<boost::shared_mutex> lockLookup(csBlockIndexLookup);
+    CBlockIndex* pindexNew = blockIndexArena.Allocate();
+    *pindexNew = CBlockIndex(block);
     // We assign the sequence id to blocks only when the full data is available,
     // to avoid miners withholding blocks but broadcasting headers, to get a
     // competitive advantage.
@@ -2814,6 +3085,9 @@ CBlockIndex* AddToBlockIndex(const CBlockHeader& block)
     pindexNew->nTimeMax = (pindexNew->pprev ? std::max(pindexNew->pprev->nTimeMax, pindexNew->nTime) : pindexNew->nTime);
     pindexNew->nChainWork = (pindexNew->pprev ? pindexNew->pprev->nChainWork : 0) + GetBlockProof(*pindexNew);
     pindexNew->RaiseValidity(BLOCK_VALID_TREE);
+    if (block.auxpow)
+        pindexNew->nStatus |= BLOCK_HAVE_AUXPOW;
+    lockLookup.unlock();
     if (pindexBestHeader == NULL || pindexBestHeader->nChainWork < pindexNew->nChainWork)
         pindexBestHeader = pindexNew;
 
@@ -3274,7 +3548,7 @@ bool ContextualCheckBlock(const CBlock& block, CValidationState& state, const CB
 }
 
 
-static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex)
+static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fCheckPOW = true)
 {
     AssertLockHeld(cs_main);
     // Check for duplicate
@@ -3293,7 +3567,7 @@ static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state
             return true;
         }
 
-        if (!CheckBlockHeader(block, state))
+        if (!CheckBlockHeader(block, state, fCheckPOW))
             return error("%s: Consensus::CheckBlockHeader: %s, %s", __func__, hash.ToString(), FormatStateMessage(state));
 
         // Get prev block index
@@ -3340,14 +3614,60 @@ static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state
     return true;
 }
 
+/** Number of headers hashed together by one CHeaderPoWCheck */
+static const size_t HEADER_POW_CHECK_SLICE = 32;
+
+/**
+ * Check the proof of work of headers[nFirst..], spread over the header check
+ * threads. vPoWOk[i] is set when headers[i] is known to have valid PoW.
+ */
+static void CheckHeadersProofOfWork(const std::vector<CBlockHeader>& headers, size_t nFirst, std::vector<unsigned char>& vPoWOk)
+{
+    vPoWOk.assign(headers.size(), 0);
+
+    std::vector<CHeaderPoWCheck> vChecks;
+    for (size_t i = nFirst; i < headers.size(); i += HEADER_POW_CHECK_SLICE) {
+        const size_t nCount = std::min(HEADER_POW_CHECK_SLICE, headers.size() - i);
+        vChecks.push_back(CHeaderPoWCheck(&headers[i], nCount, &vPoWOk[i]));
+    }
+
+    if (nScriptCheckThreads) {
+        CCheckQueueControl<CHeaderPoWCheck> control(&headercheckqueue);
+        control.Add(vChecks);
+        control.Wait();
+    } else {
+        for (CHeaderPoWCheck& check : vChecks)
+            check();
+    }
+}
+
 // Exposed wrapper for AcceptBlockHeader
 bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex)
 {
+    // The context-free PoW checks of a whole headers message are done up front
+    // and outside cs_main; only the contextual part below is serial. Headers
+    // that fail here are checked again in AcceptBlockHeader, so the rejection
+    // (and DoS scoring) is the same as before.
+    std::vector<unsigned char> vPoWOk;
+    if (headers.size() > 1) {
+        // Peers usually resend a few headers we already have at the start of a
+        // batch; those never reach the PoW check, so do not hash them.
+        size_t nFirst = 0;
+        {
+            LOCK(cs_main);
+            while (nFirst < headers.size() && mapBlockIndex.count(headers[nFirst].GetHash()))
+                nFirst++;
+        }
+        CheckHeadersProofOfWork(headers, nFirst, vPoWOk);
+    }
+
     {
         LOCK(cs_main);
-        for (const CBlockHeader& header : headers) {
+        for (size_t i = 0; i < headers.size(); i++) {
+            const CBlockHeader& header = headers[i];
+            const bool fCheckPOW = vPoWOk.empty() || !vPoWOk[i];
             CBlockIndex *pindex = NULL; // Use a temp pindex instead of ppindex to avoid a const_cast
-            if (!AcceptBlockHeader(header, state, chainparams, &pindex)) {
+            if (!AcceptBlockHeader(header, state, chainparams, &pindex, fCheckPOW)) {
                 return false;
             }
             if (ppindex) {
@@ -3359,6 +3679,34 @@ bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidatio
     return true;
 }
 
+/**
+ * Queue the coins spent by a block that is about to be connected for reading
+ * ahead, skipping those created within the block itself and those already in
+ * the coins cache.
+ */
+static void PrefetchBlockInputs(const CBlock& block, int nHeight)
+{
+    AssertLockHeld(cs_main);
+    if (!pcoinsPrefetch)
+        return;
+
+    std::set<uint256> setBlockTxids;
+    BOOST_FOREACH(const CTransactionRef& tx, block.vtx)
+        setBlockTxids.insert(tx->GetHash());
+
+    std::vector<COutPoint> vOutPoints;
+    BOOST_FOREACH(const CTransactionRef& tx, block.vtx) {
+        if (tx->IsCoinBase())
+            continue;
+        BOOST_FOREACH(const CTxIn& txin, tx->vin) {
+            if (setBlockTxids.count(txin.prevout.hash) || pcoinsTip->HaveCoinInCache(txin.prevout))
+                continue;
+            vOutPoints.push_back(txin.prevout);
+        }
+    }
+    pcoinsPrefetch->Prefetch(std::move(vOutPoints), nHeight);
+}
+
 /** Store block on disk. If dbp is non-NULL, the file is known to already reside on disk */
 static bool AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fRequested, const CDiskBlockPos* dbp, bool* fNewBlock)
 {
@@ -3370,7 +3718,8 @@ static bool AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidation
     CBlockIndex *pindexDummy = NULL;
     CBlockIndex *&pindex = ppindex ? *ppindex : pindexDummy;
 
-    if (!AcceptBlockHeader(block, state, chainparams, &pindex))
+    // A block that passed CheckBlock already had its PoW checked.
+    if (!AcceptBlockHeader(block, state, chainparams, &pindex, !block.fChecked))
         return false;
 
     // Try to process all requested blocks that we don't have, but only
@@ -3433,6 +3782,11 @@ static bool AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidation
         return AbortNode(state, std::string("System error: ") + e.what());
     }
 
+    // Start reading the coins this block spends while it waits to be
+    // connected, unless it is too far ahead for them to stay staged.
+    if (nHeight > chainActive.Height() && nHeight <= chainActive.Height() + COINS_PREFETCH_WINDOW)
+        PrefetchBlockInputs(block, nHeight);
+
     if (fCheckForPruning)
         FlushStateToDisk(state, FLUSH_STATE_NONE); // we just allocated more disk space for block files
 
@@ -3624,6 +3978,8 @@ void UnlinkPrunedFiles(const std::set<int>& setFilesToPrune)
 {
     for (std::set<int>::iterator it = setFilesToPrune.begin(); it != setFilesToPrune.end(); ++it) {
         CDiskBlockPos pos(*it, 0);
+        if (pblockFileMap)
+            pblockFileMap->Forget(*it);
         boost::filesystem::remove(GetBlockPosFilename(pos, "blk"));
         boost::filesystem::remove(GetBlockPosFilename(pos, "rev"));
         LogPrintf("Prune: %s deleted blk/rev (%05u)\n", __func__, *it);
@@ -3765,39 +4121,111 @@ CBlockIndex * InsertBlockIndex(uint256 hash)
         return (*mi).second;
 
     // Create new
-    CBlockIndex* pindexNew = new CBlockIndex();
-    if (!pindexNew)
-        throw std::runtime_error(std::string(__func__) + ": new CBlockIndex failed");
+    boost::unique_lock<boost::shared_mutex> lockLookup(csBlockIndexLookup);
+    CBlockIndex* pindexNew = blockIndexArena.Allocate();
     mi = mapBlockIndex.insert(std::make_pair(hash, pindexNew)).first;
     pindexNew->phashBlock = &((*mi).first);
 
     return pindexNew;
 }
 
+/** Number of headers rebuilt and checked at a time by -checkheaderpow */
+static const size_t HEADER_POW_RECHECK_BATCH = 2000;
+
+/**
+ * Rebuild every header of the block index, including its auxpow, and check
+ * its proof of work again. Auxpow data that is still only available in the
+ * block files is copied to the block tree database on the way.
+ */
+static bool CheckBlockIndexProofOfWork(const CChainParams& chainparams, const std::vector<std::pair<int, CBlockIndex*> >& vSortedByHeight)
+{
+    const Consensus::Params& consensusParams = chainparams.GetConsensus(0);
+    std::vector<CBlockHeader> vHeaders;
+    std::vector<const CBlockIndex*> vIndex;
+    std::vector<unsigned char> vPoWOk;
+    size_t nChecked = 0, nStored = 0, nMissing = 0;
+
+    for (size_t i = 0; i < vSortedByHeight.size(); i++) {
+        CBlockIndex* pindex = vSortedByHeight[i].second;
+        if ((pindex->nStatus & BLOCK_VALID_MASK) != BLOCK_VALID_UNKNOWN) {
+            CBlockHeader header;
+            if (!pindex->GetBlockHeader(header, consensusParams, false)) {
+                // Pruned before the block tree database kept the auxpow
+                nMissing++;
+            } else {
+                if (header.auxpow && !(pindex->nStatus & BLOCK_HAVE_AUXPOW)) {
+                    pblocktree->WriteAuxPow(pindex->GetBlockHash(), *header.auxpow);
+                    pindex->nStatus |= BLOCK_HAVE_AUXPOW;
+                    setDirtyBlockIndex.insert(pindex);
+                    nStored++;
+                }
+                vHeaders.push_back(header);
+                vIndex.push_back(pindex);
+            }
+        }
+
+        if (vHeaders.size() == HEADER_POW_RECHECK_BATCH || (i + 1 == vSortedByHeight.size() && !vHeaders.empty())) {
+            boost::this_thread::interruption_point();
+            CheckHeadersProofOfWork(vHeaders, 0, vPoWOk);
+            for (size_t j = 0; j < vHeaders.size(); j++) {
+                if (!vPoWOk[j])
+                    return error("%s: invalid proof of work in block index entry %s", __func__, vIndex[j]->ToString());
+            }
+            nChecked += vHeaders.size();
+            vHeaders.clear();
+            vIndex.clear();
+        }
+    }
+
+    LogPrintf("%s: checked %u headers, stored %u auxpows, %u auxpows unavailable\n", __func__, nChecked, nStored, nMissing);
+    return true;
+}
+
 bool static LoadBlockIndexDB(const CChainParams& chainparams)
 {
-    if (!pblocktree->LoadBlockIndexGuts(InsertBlockIndex))
+    int nLoadThreads = std::max(1, std::min(GetNumCores(), MAX_BLOCK_INDEX_LOAD_THREADS));
+    if (!pblocktree->LoadBlockIndexGuts(InsertBlockIndex, nLoadThreads))
         return false;
 
     boost::this_thread::interruption_point();
 
-    // Calculate nChainWork
-    std::vector<std::pair<int, CBlockIndex*> > vSortedByHeight;
-    vSortedByHeight.reserve(mapBlockIndex.size());
+    uint256 hashSnapshotBase;
+    unsigned int nSnapshotChainTx = 0;
+    if (pblocktree->ReadSnapshotBase(hashSnapshotBase, nSnapshotChainTx)) {
+        BlockMap::iterator it = mapBlockIndex.find(hashSnapshotBase);
+        if (it != mapBlockIndex.end())
+            pindexSnapshotBase = it->second;
+    }
+
+    // Calculate nChainWork. Heights are dense, so a counting sort orders the
+    // entries; the work of each block was already computed while loading.
+    std::vector<size_t> vHeightCount;
+    BOOST_FOREACH(const PAIRTYPE(uint256, CBlockIndex*)& item, mapBlockIndex)
+    {
+        size_t nHeight = item.second->nHeight;
+        if (nHeight + 1 >= vHeightCount.size())
+            vHeightCount.resize(nHeight + 2);
+        vHeightCount[nHeight + 1]++;
+    }
+    for (size_t i = 1; i < vHeightCount.size(); i++)
+        vHeightCount[i] += vHeightCount[i - 1];
+    std::vector<std::pair<int, CBlockIndex*> > vSortedByHeight(mapBlockIndex.size());
     BOOST_FOREACH(const PAIRTYPE(uint256, CBlockIndex*)& item, mapBlockIndex)
     {
         CBlockIndex* pindex = item.second;
-        vSortedByHeight.push_back(std::make_pair(pindex->nHeight, pindex));
+        vSortedByHeight[vHeightCount[pindex->nHeight]++] = std::make_pair(pindex->nHeight, pindex);
     }
-    sort(vSortedByHeight.begin(), vSortedByHeight.end());
     BOOST_FOREACH(const PAIRTYPE(int, CBlockIndex*)& item, vSortedByHeight)
     {
         CBlockIndex* pindex = item.second;
-        pindex->nChainWork = (pindex->pprev ? pindex->pprev->nChainWork : 0) + GetBlockProof(*pindex);
+        pindex->nChainWork = (pindex->pprev ? pindex->pprev->nChainWork : 0) + pindex->nChainWork;
         pindex->nTimeMax = (pindex->pprev ? std::max(pindex->pprev->nTimeMax, pindex->nTime) : pindex->nTime);
         // We can link the chain of blocks for which we've received transactions at some point.
-        // Pruned nodes may have deleted the block.
-        if (pindex->nTx > 0) {
+        // Pruned nodes may have deleted the block. The UTXO set may have been loaded at a
+        // block of which we never had the history.
+        if (pindex == pindexSnapshotBase) {
+            pindex->nChainTx = nSnapshotChainTx;
+        } else if (pindex->nTx > 0) {
             if (pindex->pprev) {
                 if (pindex->pprev->nChainTx) {
                     pindex->nChainTx = pindex->pprev->nChainTx + pindex->nTx;
@@ -3824,6 +4252,9 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams)
             pindexBestHeader = pindex;
     }
 
+    if (GetBoolArg("-checkheaderpow", DEFAULT_CHECKHEADERPOW) && !CheckBlockIndexProofOfWork(chainparams, vSortedByHeight))
+        return false;
+
     // Load block file info
     pblocktree->ReadLastBlockFile(nLastBlockFile);
     vinfoBlockFile.resize(nLastBlockFile + 1);
@@ -3878,6 +4309,7 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams)
     if (it == mapBlockIndex.end())
         return true;
     chainActive.SetTip(it->second);
+    PublishChainTip();
 
     PruneBlockIndexCandidates();
 
@@ -3931,9 +4363,9 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
         uiInterface.ShowProgress(_("Verifying blocks..."), percentageDone);
         if (pindex->nHeight < chainActive.Height()-nCheckDepth)
             break;
-        if (fPruneMode && !(pindex->nStatus & BLOCK_HAVE_DATA)) {
-            // If pruning, only go back as far as we have data.
-            LogPrintf("VerifyDB(): block verification stopping at height %d (pruning, no data)\n", pindex->nHeight);
+        if ((fPruneMode || pindexSnapshotBase) && !(pindex->nStatus & BLOCK_HAVE_DATA)) {
+            // If pruning, or running on a loaded UTXO snapshot, only go back as far as we have data.
+            LogPrintf("VerifyDB(): block verification stopping at height %d (no data)\n", pindex->nHeight);
             break;
         }
         CBlock block;
@@ -3996,7 +4428,9 @@ bool RewindBlockIndex(const CChainParams& params)
 {
     LOCK(cs_main);
 
-    int nHeight = 1;
+    // Blocks up to a loaded UTXO snapshot were never validated here, and
+    // cannot be.
+    int nHeight = pindexSnapshotBase ? pindexSnapshotBase->nHeight + 1 : 1;
     while (nHeight <= chainActive.Height()) {
         if (IsWitnessEnabled(chainActive[nHeight - 1], params.GetConsensus(nHeight - 1)) && !(chainActive[nHeight]->nStatus & BLOCK_OPT_WITNESS)) {
             break;
@@ -4084,8 +4518,10 @@ void UnloadBlockIndex()
     LOCK(cs_main);
     setBlockIndexCandidates.clear();
     chainActive.SetTip(NULL);
+    PublishChainTip();
     pindexBestInvalid = NULL;
     pindexBestHeader = NULL;
+    pindexSnapshotBase = NULL;
     mempool.clear();
     mapBlocksUnlinked.clear();
     vinfoBlockFile.clear();
@@ -4099,10 +4535,15 @@ void UnloadBlockIndex()
         warningcache[b].clear();
     }
 
-    BOOST_FOREACH(BlockMap::value_type& entry, mapBlockIndex) {
-        delete entry.second;
+    auxpowCache.Clear();
+    blockCache.Clear();
+    if (pcoinsPrefetch)
+        pcoinsPrefetch->Clear();
+    {
+        boost::unique_lock<boost::shared_mutex> lockLookup(csBlockIndexLookup);
+        mapBlockIndex.clear();
+        blockIndexArena.Clear();
     }
-    mapBlockIndex.clear();
     fHavePruned = false;
 }
 
@@ -4114,6 +4555,85 @@ bool LoadBlockIndex(const CChainParams& chainparams)
     return true;
 }
 
+bool LoadUTXOCommitment(CCoinsViewDB* pcoinsdb)
+{
+    LOCK(cs_main);
+    if (!pcoinsdb->ReadCommitment(utxoCommitment)) {
+        // Nothing stored yet, or stored for another block than the coins
+        // database is at; walk the whole set once.
+        std::unique_ptr<CCoinsViewCursor> pcursor(pcoinsdb->Cursor());
+        CUTXOCommitment commitment;
+        commitment.hashBlock = pcursor->GetBestBlock();
+        LogPrintf("Computing UTXO set commitment at %s...", commitment.hashBlock.ToString());
+        uiInterface.ShowProgress(_("Computing UTXO set commitment"), 0);
+        int reportDone = 0;
+        size_t count = 0;
+        while (pcursor->Valid()) {
+            boost::this_thread::interruption_point();
+            if (ShutdownRequested()) {
+                uiInterface.ShowProgress("", 100);
+                return false;
+            }
+            COutPoint key;
+            Coin coin;
+            if (!pcursor->GetKey(key) || !pcursor->GetValue(coin)) {
+                uiInterface.ShowProgress("", 100);
+                return error("%s: unable to read coin", __func__);
+            }
+            commitment.Add(key, coin);
+            if (count++ % 4096 == 0) {
+                uint32_t high = 0x100 * *key.hash.begin() + *(key.hash.begin() + 1);
+                int percentageDone = (int)(high * 100.0 / 65536.0 + 0.5);
+                uiInterface.ShowProgress(_("Computing UTXO set commitment"), percentageDone);
+                if (reportDone < percentageDone/10) {
+                    // report max. every 10% step
+                    LogPrintf("[%d%%]...", percentageDone);
+                    reportDone = percentageDone/10;
+                }
+            }
+            pcursor->Next();
+        }
+        uiInterface.ShowProgress("", 100);
+        LogPrintf("[DONE].\n");
+        utxoCommitment = commitment;
+    }
+    pcoinsdb->SetCommitment(&utxoCommitment);
+    return true;
+}
+
+bool ActivateUTXOSnapshot(CValidationState& state, CBlockIndex* pindexBase, unsigned int nChainTx, const CUTXOCommitment& commitment)
+{
+    AssertLockHeld(cs_main);
+    assert(pindexBase->pprev && chainActive.Height() == 0);
+
+    pcoinsTip->SetBestBlock(pindexBase->GetBlockHash());
+    utxoCommitment = commitment;
+    utxoCommitment.hashBlock = pindexBase->GetBlockHash();
+
+    // The block becomes the tip without its data, like a pruned one, and
+    // nChainTx links the blocks that will be connected on top of it.
+    pindexBase->nChainTx = nChainTx;
+    pindexBase->RaiseValidity(BLOCK_VALID_SCRIPTS);
+    setDirtyBlockIndex.insert(pindexBase);
+    setBlockIndexCandidates.insert(pindexBase);
+    chainActive.SetTip(pindexBase);
+    PublishChainTip();
+    pindexSnapshotBase = pindexBase;
+    PruneBlockIndexCandidates();
+    // Whatever is in the mempool was accepted against the old set.
+    mempool.clear();
+
+    if (!pblocktree->WriteSnapshotBase(pindexBase->GetBlockHash(), nChainTx))
+        return AbortNode(state, "Failed to write UTXO snapshot base");
+    if (!FlushStateToDisk(state, FLUSH_STATE_ALWAYS))
+        return false;
+
+    LogPrintf("%s: loaded UTXO set at height=%d hash=%s txouts=%u\n", __func__,
+        pindexBase->nHeight, pindexBase->GetBlockHash().ToString(), utxoCommitment.nTransactionOutputs);
+    uiInterface.NotifyBlockTip(IsInitialBlockDownload(), pindexBase);
+    return true;
+}
+
 bool InitBlockIndex(const CChainParams& chainparams)
 {
     LOCK(cs_main);
@@ -4152,13 +4672,11 @@ bool InitBlockIndex(const CChainParams& chainparams)
     return true;
 }
 
-bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp)
-{
-    // Map of disk positions for blocks with unknown parent (only used for reindex)
-    static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
-    int64_t nStart = GetTimeMillis();
+// Map of disk positions for blocks with unknown parent (only used for reindex)
+static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
 
-    int nLoaded = 0;
+bool ScanExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp, const std::function<bool(const std::shared_ptr<CBlock>&)>& processBlock)
+{
     try {
         // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
         CBufferedFile blkdat(fileIn, 2*MAX_BLOCK_SERIALIZED_SIZE, MAX_BLOCK_SERIALIZED_SIZE+8, SER_DISK, CLIENT_VERSION);
@@ -4194,82 +4712,127 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskB
                 blkdat.SetLimit(nBlockPos + nSize);
                 blkdat.SetPos(nBlockPos);
                 std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
-                CBlock& block = *pblock;
-                blkdat >> block;
+                blkdat >> *pblock;
                 nRewind = blkdat.GetPos();
 
-                // detect out of order blocks, and store them for later
-                uint256 hash = block.GetHash();
-                if (hash != chainparams.GetConsensus(0).hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
-                    LogPrint("reindex", "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
-                            block.hashPrevBlock.ToString());
-                    if (dbp)
-                        mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
-                    continue;
-                }
+                if (!processBlock(pblock))
+                    break;
+            } catch (const std::exception& e) {
+                LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
+            }
+        }
+    } catch (const std::runtime_error& e) {
+        return AbortNode(std::string("System error: ") + e.what());
+    }
+    return true;
+}
 
-                // process in case the block isn't known yet
-                if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
-                    LOCK(cs_main);
-                    CValidationState state;
-                    if (AcceptBlock(pblock, state, chainparams, NULL, true, dbp, NULL))
-                        nLoaded++;
-                    if (state.IsError())
-                        break;
-                } else if (hash != chainparams.GetConsensus(0).hashGenesisBlock && mapBlockIndex[hash]->nHeight % 1000 == 0) {
-                    LogPrint("reindex", "Block Import: already had block %s at height %d\n", hash.ToString(), mapBlockIndex[hash]->nHeight);
-                }
+/**
+ * Accept a block read from a block file, or store it for later if its
+ * parent is not known yet, and then accept the stored blocks that were
+ * waiting for it. Returns false if importing has to stop.
+ */
+static bool ProcessExternalBlock(const CChainParams& chainparams, const std::shared_ptr<CBlock>& pblock, CDiskBlockPos *dbp, int& nLoaded)
+{
+    const CBlock& block = *pblock;
 
-                // Activate the genesis block so normal node progress can continue
-                if (hash == chainparams.GetConsensus(0).hashGenesisBlock) {
-                    CValidationState state;
-                    if (!ActivateBestChain(state, chainparams)) {
-                        break;
-                    }
-                }
+    // detect out of order blocks, and store them for later
+    uint256 hash = block.GetHash();
+    if (hash != chainparams.GetConsensus(0).hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
+        LogPrint("reindex", "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
+                block.hashPrevBlock.ToString());
+        if (dbp)
+            mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
+        return true;
+    }
 
-                NotifyHeaderTip();
-
-                // Recursively process earlier encountered successors of this block
-                std::deque<uint256> queue;
-                queue.push_back(hash);
-                while (!queue.empty()) {
-                    uint256 head = queue.front();
-                    queue.pop_front();
-                    std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
-                    while (range.first != range.second) {
-                        std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
-                        std::shared_ptr<CBlock> pblockrecursive = std::make_shared<CBlock>();
-                        // TODO: Need a valid consensus height
-                        if (ReadBlockFromDisk(*pblockrecursive, it->second, chainparams.GetConsensus(0)))
-                        {
-                            LogPrint("reindex", "%s: Processing out of order child %s of %s\n", __func__, pblockrecursive->GetHash().ToString(),
-                                    head.ToString());
-                            LOCK(cs_main);
-                            CValidationState dummy;
-                            if (AcceptBlock(pblockrecursive, dummy, chainparams, NULL, true, &it->second, NULL))
-                            {
-                                nLoaded++;
-                                queue.push_back(pblockrecursive->GetHash());
-                            }
-                        }
-                        range.first++;
-                        mapBlocksUnknownParent.erase(it);
-                        NotifyHeaderTip();
-                    }
+    // process in case the block isn't known yet
+    if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
+        LOCK(cs_main);
+        CValidationState state;
+        if (AcceptBlock(pblock, state, chainparams, NULL, true, dbp, NULL))
+            nLoaded++;
+        if (state.IsError())
+            return false;
+    } else if (hash != chainparams.GetConsensus(0).hashGenesisBlock && mapBlockIndex[hash]->nHeight % 1000 == 0) {
+        LogPrint("reindex", "Block Import: already had block %s at height %d\n", hash.ToString(), mapBlockIndex[hash]->nHeight);
+    }
+
+    // Activate the genesis block so normal node progress can continue
+    if (hash == chainparams.GetConsensus(0).hashGenesisBlock) {
+        CValidationState state;
+        if (!ActivateBestChain(state, chainparams)) {
+            return false;
+        }
+    }
+
+    NotifyHeaderTip();
+
+    // Recursively process earlier encountered successors of this block
+    std::deque<uint256> queue;
+    queue.push_back(hash);
+    while (!queue.empty()) {
+        uint256 head = queue.front();
+        queue.pop_front();
+        std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
+        while (range.first != range.second) {
+            std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
+            std::shared_ptr<CBlock> pblockrecursive = std::make_shared<CBlock>();
+            // The PoW is checked once, by CheckBlock below, instead of here
+            // and again in AcceptBlock.
+            // TODO: Need a valid consensus height
+            if (ReadBlockFromDisk(*pblockrecursive, it->second, chainparams.GetConsensus(0), false))
+            {
+                LogPrint("reindex", "%s: Processing out of order child %s of %s\n", __func__, pblockrecursive->GetHash().ToString(),
+                        head.ToString());
+                CValidationState dummy;
+                CheckBlock(*pblockrecursive, dummy);
+                LOCK(cs_main);
+                if (AcceptBlock(pblockrecursive, dummy, chainparams, NULL, true, &it->second, NULL))
+                {
+                    nLoaded++;
+                    queue.push_back(pblockrecursive->GetHash());
                 }
-            } catch (const std::exception& e) {
-                LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
             }
+            range.first++;
+            mapBlocksUnknownParent.erase(it);
+            NotifyHeaderTip();
         }
-    } catch (const std::runtime_error& e) {
-        AbortNode(std::string("System error: ") + e.what());
     }
+    return true;
+}
+
+bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp)
+{
+    int64_t nStart = GetTimeMillis();
+
+    int nLoaded = 0;
+    ScanExternalBlockFile(chainparams, fileIn, dbp, [&](const std::shared_ptr<CBlock>& pblock) {
+        return ProcessExternalBlock(chainparams, pblock, dbp, nLoaded);
+    });
     if (nLoaded > 0)
         LogPrintf("Loaded %i blocks from external file in %dms\n", nLoaded, GetTimeMillis() - nStart);
     return nLoaded > 0;
 }
 
+void ReindexBlockFiles(const CChainParams& chainparams, int nThreads, uint64_t nMaxBytesAhead)
+{
+    CReindexReader reader(chainparams, nThreads, nMaxBytesAhead);
+    std::vector<CReindexReader::Block> vBlocks;
+    for (int nFile = 0; reader.Take(nFile, vBlocks); nFile++) {
+        LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int)nFile);
+        int64_t nStart = GetTimeMillis();
+        int nLoaded = 0;
+        for (size_t i = 0; i < vBlocks.size(); i++) {
+            boost::this_thread::interruption_point();
+            if (!ProcessExternalBlock(chainparams, vBlocks[i].pblock, &vBlocks[i].pos, nLoaded))
+                break;
+        }
+        if (nLoaded > 0)
+            LogPrintf("Loaded %i blocks from external file in %dms\n", nLoaded, GetTimeMillis() - nStart);
+    }
+}
+
 void static CheckBlockIndex(const Consensus::Params& consensusParams)
 {
     if (!fCheckBlockIndex) {
@@ -4278,6 +4841,12 @@ void static CheckBlockIndex(const Consensus::Params& consensusParams)
 
     LOCK(cs_main);
 
+    // The checks below assume that every block in the active chain was
+    // processed, which is not the case below a loaded UTXO snapshot.
+    if (pindexSnapshotBase) {
+        return;
+    }
+
     // During a reindex, we read the genesis block and call CheckBlockIndex before ActivateBestChain,
     // so we have the genesis block in mapBlockIndex but no active chain.  (A few of the tests when
     // iterating the block tree require that chainActive has been initialized.)
@@ -4617,9 +5186,7 @@ public:
     CMainCleanup() {}
     ~CMainCleanup() {
         // block headers
-        BlockMap::iterator it1 = mapBlockIndex.begin();
-        for (; it1 != mapBlockIndex.end(); it1++)
-            delete (*it1).second;
         mapBlockIndex.clear();
+        blockIndexArena.Clear();
     }
 } instance_of_cmaincleanup;
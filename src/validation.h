@@ -14,6 +14,7 @@
 #include "amount.h"
 #include "chain.h"
 #include "coins.h"
+#include "lrucache.h"
 #include "undo.h"
 #include "policy/policy.h" // For RECOMMENDED_MIN_TX_FEE
 #include "protocol.h" // For CMessageHeader::MessageStartChars
@@ -23,7 +24,9 @@
 
 #include <algorithm>
 #include <exception>
+#include <functional>
 #include <map>
+#include <memory>
 #include <set>
 #include <stdint.h>
 #include <string>
@@ -36,15 +39,22 @@
 #include <boost/filesystem/path.hpp>
 
 class CBlockIndex;
+class CBlockFileMap;
+class CBlockReadAhead;
 class CBlockTreeDB;
 class CBloomFilter;
 class CChainParams;
+class CCoinsViewDB;
+class CCoinsViewFlusher;
+class CCoinsViewPrefetch;
 class CInv;
 class CConnman;
 class CScriptCheck;
 class CTxMemPool;
+class CUTXOCommitment;
 class CValidationInterface;
 class CValidationState;
+struct CByteSpan;
 struct ChainTxData;
 
 struct PrecomputedTransactionData;
@@ -87,7 +97,7 @@ static const unsigned int BLOCKFILE_CHUNK_SIZE = 0x1000000; // 16 MiB
 static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
 
 /** Maximum number of script-checking threads allowed */
-static const int MAX_SCRIPTCHECK_THREADS = 16;
+static const int MAX_SCRIPTCHECK_THREADS = 256;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
 /** Number of blocks that can be requested at any given time from a single peer. */
@@ -157,6 +167,15 @@ static const int MAX_UNCONNECTING_HEADERS = 10;
 
 static const bool DEFAULT_PEERBLOOMFILTERS = true;
 
+/** Default for -dbcachekeep, percentage of the in-memory UTXO set kept when it is flushed */
+static const unsigned int DEFAULT_COINS_CACHE_KEEP = 50;
+
+/** Default for -auxpowcache, MiB of auxpow data kept for serving block headers */
+static const unsigned int DEFAULT_AUXPOW_CACHE_SIZE = 16;
+
+/** Default for -blockcache, MiB of recently served serialized blocks kept in memory */
+static const unsigned int DEFAULT_BLOCK_CACHE_SIZE = 16;
+
 struct BlockHasher
 {
     size_t operator()(const uint256& hash) const { return hash.GetCheapHash(); }
@@ -181,6 +200,8 @@ extern bool fIsBareMultisigStd;
 extern bool fRequireStandard;
 extern bool fCheckBlockIndex;
 extern bool fCheckpointsEnabled;
+/** Whether blocks read back through the block tree get their PoW and merkle root checked again */
+extern bool fCheckBlockReads;
 extern size_t nCoinCacheUsage;
 /** A fee rate smaller than this is considered zero fee (for relaying, mining and transaction creation) */
 //mlumin 5/2021: changing variable name to Rate vs Fee because thats what it is.
@@ -197,6 +218,9 @@ extern uint256 hashAssumeValid;
 /** Best header we've seen so far (used for getheaders queries' starting points). */
 extern CBlockIndex *pindexBestHeader;
 
+/** Block the UTXO set was loaded at from a snapshot, if any; blocks before it have no data. */
+extern CBlockIndex *pindexSnapshotBase;
+
 /** Minimum disk space required - used in CheckDiskSpace() */
 static const uint64_t nMinDiskSpace = 52428800;
 
@@ -212,6 +236,8 @@ static const unsigned int MIN_BLOCKS_TO_KEEP = 1440;
 
 static const signed int DEFAULT_CHECKBLOCKS = 6;
 static const unsigned int DEFAULT_CHECKLEVEL = 3;
+static const bool DEFAULT_CHECKHEADERPOW = false;
+static const bool DEFAULT_CHECKBLOCKREADS = false;
 
 // Require that user allocate at least 22,00MB for block & undo files (blk???.dat and rev???.dat)
 // At 1MB per block, 1,440 blocks = 1,440MB.
@@ -266,14 +292,34 @@ FILE* OpenUndoFile(const CDiskBlockPos &pos, bool fReadOnly = false);
 boost::filesystem::path GetBlockPosFilename(const CDiskBlockPos &pos, const char *prefix);
 /** Import blocks from an external file */
 bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp = NULL);
+/**
+ * Find the blocks in a block file and pass them to processBlock, in file
+ * order, until it returns false. If dbp is set, its nPos is the position of
+ * the block being processed. Takes over (and closes) fileIn.
+ */
+bool ScanExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp, const std::function<bool(const std::shared_ptr<CBlock>&)>& processBlock);
+/**
+ * Rebuild the block index from the blk?????.dat files, reading and checking
+ * them on nThreads threads, at most about nMaxBytesAhead of them ahead.
+ * Blocks are accepted in file order; children found before their parent
+ * are read again from disk once the parent is accepted.
+ */
+void ReindexBlockFiles(const CChainParams& chainparams, int nThreads, uint64_t nMaxBytesAhead);
 /** Initialize a new block tree database + block data on disk */
 bool InitBlockIndex(const CChainParams& chainparams);
 /** Load the block tree and coins database from disk */
 bool LoadBlockIndex(const CChainParams& chainparams);
+/** Load utxoCommitment for the coins database, computing it if none is stored for its best block */
+bool LoadUTXOCommitment(CCoinsViewDB* pcoinsdb);
+/** Make the coins loaded into pcoinsTip, with the given commitment, the UTXO set at pindexBase,
+ *  a block whose history we do not have, and make it the tip (with cs_main held). */
+bool ActivateUTXOSnapshot(CValidationState& state, CBlockIndex* pindexBase, unsigned int nChainTx, const CUTXOCommitment& commitment);
 /** Unload database information */
 void UnloadBlockIndex();
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run an instance of the header proof-of-work checking thread */
+void ThreadHeaderCheck();
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload();
 /** Format a string that describes several potential problems detected by the core.
@@ -460,8 +506,8 @@ private:
 
 public:
     CScriptCheck(): amount(0), ptxTo(0), nIn(0), nFlags(0), cacheStore(false), error(SCRIPT_ERR_UNKNOWN_ERROR) {}
-    CScriptCheck(const CCoins& txFromIn, const CTransaction& txToIn, unsigned int nInIn, unsigned int nFlagsIn, bool cacheIn, PrecomputedTransactionData* txdataIn) :
-        scriptPubKey(txFromIn.vout[txToIn.vin[nInIn].prevout.n].scriptPubKey), amount(txFromIn.vout[txToIn.vin[nInIn].prevout.n].nValue),
+    CScriptCheck(const CTxOut& outIn, const CTransaction& txToIn, unsigned int nInIn, unsigned int nFlagsIn, bool cacheIn, PrecomputedTransactionData* txdataIn) :
+        scriptPubKey(outIn.scriptPubKey), amount(outIn.nValue),
         ptxTo(&txToIn), nIn(nInIn), nFlags(nFlagsIn), cacheStore(cacheIn), error(SCRIPT_ERR_UNKNOWN_ERROR), txdata(txdataIn) { }
 
     bool operator()();
@@ -484,8 +530,29 @@ public:
 /** Functions for disk access for blocks */
 bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams, bool fCheckPOW = true);
+/**
+ * Read a block or its header through its index entry. The hash of the data
+ * read must match the entry. fCheckPOW only applies to entries that are not
+ * yet BLOCK_VALID_TREE; for the others the PoW was checked on acceptance.
+ * With -checkblockreads, the PoW is checked for all entries, and the merkle
+ * root of a block as well.
+ */
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams, bool fCheckPOW = true);
 bool ReadBlockHeaderFromDisk(CBlockHeader& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams, bool fCheckPOW = true);
+/**
+ * Get the serialized block at pos without deserializing it: straight from
+ * the mapped block file if pblockFileMap is in use, copied out of the file
+ * otherwise. The pindex version also checks that it is the indexed block.
+ */
+bool ReadRawBlockFromDisk(CByteSpan& span, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
+bool ReadRawBlockFromDisk(CByteSpan& span, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& messageStart);
+/**
+ * Like ReadRawBlockFromDisk, but look in blockCache first, and add blocks
+ * read from disk to it. Used for serving blocks to peers, RPC, REST and ZMQ.
+ */
+bool ReadRawBlockCached(CByteSpan& span, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& messageStart);
+/** Deserialize a block got from ReadRawBlockFromDisk or ReadRawBlockCached */
+bool DecodeRawBlock(CBlock& block, const CByteSpan& span);
 
 /** Functions for validating blocks and updating the block tree */
 
@@ -501,15 +568,17 @@ bool ContextualCheckBlock(const CBlock& block, CValidationState& state, const CB
 
 /** Apply the effects of this block (with given index) on the UTXO set represented by coins.
  *  Validity checks that depend on the UTXO set are also done; ConnectBlock()
- *  can fail if those validity checks fail (among other reasons). */
+ *  can fail if those validity checks fail (among other reasons). If pcommitment
+ *  is given, it is updated for the coins created and spent on success. */
 bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& coins,
-                  const CChainParams& chainparams, bool fJustCheck = false);
+                  const CChainParams& chainparams, bool fJustCheck = false, CUTXOCommitment* pcommitment = NULL);
 
 /** Undo the effects of this block (with given index) on the UTXO set represented by coins.
  *  In case pfClean is provided, operation will try to be tolerant about errors, and *pfClean
  *  will be true if no problems were found. Otherwise, the return value will be false in case
- *  of problems. Note that in any case, coins may be modified. */
-bool DisconnectBlock(const CBlock& block, CValidationState& state, const CBlockIndex* pindex, CCoinsViewCache& coins, bool* pfClean = NULL);
+ *  of problems. Note that in any case, coins may be modified. If pcommitment is given, it
+ *  is updated for the coins restored and removed unless problems were found. */
+bool DisconnectBlock(const CBlock& block, CValidationState& state, const CBlockIndex* pindex, CCoinsViewCache& coins, bool* pfClean = NULL, CUTXOCommitment* pcommitment = NULL);
 
 /** Check a block is completely valid from start to finish (only works on top of our current best block, with cs_main held) */
 bool TestBlockValidity(CValidationState& state, const CChainParams& chainparams, const CBlock& block, CBlockIndex* pindexPrev, bool fCheckPOW = true, bool fCheckMerkleRoot = true);
@@ -549,12 +618,47 @@ bool ResetBlockFailureFlags(CBlockIndex *pindex);
 /** The currently-connected chain of blocks (protected by cs_main). */
 extern CChain chainActive;
 
+/**
+ * The tip of chainActive as of its last change, for read-only callers that
+ * do not hold cs_main. The view it returns stays the same while validation
+ * moves on; take a new one to see later blocks.
+ */
+std::shared_ptr<const CChainTip> GetChainTipSnapshot();
+
+/**
+ * Find a block index entry by hash without cs_main, or return NULL. Only
+ * fields that do not change once an entry is in the index (its header,
+ * hash, height, pprev, pskip and nChainWork) may be read without cs_main.
+ */
+const CBlockIndex* LookupBlockIndex(const uint256& hash);
+
 /** Global variable that points to the active CCoinsView (protected by cs_main) */
 extern CCoinsViewCache *pcoinsTip;
 
+/** Commitment to the UTXO set pcoinsTip represents (protected by cs_main) */
+extern CUTXOCommitment utxoCommitment;
+
+/** Writes what pcoinsTip flushes in the background, NULL if not in use (protected by cs_main) */
+extern CCoinsViewFlusher *pcoinsFlusher;
+
+/** Read-ahead layer below pcoinsFlusher, NULL if not in use (protected by cs_main) */
+extern CCoinsViewPrefetch *pcoinsPrefetch;
+
+/** Reads blocks ahead of ActivateBestChainStep, NULL if not in use */
+extern CBlockReadAhead *pblockReadAhead;
+
+/** Memory-mapped access to the block and undo files, NULL if they are read with fread */
+extern CBlockFileMap *pblockFileMap;
+
 /** Global variable that points to the active block tree (protected by cs_main) */
 extern CBlockTreeDB *pblocktree;
 
+/** Serialized auxpow of recently served headers, see CBlockIndex::GetBlockHeader */
+extern CLRUCache<const CBlockIndex*> auxpowCache;
+
+/** Serialized blocks recently served to peers and RPC clients, by hash */
+extern CLRUCache<uint256, BlockHasher> blockCache;
+
 /**
  * Return the spend height, which is one more than the inputs.GetBestBlock().
  * While checking, GetBestBlock() refers to the parent block. (protected by cs_main)
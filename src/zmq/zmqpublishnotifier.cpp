@@ -3,6 +3,7 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "blockfilemap.h"
 #include "chainparams.h"
 #include "streams.h"
 #include "zmqpublishnotifier.h"
@@ -170,20 +171,28 @@ bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
 {
     LogPrint("zmq", "zmq: Publish rawblock %s\n", pindex->GetBlockHash().GetHex());
 
-    const Consensus::Params& consensusParams = Params().GetConsensus(pindex->nHeight);
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
+    CByteSpan rawBlock;
     {
         LOCK(cs_main);
-        CBlock block;
-        if(!ReadBlockFromDisk(block, pindex, consensusParams))
+        if(!ReadRawBlockCached(rawBlock, pindex, Params().MessageStart()))
         {
             zmqError("Can't read block from disk");
             return false;
         }
-
-        ss << block;
     }
 
+    // The stored serialization includes witnesses
+    if (RPCSerializationFlags() == 0)
+        return SendMessage(MSG_RAWBLOCK, rawBlock.data, rawBlock.size);
+
+    CBlock block;
+    if (!DecodeRawBlock(block, rawBlock))
+    {
+        zmqError("Can't read block from disk");
+        return false;
+    }
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
+    ss << block;
     return SendMessage(MSG_RAWBLOCK, &(*ss.begin()), ss.size());
 }
 